@@ -59,7 +59,7 @@ public:
     explicit StreamMultiplexer(StreamChannel &stream_channel)
         : streams_{}, stream_channel_{stream_channel} {}
 
-    tbb::concurrent_map<Pubkey, DataChannel> &streams_channel() {
+    tbb::concurrent_map<PeerId, DataChannel> &streams_channel() {
         return streams_;
     }
 
@@ -75,7 +75,8 @@ public:
         //         [this](std::error_code ec, std::vector<uint8_t> data) {
         //             auto packet = Packet::from_proto(data);
         //
-        //             streams_.at(packet.from).try_send(ec, packet);
+        //             streams_.at(PeerId::from_pubkey(packet.from))
+        //                     .try_send(ec, packet);
         //         });
 
         // asio::co_spawn(ctx, [&ctx, this]() -> asio::awaitable<void> {
@@ -99,7 +100,8 @@ public:
 private:
     CentralAdapter central_adapter_{};
     PeripheralAdapter peripheral_adapter_{};
-    tbb::concurrent_map<Pubkey, DataChannel> streams_;
+    /// by PeerId, which is ordered where Pubkey is not
+    tbb::concurrent_map<PeerId, DataChannel> streams_;
     StreamChannel &stream_channel_;
 };
 
@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <absl/strings/escaping.h>
+#include <absl/strings/str_format.h>
+#include <sodium.h>
+
+#include "crypto/crc64.h"
+#include "crypto/crypto.h"
+#include "crypto/encoding.h"
+#include "crypto/envelope.h"
+#include "crypto/kdf_chain.h"
+#include "crypto/secure_arena.h"
+#include "crypto/session.h"
+#include "utils/bench.h"
+
+int main() {
+    if (sodium_init() < 0) {
+        return 1;
+    }
+
+    bench::Runner runner;
+
+    using Kernel = uint64_t (*)(uint64_t, std::span<uint8_t const>);
+    std::vector<std::pair<char const *, Kernel>> kernels{
+            {"bytewise", crypto::detail::crc64_bytewise},
+            {"slicing8", crypto::detail::crc64_slicing8},
+            {"slicing16", crypto::detail::crc64_slicing16},
+    };
+    if (crypto::detail::crc64_clmul_supported()) {
+        kernels.emplace_back("clmul", crypto::detail::crc64_clmul);
+    }
+
+    for (size_t size : {16, 64, 256, 1024, 4096, 65536, 1 << 20}) {
+        std::vector<uint8_t> data(size);
+        randombytes_buf(data.data(), data.size());
+
+        runner.run(absl::StrFormat("crc64/size:%d", size),
+                [&] { bench::do_not_optimize(crypto::crc64(data)); },
+                size);
+
+        for (auto [name, kernel] : kernels) {
+            runner.run(absl::StrFormat("crc64/%s/size:%d", name, size),
+                    [&] { bench::do_not_optimize(kernel(0, data)); },
+                    size);
+        }
+    }
+
+    runner.run("crc64/combine/size:65536",
+            [&] {
+                bench::do_not_optimize(
+                        crypto::crc64_combine(0x1234, 0x5678, 65536));
+            });
+
+    Keypair keypair = Keypair::generate();
+    for (size_t size : {64, 1024}) {
+        std::vector<uint8_t> message(size);
+        randombytes_buf(message.data(), message.size());
+        Signature signature = keypair.privkey.sign(message);
+
+        runner.run(absl::StrFormat("pubkey/verify/size:%d", size),
+                [&] {
+                    bench::do_not_optimize(
+                            keypair.pubkey.verify(message, signature.bytes));
+                },
+                size);
+    }
+
+    // a burst of messages from different authors, as after reconnecting
+    constexpr size_t kBurstMessageSize = 200;
+    for (size_t batch_size : {1, 8, 64, 256}) {
+        std::vector<Keypair> authors;
+        std::vector<std::vector<uint8_t>> messages;
+        std::vector<Signature> signatures;
+        for (size_t i = 0; i < batch_size; ++i) {
+            Keypair &author = authors.emplace_back(Keypair::generate());
+            std::vector<uint8_t> &message = messages.emplace_back(
+                    std::vector<uint8_t>(kBurstMessageSize));
+            randombytes_buf(message.data(), message.size());
+            signatures.push_back(author.privkey.sign(message));
+        }
+
+        std::vector<SignedMessage> batch;
+        for (size_t i = 0; i < batch_size; ++i) {
+            batch.push_back({
+                    .pubkey = authors[i].pubkey.data(),
+                    .message = messages[i],
+                    .signature = signatures[i].bytes,
+            });
+        }
+
+        runner.run(absl::StrFormat("verify/per_item/batch:%d", batch_size),
+                [&] {
+                    for (size_t i = 0; i < batch_size; ++i) {
+                        bench::do_not_optimize(authors[i].pubkey.verify(
+                                messages[i], signatures[i].bytes));
+                    }
+                },
+                batch_size * kBurstMessageSize);
+        runner.run(absl::StrFormat("verify/batch/batch:%d", batch_size),
+                [&] { bench::do_not_optimize(verify_batch(batch)); },
+                batch_size * kBurstMessageSize);
+    }
+
+    // a message to a group: one envelope against a sealed box each
+    constexpr size_t kGroupPayloadSize = 1024;
+    std::vector<uint8_t> group_payload(kGroupPayloadSize);
+    randombytes_buf(group_payload.data(), group_payload.size());
+
+    for (size_t count : {1, 4, 16, 64}) {
+        std::vector<Pubkey> recipients;
+        for (size_t i = 0; i < count; ++i) {
+            recipients.push_back(Keypair::generate().pubkey);
+        }
+
+        std::vector<uint8_t> envelope(
+                envelope_size(kGroupPayloadSize, count));
+        runner.run(absl::StrFormat("envelope/seal/recipients:%d", count),
+                [&] {
+                    bench::do_not_optimize(seal_envelope(
+                            group_payload, recipients, envelope));
+                },
+                kGroupPayloadSize);
+
+        std::vector<uint8_t> boxes(
+                count * (kGroupPayloadSize + kSealOverhead));
+        runner.run(absl::StrFormat("sealed_boxes/seal/recipients:%d", count),
+                [&] {
+                    for (size_t i = 0; i < count; ++i) {
+                        bench::do_not_optimize(recipients[i].seal_into(
+                                group_payload,
+                                std::span{boxes}.subspan(
+                                        i * (kGroupPayloadSize + kSealOverhead),
+                                        kGroupPayloadSize + kSealOverhead)));
+                    }
+                },
+                kGroupPayloadSize);
+
+        runner.record(absl::StrFormat("envelope/size/recipients:%d", count),
+                {
+                        {"envelope_bytes",
+                                static_cast<double>(envelope.size())},
+                        {"sealed_boxes_bytes",
+                                static_cast<double>(boxes.size())},
+                });
+    }
+
+    // messages to a contact we talk to constantly
+    {
+        constexpr size_t kContactMessageSize = 200;
+        std::vector<uint8_t> message(kContactMessageSize);
+        randombytes_buf(message.data(), message.size());
+
+        Keypair contact = Keypair::generate();
+        EphemeralKey ephemeral = EphemeralKey::generate();
+        EphemeralKey contact_ephemeral = EphemeralKey::generate();
+        auto session = Session::establish(keypair,
+                ephemeral,
+                contact.pubkey,
+                contact_ephemeral.pubkey());
+        auto peer_session = Session::establish(contact,
+                contact_ephemeral,
+                keypair.pubkey,
+                ephemeral.pubkey());
+
+        std::vector<uint8_t> sealed(kContactMessageSize + kSealOverhead);
+        std::vector<uint8_t> opened(kContactMessageSize);
+        runner.run("contact/sealed_box/seal",
+                [&] {
+                    bench::do_not_optimize(
+                            contact.pubkey.seal_into(message, sealed));
+                },
+                kContactMessageSize);
+        runner.run("contact/sealed_box/open",
+                [&] {
+                    bench::do_not_optimize(
+                            contact.privkey.open_into(sealed, opened));
+                },
+                kContactMessageSize);
+
+        // sealed and opened together, the receiver rejects replays
+        std::vector<uint8_t> session_sealed(
+                kContactMessageSize + kSessionOverhead);
+        runner.run("contact/session/seal_and_open",
+                [&] {
+                    session->seal_into(message, session_sealed);
+                    bench::do_not_optimize(
+                            peer_session->open_into(session_sealed, opened));
+                },
+                kContactMessageSize);
+    }
+
+    // a peer id as logged and as sent, and the per-byte formatting and absl
+    // calls the codec replaced
+    PeerId peer_id = PeerId::from_pubkey(keypair.pubkey);
+    std::array<char, crypto::hex_encoded_size(kPeerIdSize)> hex{};
+    runner.run("hex/encode/size:32", [&] {
+        crypto::hex_encode(peer_id.bytes, hex);
+        bench::do_not_optimize(hex);
+    });
+    runner.run("hex/encode_scalar/size:32", [&] {
+        crypto::detail::hex_encode_scalar(peer_id.bytes, hex.data());
+        bench::do_not_optimize(hex);
+    });
+    runner.run("hex/str_append_format/size:32", [&] {
+        std::string buffer;
+        for (uint8_t byte : peer_id.bytes) {
+            absl::StrAppendFormat(&buffer, "%02x", byte);
+        }
+        bench::do_not_optimize(buffer);
+    });
+
+    std::array<uint8_t, kPeerIdSize> decoded{};
+    runner.run("hex/decode/size:32", [&] {
+        bench::do_not_optimize(crypto::hex_decode({hex.data(), hex.size()},
+                decoded));
+    });
+
+    std::array<char, crypto::base64_encoded_size(kPeerIdSize)> base64{};
+    absl::string_view peer_bytes{
+            reinterpret_cast<char const *>(peer_id.bytes.data()),
+            peer_id.bytes.size()};
+    runner.run("base64/encode/size:32", [&] {
+        crypto::base64_encode(peer_id.bytes, base64);
+        bench::do_not_optimize(base64);
+    });
+    runner.run("base64/absl_escape/size:32", [&] {
+        bench::do_not_optimize(absl::Base64Escape(peer_bytes));
+    });
+
+    std::string_view base64_view{base64.data(), base64.size()};
+    runner.run("base64/decode/size:32", [&] {
+        bench::do_not_optimize(crypto::base64_decode(base64_view, decoded));
+    });
+    runner.run("base64/absl_unescape/size:32", [&] {
+        std::string out;
+        bench::do_not_optimize(absl::Base64Unescape(base64_view, &out));
+        bench::do_not_optimize(out);
+    });
+
+    std::vector<uint8_t> blob(4096);
+    randombytes_buf(blob.data(), blob.size());
+    std::string blob_base64 = crypto::base64_string(blob);
+    runner.run("base64/encode/size:4096",
+            [&] {
+                crypto::base64_encode(blob, blob_base64);
+                bench::do_not_optimize(blob_base64);
+            },
+            blob.size());
+    runner.run("base64/decode/size:4096",
+            [&] {
+                bench::do_not_optimize(
+                        crypto::base64_decode(blob_base64, blob));
+            },
+            blob.size());
+
+    runner.run("peer_id/to_base64",
+            [&] { bench::do_not_optimize(peer_id.to_base64()); });
+    runner.run("peer_id/to_string",
+            [&] { bench::do_not_optimize(peer_id.to_string()); });
+
+    // a key's worth of secret memory, from the arena and on its own
+    runner.run("secure_arena/allocate_free/size:64", [&] {
+        void *block = SecureArena::global().allocate(64);
+        bench::do_not_optimize(block);
+        SecureArena::global().deallocate(block, 64);
+    });
+    runner.run("sodium_malloc/allocate_free/size:64", [&] {
+        void *block = sodium_malloc(64);
+        bench::do_not_optimize(block);
+        sodium_free(block);
+    });
+
+    std::array<uint8_t, 32> seed{};
+    randombytes_buf(seed.data(), seed.size());
+    KDFChain chain{seed};
+
+    // a chain per contact, set up when the sessions are
+    runner.run("kdf_chain/construct/max_skipped:1024",
+            [&] { bench::do_not_optimize(KDFChain{seed}); });
+
+    runner.run("kdf_chain/next_key",
+            [&] { bench::do_not_optimize(chain.next_key()); });
+
+    // a window of messages delivered shuffled, each decrypted with its key
+    constexpr size_t kWindow = 256;
+    constexpr size_t kSealedSize = 200;
+
+    std::vector<uint64_t> order(kWindow);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937_64{1});
+
+    std::vector<std::vector<uint8_t>> sealed;
+    {
+        KDFChain sender{seed};
+        for (size_t i = 0; i < kWindow; ++i) {
+            MessageKey key = sender.next_key();
+            std::vector<uint8_t> &ciphertext = sealed.emplace_back(
+                    kSealedSize + crypto_aead_chacha20poly1305_ietf_ABYTES);
+            std::vector<uint8_t> plaintext(kSealedSize, 0x42);
+            std::array<uint8_t, crypto_aead_chacha20poly1305_ietf_NPUBBYTES>
+                    nonce{};
+            crypto_aead_chacha20poly1305_ietf_encrypt(ciphertext.data(),
+                    nullptr,
+                    plaintext.data(),
+                    plaintext.size(),
+                    nullptr,
+                    0,
+                    nullptr,
+                    nonce.data(),
+                    key.data());
+        }
+    }
+
+    auto decrypt = [&](uint64_t index, MessageKey const &key) {
+        std::array<uint8_t, kSealedSize> plaintext{};
+        std::array<uint8_t, crypto_aead_chacha20poly1305_ietf_NPUBBYTES>
+                nonce{};
+        return crypto_aead_chacha20poly1305_ietf_decrypt(plaintext.data(),
+                       nullptr,
+                       nullptr,
+                       sealed[index].data(),
+                       sealed[index].size(),
+                       nullptr,
+                       0,
+                       nonce.data(),
+                       key.data())
+                == 0;
+    };
+
+    for (size_t precompute : {0, 64}) {
+        std::string name = absl::StrFormat(
+                "kdf_chain/out_of_order/window:%d/precompute:%d",
+                kWindow,
+                precompute);
+        runner.run(name,
+                [&] {
+                    KDFChain receiver{seed,
+                            {.max_skipped = kWindow, .precompute = precompute}};
+                    for (uint64_t index : order) {
+                        bench::do_not_optimize(decrypt(
+                                index, receiver.key_at(index).value()));
+                    }
+                },
+                kWindow * kSealedSize);
+    }
+
+    // what a chain without skipped keys does: re-derive from the start
+    runner.run(absl::StrFormat("kdf_chain/out_of_order/window:%d/rederive",
+                       kWindow),
+            [&] {
+                for (uint64_t index : order) {
+                    KDFChain receiver{seed};
+                    MessageKey key{};
+                    for (uint64_t i = 0; i <= index; ++i) {
+                        key = receiver.next_key();
+                    }
+                    bench::do_not_optimize(decrypt(index, key));
+                }
+            },
+            kWindow * kSealedSize);
+}
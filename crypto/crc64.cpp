@@ -37,9 +37,20 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE. */
 
+#include <array>
+#include <bit>
 #include <cstdint>
+#include <cstring>
 #include <span>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
+#endif
+
+#include "crypto/crc64.h"
+
 namespace {
 
 constexpr uint64_t kDefaultSeed = 0x0;
@@ -113,21 +124,105 @@ std::array<uint64_t, 256> const crc64_tab = {
 };
 // clang-format on
 
-} // namespace
+/// the polynomial, bit-reflected like everything in this file: bit 0 is
+/// the coefficient of x^63
+constexpr uint64_t kPoly = 0x95ac9329ac4bc9b5;
 
-namespace crypto {
+/// tables for slicing-by-n: entry i of table k is the crc of byte i
+/// followed by k zero bytes
+template<size_t n>
+constexpr std::array<std::array<uint64_t, 256>, n> make_slicing_tables() {
+    std::array<std::array<uint64_t, 256>, n> tables{};
 
-uint64_t crc64(std::span<uint8_t const> data) {
-    uint64_t crc = kDefaultSeed;
+    for (size_t i = 0; i < 256; ++i) {
+        uint64_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) != 0 ? (crc >> 1) ^ kPoly : crc >> 1;
+        }
+        tables[0][i] = crc;
+    }
 
-    for (uint8_t const byte : data) {
-        crc = crc64_tab[static_cast<uint8_t>(crc) ^ byte] ^ (crc >> 8);
+    for (size_t k = 1; k < n; ++k) {
+        for (size_t i = 0; i < 256; ++i) {
+            uint64_t previous = tables[k - 1][i];
+            tables[k][i] = (previous >> 8) ^ tables[0][previous & 0xff];
+        }
     }
 
-    return crc;
+    return tables;
 }
 
-uint64_t crc64(uint64_t crc, std::span<uint8_t const> data) {
+constexpr auto kSlicingTables = make_slicing_tables<16>();
+
+static_assert(kSlicingTables[0][1] == 0x7ad870c830358979);
+static_assert(kSlicingTables[0][255] == 0x29b7d047efec8728);
+
+uint64_t load_le64(uint8_t const *bytes) {
+    uint64_t value = 0;
+    std::memcpy(&value, bytes, sizeof(value));
+    if constexpr (std::endian::native == std::endian::big) {
+        value = std::byteswap(value);
+    }
+    return value;
+}
+
+/// the product of two polynomials modulo the crc polynomial
+constexpr uint64_t multiply_mod(uint64_t a, uint64_t b) {
+    uint64_t product = 0;
+
+    // from x^0 (the top bit) downwards
+    for (uint64_t mask = uint64_t{1} << 63; mask != 0; mask >>= 1) {
+        if ((a & mask) != 0) {
+            product ^= b;
+        }
+        b = (b & 1) != 0 ? (b >> 1) ^ kPoly : b >> 1;
+    }
+
+    return product;
+}
+
+/// x^n modulo the crc polynomial
+constexpr uint64_t x_pow_mod(uint64_t n) {
+    uint64_t result = uint64_t{1} << 63;
+    // x^1
+    uint64_t square = uint64_t{1} << 62;
+
+    for (; n != 0; n >>= 1) {
+        if ((n & 1) != 0) {
+            result = multiply_mod(result, square);
+        }
+        square = multiply_mod(square, square);
+    }
+
+    return result;
+}
+
+#if defined(__x86_64__) \
+        || (defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO))
+#define HRAFN_CRC64_CLMUL 1
+
+// folding a 128-bit block over d bits multiplies its two halves by
+// x^(d+63) and x^(d-1). the missing power of x is made up for by the
+// carry-less multiply of reflected operands, which yields their product
+// times x.
+struct FoldConstants {
+    uint64_t low;
+    uint64_t high;
+};
+
+constexpr FoldConstants fold_constants(uint64_t distance_bits) {
+    return {x_pow_mod(distance_bits + 63), x_pow_mod(distance_bits - 1)};
+}
+
+constexpr FoldConstants kFold128 = fold_constants(128);
+constexpr FoldConstants kFold512 = fold_constants(512);
+#endif
+
+} // namespace
+
+namespace crypto::detail {
+
+uint64_t crc64_bytewise(uint64_t crc, std::span<uint8_t const> data) {
     for (uint8_t const byte : data) {
         crc = crc64_tab[static_cast<uint8_t>(crc) ^ byte] ^ (crc >> 8);
     }
@@ -135,4 +230,201 @@ uint64_t crc64(uint64_t crc, std::span<uint8_t const> data) {
     return crc;
 }
 
+uint64_t crc64_slicing8(uint64_t crc, std::span<uint8_t const> data) {
+    auto const &t = kSlicingTables;
+
+    uint8_t const *bytes = data.data();
+    size_t size = data.size();
+
+    for (; size >= 8; bytes += 8, size -= 8) {
+        crc ^= load_le64(bytes);
+        crc = t[7][crc & 0xff] ^ t[6][(crc >> 8) & 0xff]
+                ^ t[5][(crc >> 16) & 0xff] ^ t[4][(crc >> 24) & 0xff]
+                ^ t[3][(crc >> 32) & 0xff] ^ t[2][(crc >> 40) & 0xff]
+                ^ t[1][(crc >> 48) & 0xff] ^ t[0][crc >> 56];
+    }
+
+    return crc64_bytewise(crc, {bytes, size});
+}
+
+uint64_t crc64_slicing16(uint64_t crc, std::span<uint8_t const> data) {
+    auto const &t = kSlicingTables;
+
+    uint8_t const *bytes = data.data();
+    size_t size = data.size();
+
+    for (; size >= 16; bytes += 16, size -= 16) {
+        uint64_t first = crc ^ load_le64(bytes);
+        uint64_t second = load_le64(bytes + 8);
+
+        crc = t[15][first & 0xff] ^ t[14][(first >> 8) & 0xff]
+                ^ t[13][(first >> 16) & 0xff] ^ t[12][(first >> 24) & 0xff]
+                ^ t[11][(first >> 32) & 0xff] ^ t[10][(first >> 40) & 0xff]
+                ^ t[9][(first >> 48) & 0xff] ^ t[8][first >> 56]
+                ^ t[7][second & 0xff] ^ t[6][(second >> 8) & 0xff]
+                ^ t[5][(second >> 16) & 0xff] ^ t[4][(second >> 24) & 0xff]
+                ^ t[3][(second >> 32) & 0xff] ^ t[2][(second >> 40) & 0xff]
+                ^ t[1][(second >> 48) & 0xff] ^ t[0][second >> 56];
+    }
+
+    return crc64_slicing8(crc, {bytes, size});
+}
+
+#if defined(__x86_64__)
+
+bool crc64_clmul_supported() {
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+}
+
+namespace {
+
+__attribute__((target("pclmul,sse2"))) __m128i fold(
+        __m128i block, __m128i constants) {
+    return _mm_xor_si128(_mm_clmulepi64_si128(block, constants, 0x00),
+            _mm_clmulepi64_si128(block, constants, 0x11));
+}
+
+} // namespace
+
+__attribute__((target("pclmul,sse2"))) uint64_t crc64_clmul(
+        uint64_t crc, std::span<uint8_t const> data) {
+    uint8_t const *bytes = data.data();
+    size_t size = data.size();
+
+    if (size < 64) {
+        return crc64_slicing16(crc, data);
+    }
+
+    auto load = [](uint8_t const *at) {
+        return _mm_loadu_si128(reinterpret_cast<__m128i const *>(at));
+    };
+
+    __m128i const fold128 = _mm_set_epi64x(static_cast<int64_t>(kFold128.high),
+            static_cast<int64_t>(kFold128.low));
+    __m128i const fold512 = _mm_set_epi64x(static_cast<int64_t>(kFold512.high),
+            static_cast<int64_t>(kFold512.low));
+
+    // four independent accumulators hide the multiply latency
+    __m128i x0 = _mm_xor_si128(
+            load(bytes), _mm_cvtsi64_si128(static_cast<int64_t>(crc)));
+    __m128i x1 = load(bytes + 16);
+    __m128i x2 = load(bytes + 32);
+    __m128i x3 = load(bytes + 48);
+    bytes += 64;
+    size -= 64;
+
+    for (; size >= 64; bytes += 64, size -= 64) {
+        x0 = _mm_xor_si128(fold(x0, fold512), load(bytes));
+        x1 = _mm_xor_si128(fold(x1, fold512), load(bytes + 16));
+        x2 = _mm_xor_si128(fold(x2, fold512), load(bytes + 32));
+        x3 = _mm_xor_si128(fold(x3, fold512), load(bytes + 48));
+    }
+
+    __m128i x = _mm_xor_si128(fold(x0, fold128), x1);
+    x = _mm_xor_si128(fold(x, fold128), x2);
+    x = _mm_xor_si128(fold(x, fold128), x3);
+
+    for (; size >= 16; bytes += 16, size -= 16) {
+        x = _mm_xor_si128(fold(x, fold128), load(bytes));
+    }
+
+    // what is left of the folded blocks is 16 bytes of message
+    alignas(16) std::array<uint8_t, 16> folded{};
+    _mm_store_si128(reinterpret_cast<__m128i *>(folded.data()), x);
+
+    return crc64_slicing16(crc64_bytewise(0, folded), {bytes, size});
+}
+
+#elif defined(HRAFN_CRC64_CLMUL)
+
+bool crc64_clmul_supported() { return true; }
+
+namespace {
+
+uint64x2_t fold(uint64x2_t block, FoldConstants constants) {
+    poly128_t low = vmull_p64(vgetq_lane_u64(block, 0), constants.low);
+    poly128_t high = vmull_p64(vgetq_lane_u64(block, 1), constants.high);
+    return veorq_u64(
+            vreinterpretq_u64_p128(low), vreinterpretq_u64_p128(high));
+}
+
+} // namespace
+
+uint64_t crc64_clmul(uint64_t crc, std::span<uint8_t const> data) {
+    uint8_t const *bytes = data.data();
+    size_t size = data.size();
+
+    if (size < 64) {
+        return crc64_slicing16(crc, data);
+    }
+
+    auto load = [](uint8_t const *at) {
+        return vreinterpretq_u64_u8(vld1q_u8(at));
+    };
+
+    uint64x2_t x0 = veorq_u64(
+            load(bytes), vsetq_lane_u64(crc, vdupq_n_u64(0), 0));
+    uint64x2_t x1 = load(bytes + 16);
+    uint64x2_t x2 = load(bytes + 32);
+    uint64x2_t x3 = load(bytes + 48);
+    bytes += 64;
+    size -= 64;
+
+    for (; size >= 64; bytes += 64, size -= 64) {
+        x0 = veorq_u64(fold(x0, kFold512), load(bytes));
+        x1 = veorq_u64(fold(x1, kFold512), load(bytes + 16));
+        x2 = veorq_u64(fold(x2, kFold512), load(bytes + 32));
+        x3 = veorq_u64(fold(x3, kFold512), load(bytes + 48));
+    }
+
+    uint64x2_t x = veorq_u64(fold(x0, kFold128), x1);
+    x = veorq_u64(fold(x, kFold128), x2);
+    x = veorq_u64(fold(x, kFold128), x3);
+
+    for (; size >= 16; bytes += 16, size -= 16) {
+        x = veorq_u64(fold(x, kFold128), load(bytes));
+    }
+
+    std::array<uint8_t, 16> folded{};
+    vst1q_u8(folded.data(), vreinterpretq_u8_u64(x));
+
+    return crc64_slicing16(crc64_bytewise(0, folded), {bytes, size});
+}
+
+#else
+
+bool crc64_clmul_supported() { return false; }
+
+uint64_t crc64_clmul(uint64_t crc, std::span<uint8_t const> data) {
+    return crc64_slicing16(crc, data);
+}
+
+#endif
+
+} // namespace crypto::detail
+
+namespace crypto {
+
+namespace {
+
+using Kernel = uint64_t (*)(uint64_t, std::span<uint8_t const>);
+
+Kernel const kKernel = detail::crc64_clmul_supported()
+        ? detail::crc64_clmul
+        : detail::crc64_slicing16;
+
+} // namespace
+
+uint64_t crc64(std::span<uint8_t const> data) {
+    return kKernel(kDefaultSeed, data);
+}
+
+uint64_t crc64(uint64_t crc, std::span<uint8_t const> data) {
+    return kKernel(crc, data);
+}
+
+uint64_t crc64_combine(uint64_t crc_a, uint64_t crc_b, uint64_t size_b) {
+    return multiply_mod(x_pow_mod(size_b * 8), crc_a) ^ crc_b;
+}
+
 } // namespace crypto
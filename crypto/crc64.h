@@ -1,4 +1,3 @@
-
 #pragma once
 
 #include <cstdint>
@@ -10,4 +9,25 @@ uint64_t crc64(std::span<uint8_t const> data);
 
 uint64_t crc64(uint64_t crc, std::span<uint8_t const> data);
 
+/// the crc of a followed by b, given the crc of each and b's size
+uint64_t crc64_combine(uint64_t crc_a, uint64_t crc_b, uint64_t size_b);
+
+namespace detail {
+
+// the individual kernels crc64() picks from, for tests and benchmarks
+
+uint64_t crc64_bytewise(uint64_t crc, std::span<uint8_t const> data);
+
+uint64_t crc64_slicing8(uint64_t crc, std::span<uint8_t const> data);
+
+uint64_t crc64_slicing16(uint64_t crc, std::span<uint8_t const> data);
+
+/// folds with carry-less multiplication, only usable when
+/// crc64_clmul_supported()
+uint64_t crc64_clmul(uint64_t crc, std::span<uint8_t const> data);
+
+bool crc64_clmul_supported();
+
+} // namespace detail
+
 } // namespace crypto
@@ -1,7 +1,7 @@
 #include "crypto.h"
 
 Keypair Keypair::generate() {
-    std::array<uint8_t, kPrivkeySize> privkey{};
+    SecureArray<uint8_t> privkey(kPrivkeySize);
     std::array<uint8_t, kPubkeySize> pubkey{};
 
     crypto_sign_keypair(pubkey.data(), privkey.data());
@@ -14,7 +14,7 @@ Keypair Keypair::generate() {
 
 Keypair Keypair::generate_from(
         std::array<uint8_t, crypto_sign_SEEDBYTES> seed) {
-    std::array<uint8_t, kPrivkeySize> privkey{};
+    SecureArray<uint8_t> privkey(kPrivkeySize);
     std::array<uint8_t, kPubkeySize> pubkey{};
 
     crypto_sign_seed_keypair(pubkey.data(), privkey.data(), seed.data());
@@ -32,15 +32,12 @@ Keypair Keypair::generate_from(
 // }
 
 std::optional<Pubkey> Pubkey::from_base64(std::string_view base64) {
-    std::string decoded;
-    if (!absl::Base64Unescape(base64, &decoded)
-            || decoded.size() != kPubkeySize) {
+    std::array<uint8_t, kPubkeySize> bytes{};
+    if (crypto::base64_decoded_size(base64) != kPubkeySize
+            || !crypto::base64_decode(base64, bytes)) {
         return std::nullopt;
     }
 
-    std::array<uint8_t, kPubkeySize> bytes{};
-    std::copy(decoded.begin(), decoded.end(), bytes.begin());
-
     return Pubkey{std::move(bytes)};
 }
 
@@ -51,62 +48,101 @@ bool Pubkey::verify(absl::Span<uint8_t const> bytes,
             == 0;
 }
 
-std::string Pubkey::to_string() const {
-    std::string buffer{};
-    for (uint8_t byte : bytes_) {
-        absl::StrAppendFormat(&buffer, "%02x", byte);
+std::vector<size_t> verify_batch(std::span<SignedMessage const> batch) {
+    // libsodium has no multi-scalar multiplication, and a batch equation
+    // built from its single scalar multiplications costs more than
+    // checking each signature on its own. the batch api still lets the
+    // receive path amortize everything around the check.
+    std::vector<size_t> invalid;
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        SignedMessage const &item = batch[i];
+        if (item.pubkey.size() != kPubkeySize
+                || item.signature.size() != kSignatureSize
+                || crypto_sign_verify_detached(item.signature.data(),
+                           item.message.data(),
+                           item.message.size(),
+                           item.pubkey.data())
+                        != 0) {
+            invalid.push_back(i);
+        }
     }
 
-    return buffer;
+    return invalid;
+}
+
+std::string Pubkey::to_string() const {
+    return crypto::hex_string(bytes_);
 }
 
 std::string Pubkey::to_base64() const {
-    return absl::Base64Escape(absl::string_view{
-            reinterpret_cast<char const *>(bytes_.data()), bytes_.size()});
+    return crypto::base64_string(bytes_);
 }
 
 std::vector<uint8_t> Pubkey::encrypt_to(std::span<uint8_t> message) {
-    std::vector<uint8_t> ciphertext(message.size() + crypto_box_SEALBYTES);
-    crypto_box_seal(
-            ciphertext.data(), message.data(), message.size(), bytes_.data());
+    std::vector<uint8_t> ciphertext(message.size() + kSealOverhead);
+    if (!seal_into(message, ciphertext)) {
+        return {};
+    }
     return ciphertext;
 }
 
+bool Pubkey::seal_into(
+        std::span<uint8_t const> message, std::span<uint8_t> out) const {
+    if (out.size() != message.size() + kSealOverhead) {
+        return false;
+    }
+
+    // sealed boxes take x25519 keys, ours are ed25519
+    std::array<uint8_t, crypto_box_PUBLICKEYBYTES> box_pubkey{};
+    if (crypto_sign_ed25519_pk_to_curve25519(box_pubkey.data(), bytes_.data())
+            != 0) {
+        return false;
+    }
+
+    // the ciphertext goes after the ephemeral key and the tag, so a message
+    // right after the headroom is encrypted where it lies
+    return crypto_box_seal(out.data(),
+                   message.data(),
+                   message.size(),
+                   box_pubkey.data())
+            == 0;
+}
+
 std::optional<PeerId> PeerId::from_base64(std::string_view base64) {
-    std::string decoded;
-    if (!absl::Base64Unescape(base64, &decoded)) {
+    PeerId id{};
+    if (crypto::base64_decoded_size(base64) != kPeerIdSize
+            || !crypto::base64_decode(base64, id.bytes)) {
         return std::nullopt;
     }
 
-    return PeerId{std::vector<uint8_t>(decoded.begin(), decoded.end())};
+    return id;
 }
 
 PeerId PeerId::from_pubkey(Pubkey const &pubkey) {
-    std::vector<uint8_t> bytes(crypto_hash_sha256_BYTES);
+    PeerId id{};
     crypto_hash_sha256(
-            bytes.data(), pubkey.data().data(), pubkey.data().size());
+            id.bytes.data(), pubkey.data().data(), pubkey.data().size());
 
-    return PeerId{bytes};
+    return id;
 }
 
 std::string PeerId::to_base64() const {
-    return absl::Base64Escape(absl::string_view{
-            reinterpret_cast<char const *>(bytes.data()), bytes.size()});
+    return crypto::base64_string(bytes);
 }
 
 std::string PeerId::to_string() const {
-    std::string buffer{};
-    for (uint8_t byte : bytes) {
-        absl::StrAppendFormat(&buffer, "%02x", byte);
-    }
-
-    return buffer;
+    return crypto::hex_string(bytes);
 }
 
-Privkey::Privkey(std::array<uint8_t, kPrivkeySize> &&bytes) : bytes_{bytes} {
-    std::fill(bytes.begin(), bytes.end(), 0);
+Privkey::Privkey(std::array<uint8_t, kPrivkeySize> &&bytes)
+    : bytes_(kPrivkeySize) {
+    std::ranges::copy(bytes, bytes_.begin());
+    sodium_memzero(bytes.data(), bytes.size());
 }
 
+Privkey::Privkey(SecureArray<uint8_t> bytes) : bytes_{std::move(bytes)} {}
+
 // Privkey::Privkey(doomday::Ed25519FieldPoint &&field_point) : bytes_{} {
 //     std::copy(field_point.limbs().begin(),
 //             field_point.limbs().end(),
@@ -114,40 +150,62 @@ Privkey::Privkey(std::array<uint8_t, kPrivkeySize> &&bytes) : bytes_{bytes} {
 //     // TODO(): zero out field_point
 // }
 
-Privkey::Privkey(Privkey &&other) noexcept : bytes_{} {
-    std::copy(bytes_.begin(), bytes_.end(), bytes_.begin());
-    std::fill(other.bytes_.begin(), other.bytes_.end(), 0);
-}
-
 std::optional<Privkey> Privkey::from_base64(std::string_view base64) {
-    std::string decoded;
-    if (!absl::Base64Unescape(base64, &decoded)
-            || decoded.size() != kPrivkeySize) {
+    if (crypto::base64_decoded_size(base64) != kPrivkeySize) {
         return std::nullopt;
     }
 
-    std::array<uint8_t, kPrivkeySize> bytes{};
-    std::copy(decoded.begin(), decoded.end(), bytes.begin());
-    std::fill(decoded.begin(), decoded.end(), 0);
+    // decoded straight into the arena, with no copy to erase
+    SecureArray<uint8_t> bytes(kPrivkeySize);
+    if (!crypto::base64_decode(base64, bytes.span())) {
+        return std::nullopt;
+    }
 
     return Privkey{std::move(bytes)};
 }
 
 std::optional<std::vector<uint8_t>> Privkey::decrypt(
         std::span<uint8_t> ciphertext) const {
-    std::vector<uint8_t> message(ciphertext.size() - crypto_box_SEALBYTES);
-    if (crypto_box_seal_open(message.data(),
-                ciphertext.data(),
-                ciphertext.size(),
-                bytes_.data(),
-                bytes_.data())
-            != 0) {
+    if (ciphertext.size() < kSealOverhead) {
+        return std::nullopt;
+    }
+
+    std::vector<uint8_t> message(ciphertext.size() - kSealOverhead);
+    if (!open_into(ciphertext, message)) {
         return std::nullopt;
     }
 
     return message;
 }
 
+bool Privkey::open_into(
+        std::span<uint8_t const> sealed, std::span<uint8_t> out) const {
+    if (sealed.size() < kSealOverhead
+            || out.size() != sealed.size() - kSealOverhead) {
+        return false;
+    }
+
+    // the ed25519 secret key is the seed followed by the public key
+    std::array<uint8_t, crypto_box_PUBLICKEYBYTES> box_pubkey{};
+    std::array<uint8_t, crypto_box_SECRETKEYBYTES> box_privkey{};
+    if (crypto_sign_ed25519_pk_to_curve25519(
+                box_pubkey.data(), bytes_.data() + crypto_sign_SEEDBYTES)
+            != 0) {
+        return false;
+    }
+    crypto_sign_ed25519_sk_to_curve25519(box_privkey.data(), bytes_.data());
+
+    bool opened = crypto_box_seal_open(out.data(),
+                          sealed.data(),
+                          sealed.size(),
+                          box_pubkey.data(),
+                          box_privkey.data())
+            == 0;
+    sodium_memzero(box_privkey.data(), box_privkey.size());
+
+    return opened;
+}
+
 Signature Privkey::sign(std::span<uint8_t> message) const {
     std::array<uint8_t, kSignatureSize> signature{};
     crypto_sign_detached(signature.data(),
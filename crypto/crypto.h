@@ -1,18 +1,28 @@
+#pragma once
+
 #include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <optional>
+#include <span>
 #include <string_view>
 #include <vector>
 
-#include <absl/strings/escaping.h>
 #include <absl/strings/str_format.h>
 #include <absl/types/span.h>
+#include <fmt/core.h>
 #include <sodium.h>
 
+#include "crypto/encoding.h"
+#include "crypto/secure_arena.h"
+
 constexpr uint32_t kPubkeySize = crypto_sign_PUBLICKEYBYTES;
 constexpr uint32_t kPrivkeySize = crypto_sign_SECRETKEYBYTES;
 constexpr uint32_t kSignatureSize = crypto_sign_BYTES;
+/// what sealing adds to a message: an ephemeral key and a tag
+constexpr uint32_t kSealOverhead = crypto_box_SEALBYTES;
 
 #define chksum_t uint64_t
 
@@ -42,6 +52,21 @@ public:
 
     std::vector<uint8_t> encrypt_to(std::span<uint8_t> message);
 
+    /// seals `message` into `out`, which must hold exactly
+    /// message.size() + kSealOverhead bytes. `out` may overlap `message`
+    /// as long as it starts kSealOverhead bytes before it.
+    bool seal_into(std::span<uint8_t const> message,
+            std::span<uint8_t> out) const;
+
+    /// seals a message that starts kSealOverhead bytes into `buffer`,
+    /// filling the headroom in front of it
+    bool seal_in_place(std::span<uint8_t> buffer) const {
+        if (buffer.size() < kSealOverhead) {
+            return false;
+        }
+        return seal_into(buffer.subspan(kSealOverhead), buffer);
+    }
+
     bool operator==(Pubkey const &other) const {
         // not secret data
         return other.bytes_ == bytes_;
@@ -53,6 +78,19 @@ private:
     std::array<uint8_t, kPubkeySize> bytes_;
 };
 
+/// prints hex from a buffer on the stack, unlike to_string
+template<>
+struct fmt::formatter<Pubkey> {
+    constexpr auto parse(format_parse_context &ctx) const { return ctx.end(); }
+
+    template<typename FormatContext>
+    auto format(Pubkey const &pubkey, FormatContext &ctx) const {
+        std::array<char, crypto::hex_encoded_size(kPubkeySize)> hex;
+        crypto::hex_encode(pubkey.data(), hex);
+        return std::ranges::copy(hex, ctx.out()).out;
+    }
+};
+
 struct Signature {
     std::array<uint8_t, kSignatureSize> bytes;
 
@@ -72,8 +110,24 @@ struct Signature {
     }
 };
 
+/// a detached signature to check with verify_batch
+struct SignedMessage {
+    std::span<uint8_t const> pubkey;
+    std::span<uint8_t const> message;
+    std::span<uint8_t const> signature;
+};
+
+/// checks a burst of signatures, returning the indices of the ones that do
+/// not hold. an empty result means the whole batch is authentic.
+std::vector<size_t> verify_batch(std::span<SignedMessage const> batch);
+
+constexpr uint32_t kPeerIdSize = crypto_hash_sha256_BYTES;
+
+/// names a peer: the SHA-256 of its pubkey, computed once by from_pubkey.
+/// the digest is already uniform, so its leading bytes are the hash that
+/// tables key on, nothing is hashed again on lookup.
 struct PeerId {
-    std::vector<uint8_t> bytes;
+    std::array<uint8_t, kPeerIdSize> bytes;
 
     static std::optional<PeerId> from_base64(std::string_view base64);
 
@@ -82,31 +136,79 @@ struct PeerId {
     std::string to_base64() const;
 
     std::string to_string() const;
+
+    uint64_t hash() const {
+        uint64_t value = 0;
+        std::memcpy(&value, bytes.data(), sizeof(value));
+        return value;
+    }
+
+    auto operator<=>(PeerId const &other) const = default;
+};
+
+template<>
+struct std::hash<PeerId> {
+    size_t operator()(PeerId const &id) const noexcept { return id.hash(); }
 };
 
+template<>
+struct fmt::formatter<PeerId> {
+    constexpr auto parse(format_parse_context &ctx) const { return ctx.end(); }
+
+    template<typename FormatContext>
+    auto format(PeerId const &id, FormatContext &ctx) const {
+        std::array<char, crypto::hex_encoded_size(kPeerIdSize)> hex;
+        crypto::hex_encode(id.bytes, hex);
+        return std::ranges::copy(hex, ctx.out()).out;
+    }
+};
+
+/// an ed25519 secret key, kept in the SecureArena
 class Privkey {
 public:
+    /// copies `bytes` into the arena and erases them
     explicit Privkey(std::array<uint8_t, kPrivkeySize> &&bytes);
 
-    Privkey(Privkey &&other) noexcept;
+    /// takes a key that was written straight into the arena
+    explicit Privkey(SecureArray<uint8_t> bytes);
 
-    Privkey(Privkey const &) = delete;
+    Privkey(Privkey &&other) noexcept = default;
 
-    ~Privkey() { std::fill(bytes_.begin(), bytes_.end(), 0); }
+    Privkey(Privkey const &) = delete;
 
     static std::optional<Privkey> from_base64(std::string_view base64);
 
-    std::array<uint8_t, kPrivkeySize> const &data() const { return bytes_; }
+    std::span<uint8_t const, kPrivkeySize> data() const {
+        return std::span<uint8_t const, kPrivkeySize>{
+                bytes_.data(), kPrivkeySize};
+    }
 
     Signature sign(std::span<uint8_t> message) const;
 
     std::optional<std::vector<uint8_t>> decrypt(
             std::span<uint8_t> ciphertext) const;
 
+    /// opens a message sealed to our pubkey into `out`, which must hold
+    /// sealed.size() - kSealOverhead bytes. `out` may overlap `sealed` as
+    /// long as it does not start after sealed.data() + kSealOverhead.
+    bool open_into(std::span<uint8_t const> sealed,
+            std::span<uint8_t> out) const;
+
+    /// opens `buffer` in place, returning the message, which is what
+    /// follows the first kSealOverhead bytes
+    std::optional<std::span<uint8_t>> open_in_place(
+            std::span<uint8_t> buffer) const {
+        if (buffer.size() < kSealOverhead
+                || !open_into(buffer, buffer.subspan(kSealOverhead))) {
+            return std::nullopt;
+        }
+        return buffer.subspan(kSealOverhead);
+    }
+
     bool operator<=>(Privkey const &other) = delete;
 
 private:
-    std::array<uint8_t, kPrivkeySize> bytes_;
+    SecureArray<uint8_t> bytes_;
 };
 
 struct Keypair {
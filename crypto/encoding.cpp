@@ -0,0 +1,584 @@
+#include "crypto/encoding.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+alignas(16) constexpr char kHexDigits[] = "0123456789abcdef";
+
+alignas(16) constexpr char kBase64Alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/// in the decode tables for what is not a digit
+constexpr uint8_t kInvalid = 0xff;
+
+constexpr std::array<uint8_t, 256> decode_table(std::string_view digits) {
+    std::array<uint8_t, 256> table{};
+    table.fill(kInvalid);
+    for (size_t i = 0; i < digits.size(); ++i) {
+        table[static_cast<uint8_t>(digits[i])] = static_cast<uint8_t>(i);
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> kHexValues = [] {
+    std::array<uint8_t, 256> table = decode_table(kHexDigits);
+    for (char c = 'A'; c <= 'F'; ++c) {
+        table[static_cast<uint8_t>(c)] = static_cast<uint8_t>(c - 'A' + 10);
+    }
+    return table;
+}();
+
+alignas(16) constexpr std::array<uint8_t, 256> kBase64Values =
+        decode_table(kBase64Alphabet);
+
+/// `base64` without its padding, or nullopt if the padding is out of place
+std::optional<std::string_view> strip_padding(std::string_view base64) {
+    size_t padding = 0;
+    while (padding < 2 && padding < base64.size()
+            && base64[base64.size() - 1 - padding] == '=') {
+        ++padding;
+    }
+
+    // padding only ever fills up the last quantum
+    if (padding > 0 && base64.size() % 4 != 0) {
+        return std::nullopt;
+    }
+
+    std::string_view chars = base64.substr(0, base64.size() - padding);
+    if (chars.size() % 4 == 1) {
+        return std::nullopt;
+    }
+
+    return chars;
+}
+
+#if defined(__SSSE3__)
+
+__m128i load(void const *at) {
+    return _mm_loadu_si128(static_cast<__m128i const *>(at));
+}
+
+void store(void *at, __m128i value) {
+    _mm_storeu_si128(static_cast<__m128i *>(at), value);
+}
+
+/// the values of 16 hex digits, false if any is not one
+bool hex_values(__m128i chars, __m128i &values) {
+    // sets the bit that tells lower from upper case letters
+    __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    // bytes past 0x7f compare as negative, which no range below holds
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+            _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    __m128i letter =
+            _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                    _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xffff) {
+        return false;
+    }
+
+    values = _mm_or_si128(
+            _mm_and_si128(digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+            _mm_and_si128(
+                    letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    return true;
+}
+
+#endif
+
+/// encodes whole vectors and returns how many bytes it took
+size_t hex_encode_vector(uint8_t const *bytes, size_t size, char *out) {
+    size_t done = 0;
+
+#if defined(__AVX2__)
+    __m256i digits = _mm256_broadcastsi128_si256(load(kHexDigits));
+    __m256i nibble = _mm256_set1_epi8(0x0f);
+    for (; size - done >= 32; done += 32) {
+        __m256i chunk = _mm256_loadu_si256(
+                reinterpret_cast<__m256i const *>(bytes + done));
+        __m256i high = _mm256_shuffle_epi8(digits,
+                _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble));
+        __m256i low =
+                _mm256_shuffle_epi8(digits, _mm256_and_si256(chunk, nibble));
+
+        // unpacking interleaves within each 128-bit half, the permutes put
+        // the halves back in order
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
+        auto *at = reinterpret_cast<__m256i *>(out + 2 * done);
+        _mm256_storeu_si256(at, _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(
+                at + 1, _mm256_permute2x128_si256(first, second, 0x31));
+    }
+#endif
+
+#if defined(__SSSE3__)
+    __m128i digits_128 = load(kHexDigits);
+    __m128i nibble_128 = _mm_set1_epi8(0x0f);
+    for (; size - done >= 16; done += 16) {
+        __m128i chunk = load(bytes + done);
+        __m128i high = _mm_shuffle_epi8(digits_128,
+                _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble_128));
+        __m128i low = _mm_shuffle_epi8(
+                digits_128, _mm_and_si128(chunk, nibble_128));
+
+        store(out + 2 * done, _mm_unpacklo_epi8(high, low));
+        store(out + 2 * done + 16, _mm_unpackhi_epi8(high, low));
+    }
+#elif defined(__ARM_NEON)
+    uint8x16_t digits =
+            vld1q_u8(reinterpret_cast<uint8_t const *>(kHexDigits));
+    for (; size - done >= 16; done += 16) {
+        uint8x16_t chunk = vld1q_u8(bytes + done);
+        uint8x16x2_t pairs{{
+                vqtbl1q_u8(digits, vshrq_n_u8(chunk, 4)),
+                vqtbl1q_u8(digits, vandq_u8(chunk, vdupq_n_u8(0x0f))),
+        }};
+        // stores the two interleaved
+        vst2q_u8(reinterpret_cast<uint8_t *>(out + 2 * done), pairs);
+    }
+#endif
+
+    (void)bytes;
+    (void)size;
+    (void)out;
+    return done;
+}
+
+/// decodes whole vectors up to the first that is not all hex digits, and
+/// returns how many digits it took
+size_t hex_decode_vector(char const *hex, size_t size, uint8_t *out) {
+    size_t done = 0;
+
+#if defined(__SSSE3__)
+    // the first digit of a pair times 16, plus the second
+    __m128i weights = _mm_set1_epi16(0x0110);
+    for (; size - done >= 32; done += 32) {
+        __m128i first;
+        __m128i second;
+        if (!hex_values(load(hex + done), first)
+                || !hex_values(load(hex + done + 16), second)) {
+            break;
+        }
+
+        store(out + done / 2,
+                _mm_packus_epi16(_mm_maddubs_epi16(first, weights),
+                        _mm_maddubs_epi16(second, weights)));
+    }
+#elif defined(__ARM_NEON)
+    auto values = [](uint8x16_t chars, uint8x16_t &out) {
+        uint8x16_t lower = vorrq_u8(chars, vdupq_n_u8(0x20));
+        // below the bottom of a range wraps around past its top
+        uint8x16_t digit =
+                vcleq_u8(vsubq_u8(chars, vdupq_n_u8('0')), vdupq_n_u8(9));
+        uint8x16_t letter =
+                vcleq_u8(vsubq_u8(lower, vdupq_n_u8('a')), vdupq_n_u8(5));
+        if (vminvq_u8(vorrq_u8(digit, letter)) != 0xff) {
+            return false;
+        }
+
+        out = vbslq_u8(digit,
+                vsubq_u8(chars, vdupq_n_u8('0')),
+                vsubq_u8(lower, vdupq_n_u8('a' - 10)));
+        return true;
+    };
+
+    for (; size - done >= 32; done += 32) {
+        // the first digits of the pairs, and the second
+        uint8x16x2_t pairs =
+                vld2q_u8(reinterpret_cast<uint8_t const *>(hex + done));
+        uint8x16_t high;
+        uint8x16_t low;
+        if (!values(pairs.val[0], high) || !values(pairs.val[1], low)) {
+            break;
+        }
+
+        vst1q_u8(out + done / 2, vorrq_u8(vshlq_n_u8(high, 4), low));
+    }
+#endif
+
+    (void)hex;
+    (void)size;
+    (void)out;
+    return done;
+}
+
+size_t base64_encode_vector(uint8_t const *bytes, size_t size, char *out) {
+    size_t done = 0;
+    size_t written = 0;
+
+#if defined(__SSSE3__)
+    // takes 12 bytes of every 16 loaded, so 4 must follow them
+    for (; size - done >= 16; done += 12, written += 16) {
+        // every 32-bit lane gets bytes 1, 0, 2, 1 of its three
+        __m128i chunk = _mm_shuffle_epi8(load(bytes + done),
+                _mm_setr_epi8(
+                        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+        // moves the four 6-bit groups of each lane into a byte each, two
+        // with a multiply high and two with a multiply low
+        __m128i shifted_right = _mm_mulhi_epu16(
+                _mm_and_si128(chunk, _mm_set1_epi32(0x0fc0fc00)),
+                _mm_set1_epi32(0x04000040));
+        __m128i shifted_left = _mm_mullo_epi16(
+                _mm_and_si128(chunk, _mm_set1_epi32(0x003f03f0)),
+                _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(shifted_right, shifted_left);
+
+        // sorts the indices into the five runs of the alphabet, then adds
+        // each run's offset to ascii
+        __m128i run = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        run = _mm_or_si128(run, _mm_and_si128(upper, _mm_set1_epi8(13)));
+
+        __m128i offsets = _mm_setr_epi8('a' - 26,
+                '0' - 52,
+                '0' - 52,
+                '0' - 52,
+                '0' - 52,
+                '0' - 52,
+                '0' - 52,
+                '0' - 52,
+                '0' - 52,
+                '0' - 52,
+                '0' - 52,
+                '+' - 62,
+                '/' - 63,
+                'A',
+                0,
+                0);
+        store(out + written,
+                _mm_add_epi8(_mm_shuffle_epi8(offsets, run), indices));
+    }
+#elif defined(__ARM_NEON)
+    auto const *alphabet = reinterpret_cast<uint8_t const *>(kBase64Alphabet);
+    uint8x16x4_t table{{
+            vld1q_u8(alphabet),
+            vld1q_u8(alphabet + 16),
+            vld1q_u8(alphabet + 32),
+            vld1q_u8(alphabet + 48),
+    }};
+    uint8x16_t group = vdupq_n_u8(0x3f);
+
+    for (; size - done >= 48; done += 48, written += 64) {
+        // the first, second and third bytes of 16 triples
+        uint8x16x3_t in = vld3q_u8(bytes + done);
+
+        uint8x16x4_t indices{{
+                vshrq_n_u8(in.val[0], 2),
+                vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4),
+                                 vshrq_n_u8(in.val[1], 4)),
+                        group),
+                vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2),
+                                 vshrq_n_u8(in.val[2], 6)),
+                        group),
+                vandq_u8(in.val[2], group),
+        }};
+
+        uint8x16x4_t chars{{
+                vqtbl4q_u8(table, indices.val[0]),
+                vqtbl4q_u8(table, indices.val[1]),
+                vqtbl4q_u8(table, indices.val[2]),
+                vqtbl4q_u8(table, indices.val[3]),
+        }};
+        vst4q_u8(reinterpret_cast<uint8_t *>(out + written), chars);
+    }
+#endif
+
+    (void)bytes;
+    (void)size;
+    (void)out;
+    (void)written;
+    return done;
+}
+
+/// decodes whole vectors up to the first that is not all in the alphabet,
+/// and returns how many chars it took
+size_t base64_decode_vector(char const *base64, size_t size, uint8_t *out) {
+    size_t done = 0;
+    size_t written = 0;
+
+#if defined(__SSSE3__)
+    // a char is in the alphabet when the bits its low nibble maps to and
+    // the bits its high nibble maps to have none in common
+    __m128i low_classes = _mm_setr_epi8(0x15,
+            0x11,
+            0x11,
+            0x11,
+            0x11,
+            0x11,
+            0x11,
+            0x11,
+            0x11,
+            0x11,
+            0x13,
+            0x1a,
+            0x1b,
+            0x1b,
+            0x1b,
+            0x1a);
+    __m128i high_classes = _mm_setr_epi8(0x10,
+            0x10,
+            0x01,
+            0x02,
+            0x04,
+            0x08,
+            0x04,
+            0x08,
+            0x10,
+            0x10,
+            0x10,
+            0x10,
+            0x10,
+            0x10,
+            0x10,
+            0x10);
+    // what to add to a char to get its value, by its high nibble, with '/'
+    // moved down one
+    __m128i offsets = _mm_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i slash = _mm_set1_epi8('/');
+
+    for (; size - done >= 16; done += 16, written += 12) {
+        __m128i chars = load(base64 + done);
+        __m128i high = _mm_and_si128(_mm_srli_epi32(chars, 4), nibble);
+        __m128i low = _mm_and_si128(chars, nibble);
+
+        __m128i classes = _mm_and_si128(_mm_shuffle_epi8(low_classes, low),
+                _mm_shuffle_epi8(high_classes, high));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(classes, _mm_setzero_si128()))
+                != 0xffff) {
+            break;
+        }
+
+        __m128i values = _mm_add_epi8(chars,
+                _mm_shuffle_epi8(offsets,
+                        _mm_add_epi8(_mm_cmpeq_epi8(chars, slash), high)));
+
+        // joins the four 6-bit values of each lane into three bytes,
+        // pairwise and then the pairs, and drops the empty fourth byte
+        __m128i pairs =
+                _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i lanes = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        __m128i packed = _mm_shuffle_epi8(lanes,
+                _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                        -1, -1));
+
+        // 12 bytes, nothing past the end of `out`
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + written), packed);
+        auto tail = static_cast<uint32_t>(
+                _mm_cvtsi128_si32(_mm_srli_si128(packed, 8)));
+        std::memcpy(out + written + 8, &tail, sizeof(tail));
+    }
+#elif defined(__ARM_NEON)
+    // the values of chars below 128, split across two tables
+    uint8x16x4_t low_table{{
+            vld1q_u8(kBase64Values.data()),
+            vld1q_u8(kBase64Values.data() + 16),
+            vld1q_u8(kBase64Values.data() + 32),
+            vld1q_u8(kBase64Values.data() + 48),
+    }};
+    uint8x16x4_t high_table{{
+            vld1q_u8(kBase64Values.data() + 64),
+            vld1q_u8(kBase64Values.data() + 80),
+            vld1q_u8(kBase64Values.data() + 96),
+            vld1q_u8(kBase64Values.data() + 112),
+    }};
+
+    // chars past either table keep kInvalid
+    auto lookup = [&](uint8x16_t chars) {
+        uint8x16_t values =
+                vqtbx4q_u8(vdupq_n_u8(kInvalid), low_table, chars);
+        return vqtbx4q_u8(
+                values, high_table, vsubq_u8(chars, vdupq_n_u8(64)));
+    };
+
+    for (; size - done >= 64; done += 64, written += 48) {
+        // the first, second, third and fourth chars of 16 quantums
+        uint8x16x4_t in =
+                vld4q_u8(reinterpret_cast<uint8_t const *>(base64 + done));
+        uint8x16x4_t values{{
+                lookup(in.val[0]),
+                lookup(in.val[1]),
+                lookup(in.val[2]),
+                lookup(in.val[3]),
+        }};
+
+        uint8x16_t any = vorrq_u8(vorrq_u8(values.val[0], values.val[1]),
+                vorrq_u8(values.val[2], values.val[3]));
+        if (vmaxvq_u8(any) > 0x3f) {
+            break;
+        }
+
+        uint8x16x3_t bytes{{
+                vorrq_u8(vshlq_n_u8(values.val[0], 2),
+                        vshrq_n_u8(values.val[1], 4)),
+                vorrq_u8(vshlq_n_u8(values.val[1], 4),
+                        vshrq_n_u8(values.val[2], 2)),
+                vorrq_u8(vshlq_n_u8(values.val[2], 6), values.val[3]),
+        }};
+        vst3q_u8(out + written, bytes);
+    }
+#endif
+
+    (void)base64;
+    (void)size;
+    (void)out;
+    (void)written;
+    return done;
+}
+
+} // namespace
+
+namespace crypto {
+
+void hex_encode(std::span<uint8_t const> bytes, std::span<char> out) {
+    size_t done = hex_encode_vector(bytes.data(), bytes.size(), out.data());
+    detail::hex_encode_scalar(bytes.subspan(done), out.data() + 2 * done);
+}
+
+bool hex_decode(std::string_view hex, std::span<uint8_t> out) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+
+    size_t done = hex_decode_vector(hex.data(), hex.size(), out.data());
+    return detail::hex_decode_scalar(hex.substr(done), out.data() + done / 2);
+}
+
+std::string hex_string(std::span<uint8_t const> bytes) {
+    std::string result(hex_encoded_size(bytes.size()), '\0');
+    hex_encode(bytes, result);
+    return result;
+}
+
+void base64_encode(std::span<uint8_t const> bytes, std::span<char> out) {
+    size_t done = base64_encode_vector(bytes.data(), bytes.size(), out.data());
+    detail::base64_encode_scalar(
+            bytes.subspan(done), out.data() + done / 3 * 4);
+}
+
+std::optional<size_t> base64_decoded_size(std::string_view base64) {
+    std::optional<std::string_view> chars = strip_padding(base64);
+    if (!chars.has_value()) {
+        return std::nullopt;
+    }
+
+    size_t size = chars->size();
+    return size / 4 * 3 + (size % 4 == 0 ? 0 : size % 4 - 1);
+}
+
+bool base64_decode(std::string_view base64, std::span<uint8_t> out) {
+    std::optional<std::string_view> chars = strip_padding(base64);
+    if (!chars.has_value()) {
+        return false;
+    }
+
+    size_t done =
+            base64_decode_vector(chars->data(), chars->size(), out.data());
+    return detail::base64_decode_scalar(
+            chars->substr(done), out.data() + done / 4 * 3);
+}
+
+std::string base64_string(std::span<uint8_t const> bytes) {
+    std::string result(base64_encoded_size(bytes.size()), '\0');
+    base64_encode(bytes, result);
+    return result;
+}
+
+} // namespace crypto
+
+namespace crypto::detail {
+
+void hex_encode_scalar(std::span<uint8_t const> bytes, char *out) {
+    for (uint8_t byte : bytes) {
+        *out++ = kHexDigits[byte >> 4];
+        *out++ = kHexDigits[byte & 0x0f];
+    }
+}
+
+bool hex_decode_scalar(std::string_view hex, uint8_t *out) {
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        uint8_t high = kHexValues[static_cast<uint8_t>(hex[i])];
+        uint8_t low = kHexValues[static_cast<uint8_t>(hex[i + 1])];
+        if ((high | low) > 0x0f) {
+            return false;
+        }
+        *out++ = static_cast<uint8_t>(high << 4 | low);
+    }
+
+    return true;
+}
+
+void base64_encode_scalar(std::span<uint8_t const> bytes, char *out) {
+    size_t i = 0;
+    for (; bytes.size() - i >= 3; i += 3) {
+        uint32_t triple = static_cast<uint32_t>(bytes[i]) << 16
+                | static_cast<uint32_t>(bytes[i + 1]) << 8 | bytes[i + 2];
+        *out++ = kBase64Alphabet[triple >> 18];
+        *out++ = kBase64Alphabet[(triple >> 12) & 0x3f];
+        *out++ = kBase64Alphabet[(triple >> 6) & 0x3f];
+        *out++ = kBase64Alphabet[triple & 0x3f];
+    }
+
+    size_t left = bytes.size() - i;
+    if (left == 0) {
+        return;
+    }
+
+    uint32_t triple = static_cast<uint32_t>(bytes[i]) << 16;
+    if (left == 2) {
+        triple |= static_cast<uint32_t>(bytes[i + 1]) << 8;
+    }
+    *out++ = kBase64Alphabet[triple >> 18];
+    *out++ = kBase64Alphabet[(triple >> 12) & 0x3f];
+    *out++ = left == 2 ? kBase64Alphabet[(triple >> 6) & 0x3f] : '=';
+    *out++ = '=';
+}
+
+bool base64_decode_scalar(std::string_view base64, uint8_t *out) {
+    auto value = [&](size_t i) {
+        return kBase64Values[static_cast<uint8_t>(base64[i])];
+    };
+
+    // invalid chars carry the high bits, checked once at the end
+    uint8_t invalid = 0;
+    size_t i = 0;
+    for (; base64.size() - i >= 4; i += 4) {
+        uint8_t a = value(i);
+        uint8_t b = value(i + 1);
+        uint8_t c = value(i + 2);
+        uint8_t d = value(i + 3);
+        invalid |= a | b | c | d;
+
+        *out++ = static_cast<uint8_t>(a << 2 | b >> 4);
+        *out++ = static_cast<uint8_t>(b << 4 | c >> 2);
+        *out++ = static_cast<uint8_t>(c << 6 | d);
+    }
+
+    size_t left = base64.size() - i;
+    if (left >= 2) {
+        uint8_t a = value(i);
+        uint8_t b = value(i + 1);
+        invalid |= a | b;
+        *out++ = static_cast<uint8_t>(a << 2 | b >> 4);
+
+        if (left == 3) {
+            uint8_t c = value(i + 2);
+            invalid |= c;
+            *out++ = static_cast<uint8_t>(b << 4 | c >> 2);
+        }
+    }
+
+    return left != 1 && invalid <= 0x3f;
+}
+
+} // namespace crypto::detail
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+/// hex and base64 for keys, ids and uuids, written into buffers the caller
+/// owns, so printing one does not allocate or format byte by byte.
+///
+/// the vector kernels are picked at build time: AVX2 and SSSE3 on x86-64,
+/// NEON on aarch64. what is left over after the last full vector, and
+/// everything elsewhere, goes through the scalar kernels.
+namespace crypto {
+
+constexpr size_t hex_encoded_size(size_t size) {
+    return 2 * size;
+}
+
+/// lowercase hex of `bytes` into `out`, which must hold
+/// hex_encoded_size(bytes.size()) chars
+void hex_encode(std::span<uint8_t const> bytes, std::span<char> out);
+
+/// decodes hex of either case into `out`, which must hold hex.size() / 2
+/// bytes. false for an odd size or anything but a hex digit.
+bool hex_decode(std::string_view hex, std::span<uint8_t> out);
+
+std::string hex_string(std::span<uint8_t const> bytes);
+
+constexpr size_t base64_encoded_size(size_t size) {
+    return (size + 2) / 3 * 4;
+}
+
+/// the standard alphabet with padding, as absl::Base64Escape, into `out`,
+/// which must hold base64_encoded_size(bytes.size()) chars
+void base64_encode(std::span<uint8_t const> bytes, std::span<char> out);
+
+/// how many bytes `base64` decodes to, with or without padding, or nullopt
+/// if no base64 is that long or the padding is out of place
+std::optional<size_t> base64_decoded_size(std::string_view base64);
+
+/// decodes into `out`, which must hold base64_decoded_size(base64) bytes.
+/// false for anything outside the alphabet.
+bool base64_decode(std::string_view base64, std::span<uint8_t> out);
+
+std::string base64_string(std::span<uint8_t const> bytes);
+
+namespace detail {
+
+// the scalar kernels the above fall back on, for tests and benchmarks
+
+void hex_encode_scalar(std::span<uint8_t const> bytes, char *out);
+
+bool hex_decode_scalar(std::string_view hex, uint8_t *out);
+
+void base64_encode_scalar(std::span<uint8_t const> bytes, char *out);
+
+/// decodes whole and partial quantums, without padding
+bool base64_decode_scalar(std::string_view base64, uint8_t *out);
+
+} // namespace detail
+
+} // namespace crypto
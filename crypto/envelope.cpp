@@ -0,0 +1,264 @@
+#include "crypto/envelope.h"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+
+using BoxPubkey = std::array<uint8_t, crypto_box_PUBLICKEYBYTES>;
+using PayloadKey =
+        std::array<uint8_t, crypto_aead_xchacha20poly1305_ietf_KEYBYTES>;
+
+constexpr size_t kCountOffset = crypto_box_PUBLICKEYBYTES;
+constexpr size_t kSlotsOffset = kCountOffset + sizeof(uint16_t);
+
+/// what a slot is derived from: the wrapping key, then the hint
+struct SlotSecret {
+    std::array<uint8_t, crypto_aead_xchacha20poly1305_ietf_KEYBYTES> key{};
+    std::array<uint8_t, kEnvelopeHintSize> hint{};
+
+    ~SlotSecret() { sodium_memzero(key.data(), key.size()); }
+};
+
+/// derives a slot from the x25519 secret between the ephemeral key and a
+/// recipient, bound to both their public keys
+std::optional<SlotSecret> slot_secret(std::span<uint8_t const> privkey,
+        std::span<uint8_t const> peer,
+        BoxPubkey const &ephemeral,
+        BoxPubkey const &recipient) {
+    std::array<uint8_t, crypto_scalarmult_BYTES> shared{};
+    if (crypto_scalarmult(shared.data(), privkey.data(), peer.data()) != 0) {
+        // a low order point
+        return std::nullopt;
+    }
+
+    std::array<uint8_t, sizeof(SlotSecret::key) + kEnvelopeHintSize> derived{};
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, nullptr, 0, derived.size());
+    crypto_generichash_update(&state, shared.data(), shared.size());
+    crypto_generichash_update(&state, ephemeral.data(), ephemeral.size());
+    crypto_generichash_update(&state, recipient.data(), recipient.size());
+    crypto_generichash_final(&state, derived.data(), derived.size());
+
+    SlotSecret secret;
+    std::copy_n(derived.begin(), secret.key.size(), secret.key.begin());
+    std::copy_n(derived.begin() + secret.key.size(),
+            secret.hint.size(),
+            secret.hint.begin());
+
+    sodium_memzero(shared.data(), shared.size());
+    sodium_memzero(derived.data(), derived.size());
+
+    return secret;
+}
+
+std::optional<BoxPubkey> box_pubkey(Pubkey const &pubkey) {
+    BoxPubkey converted{};
+    if (crypto_sign_ed25519_pk_to_curve25519(
+                converted.data(), pubkey.data().data())
+            != 0) {
+        return std::nullopt;
+    }
+    return converted;
+}
+
+// every wrapping key is used once, the ephemeral key is fresh per envelope
+constexpr std::array<uint8_t, crypto_aead_xchacha20poly1305_ietf_NPUBBYTES>
+        kWrapNonce{};
+
+} // namespace
+
+bool seal_envelope(std::span<uint8_t const> payload,
+        std::span<Pubkey const> recipients,
+        std::span<uint8_t> out) {
+    if (recipients.size() > kEnvelopeMaxRecipients
+            || out.size() != envelope_size(payload.size(), recipients.size())) {
+        return false;
+    }
+
+    BoxPubkey ephemeral{};
+    std::array<uint8_t, crypto_box_SECRETKEYBYTES> ephemeral_privkey{};
+    crypto_box_keypair(ephemeral.data(), ephemeral_privkey.data());
+
+    PayloadKey payload_key{};
+    crypto_aead_xchacha20poly1305_ietf_keygen(payload_key.data());
+
+    std::copy(ephemeral.begin(), ephemeral.end(), out.begin());
+    auto count = static_cast<uint16_t>(recipients.size());
+    out[kCountOffset] = static_cast<uint8_t>(count);
+    out[kCountOffset + 1] = static_cast<uint8_t>(count >> 8);
+
+    bool sealed = true;
+    uint8_t *slot = out.data() + kSlotsOffset;
+    for (Pubkey const &recipient : recipients) {
+        auto recipient_box = box_pubkey(recipient);
+        auto secret = recipient_box.has_value()
+                ? slot_secret(ephemeral_privkey,
+                          recipient_box.value(),
+                          ephemeral,
+                          recipient_box.value())
+                : std::nullopt;
+        if (!secret.has_value()) {
+            sealed = false;
+            break;
+        }
+
+        std::copy(secret->hint.begin(), secret->hint.end(), slot);
+        crypto_aead_xchacha20poly1305_ietf_encrypt(slot + kEnvelopeHintSize,
+                nullptr,
+                payload_key.data(),
+                payload_key.size(),
+                nullptr,
+                0,
+                nullptr,
+                kWrapNonce.data(),
+                secret->key.data());
+
+        slot += kEnvelopeSlotSize;
+    }
+
+    if (sealed) {
+        // the header is authenticated too, so slots cannot be swapped out
+        uint8_t *nonce = slot;
+        randombytes_buf(nonce, crypto_aead_xchacha20poly1305_ietf_NPUBBYTES);
+
+        size_t header_size = static_cast<size_t>(nonce - out.data());
+        crypto_aead_xchacha20poly1305_ietf_encrypt(
+                nonce + crypto_aead_xchacha20poly1305_ietf_NPUBBYTES,
+                nullptr,
+                payload.data(),
+                payload.size(),
+                out.data(),
+                header_size,
+                nullptr,
+                nonce,
+                payload_key.data());
+    }
+
+    sodium_memzero(ephemeral_privkey.data(), ephemeral_privkey.size());
+    sodium_memzero(payload_key.data(), payload_key.size());
+
+    return sealed;
+}
+
+std::optional<std::vector<uint8_t>> seal_envelope(
+        std::span<uint8_t const> payload, std::span<Pubkey const> recipients) {
+    std::vector<uint8_t> envelope(
+            envelope_size(payload.size(), recipients.size()));
+    if (!seal_envelope(payload, recipients, envelope)) {
+        return std::nullopt;
+    }
+
+    return envelope;
+}
+
+std::optional<size_t> envelope_payload_size(
+        std::span<uint8_t const> envelope) {
+    if (envelope.size() < envelope_size(0, 0)) {
+        return std::nullopt;
+    }
+
+    size_t count = envelope[kCountOffset]
+            | static_cast<size_t>(envelope[kCountOffset + 1]) << 8;
+    size_t empty_size = envelope_size(0, count);
+    if (envelope.size() < empty_size) {
+        return std::nullopt;
+    }
+
+    return envelope.size() - empty_size;
+}
+
+bool open_envelope(std::span<uint8_t const> envelope,
+        Keypair const &keypair,
+        std::span<uint8_t> out) {
+    auto payload_size = envelope_payload_size(envelope);
+    if (!payload_size.has_value() || out.size() != payload_size.value()) {
+        return false;
+    }
+
+    BoxPubkey ephemeral{};
+    std::copy_n(envelope.begin(), ephemeral.size(), ephemeral.begin());
+
+    auto own_box = box_pubkey(keypair.pubkey);
+    if (!own_box.has_value()) {
+        return false;
+    }
+
+    std::array<uint8_t, crypto_box_SECRETKEYBYTES> box_privkey{};
+    crypto_sign_ed25519_sk_to_curve25519(
+            box_privkey.data(), keypair.privkey.data().data());
+    auto secret =
+            slot_secret(box_privkey, ephemeral, ephemeral, own_box.value());
+    sodium_memzero(box_privkey.data(), box_privkey.size());
+
+    if (!secret.has_value()) {
+        return false;
+    }
+
+    size_t count = envelope[kCountOffset]
+            | static_cast<size_t>(envelope[kCountOffset + 1]) << 8;
+    auto slots = envelope.subspan(kSlotsOffset, count * kEnvelopeSlotSize);
+
+    PayloadKey payload_key{};
+    bool unwrapped = false;
+    for (size_t offset = 0; offset < slots.size() && !unwrapped;
+            offset += kEnvelopeSlotSize) {
+        auto slot = slots.subspan(offset, kEnvelopeSlotSize);
+        if (!std::ranges::equal(
+                    slot.first(kEnvelopeHintSize), secret->hint)) {
+            continue;
+        }
+
+        // a matching hint is all but certainly our slot, but a colliding
+        // one only costs a failed unwrap
+        unwrapped = crypto_aead_xchacha20poly1305_ietf_decrypt(
+                            payload_key.data(),
+                            nullptr,
+                            nullptr,
+                            slot.data() + kEnvelopeHintSize,
+                            slot.size() - kEnvelopeHintSize,
+                            nullptr,
+                            0,
+                            kWrapNonce.data(),
+                            secret->key.data())
+                == 0;
+    }
+
+    if (!unwrapped) {
+        return false;
+    }
+
+    size_t header_size = kSlotsOffset + slots.size();
+    uint8_t const *nonce = envelope.data() + header_size;
+    auto ciphertext = envelope.subspan(
+            header_size + crypto_aead_xchacha20poly1305_ietf_NPUBBYTES);
+
+    bool opened = crypto_aead_xchacha20poly1305_ietf_decrypt(out.data(),
+                          nullptr,
+                          nullptr,
+                          ciphertext.data(),
+                          ciphertext.size(),
+                          envelope.data(),
+                          header_size,
+                          nonce,
+                          payload_key.data())
+            == 0;
+    sodium_memzero(payload_key.data(), payload_key.size());
+
+    return opened;
+}
+
+std::optional<std::vector<uint8_t>> open_envelope(
+        std::span<uint8_t const> envelope, Keypair const &keypair) {
+    auto payload_size = envelope_payload_size(envelope);
+    if (!payload_size.has_value()) {
+        return std::nullopt;
+    }
+
+    std::vector<uint8_t> payload(payload_size.value());
+    if (!open_envelope(envelope, keypair, payload)) {
+        return std::nullopt;
+    }
+
+    return payload;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <sodium.h>
+
+#include "crypto/crypto.h"
+
+/// a payload encrypted once for many recipients.
+///
+/// the payload is sealed with a random key, and that key is wrapped for
+/// every recipient with a secret it shares with one ephemeral key:
+///
+///     ephemeral pubkey | recipient count (u16 le)
+///     | count * (hint | wrapped key) | nonce | sealed payload
+///
+/// a slot's hint is derived from the same shared secret as its wrapping
+/// key, so a recipient finds its slot with one scalar multiplication and
+/// no trial decryption, while the hints tell others nothing about who the
+/// recipients are.
+
+constexpr size_t kEnvelopeHintSize = 8;
+constexpr size_t kEnvelopeSlotSize = kEnvelopeHintSize
+        + crypto_aead_xchacha20poly1305_ietf_KEYBYTES
+        + crypto_aead_xchacha20poly1305_ietf_ABYTES;
+constexpr size_t kEnvelopeMaxRecipients = UINT16_MAX;
+
+/// the size of an envelope around `payload_size` bytes for `recipients`
+constexpr size_t envelope_size(size_t payload_size, size_t recipients) {
+    return crypto_box_PUBLICKEYBYTES + sizeof(uint16_t)
+            + recipients * kEnvelopeSlotSize
+            + crypto_aead_xchacha20poly1305_ietf_NPUBBYTES + payload_size
+            + crypto_aead_xchacha20poly1305_ietf_ABYTES;
+}
+
+/// seals `payload` into `out`, which must hold exactly
+/// envelope_size(payload.size(), recipients.size()) bytes
+bool seal_envelope(std::span<uint8_t const> payload,
+        std::span<Pubkey const> recipients,
+        std::span<uint8_t> out);
+
+std::optional<std::vector<uint8_t>> seal_envelope(
+        std::span<uint8_t const> payload, std::span<Pubkey const> recipients);
+
+/// the size of the payload in `envelope`, if it is well formed
+std::optional<size_t> envelope_payload_size(std::span<uint8_t const> envelope);
+
+/// opens an envelope addressed to `keypair` into `out`, which must hold
+/// exactly envelope_payload_size(envelope) bytes
+bool open_envelope(std::span<uint8_t const> envelope,
+        Keypair const &keypair,
+        std::span<uint8_t> out);
+
+std::optional<std::vector<uint8_t>> open_envelope(
+        std::span<uint8_t const> envelope, Keypair const &keypair);
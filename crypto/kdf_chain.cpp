@@ -1,5 +1,7 @@
 #include "crypto/kdf_chain.h"
 
+#include <algorithm>
+
 std::array<uint8_t, 2> constexpr kKDFChainInput{0x13, 0x37};
 
 namespace {
@@ -15,21 +17,77 @@ std::array<uint8_t, crypto_kdf_hkdf_sha512_KEYBYTES> kdf_hmac(
 
 } // namespace
 
-KDFChain::KDFChain(std::span<uint8_t> seed) {
-    root_key_.resize(seed.size());
-    std::copy(seed.begin(), seed.end(), root_key_.begin());
+KDFChain::KDFChain(std::span<uint8_t> seed, KDFChainOptions const &options)
+    : options_{options},
+      root_key_(seed.size()),
+      chain_key_(seed.size()),
+      ring_(std::max<size_t>(1, options.max_skipped + options.precompute)) {
+    std::ranges::copy(seed, root_key_.begin());
+    std::ranges::copy(seed, chain_key_.begin());
+
+    if (options_.precompute > 0) {
+        derive_through(options_.precompute - 1);
+    }
+}
+
+MessageKey KDFChain::next_key() {
+    // n_ is never behind the ring, and never more than the precomputed
+    // window ahead of the chain
+    return key_at(n_).value();
+}
+
+std::optional<MessageKey> KDFChain::key_at(uint64_t index) {
+    if (index >= derived_) {
+        if (index - derived_ >= options_.max_skip) {
+            return std::nullopt;
+        }
+        derive_through(index);
+    }
+
+    Slot &slot = ring_[index % ring_.size()];
+    if (!slot.present || slot.index != index) {
+        return std::nullopt;
+    }
 
-    chain_key_.resize(seed.size());
-    std::copy(seed.begin(), seed.end(), chain_key_.begin());
+    MessageKey key = slot.key;
+    erase(slot);
+
+    if (index >= n_) {
+        n_ = index + 1;
+        derive_through(n_ + options_.precompute - 1);
+    }
+
+    return key;
 }
 
-std::array<uint8_t, 32> KDFChain::next_key() {
-    std::array<uint8_t, 32> message_key{};
-    std::array<uint8_t, 64> hmac = kdf_hmac(chain_key_, kKDFChainInput);
-    n_++;
+void KDFChain::derive() {
+    std::array<uint8_t, 64> hmac =
+            kdf_hmac(chain_key_.span(), kKDFChainInput);
+
+    Slot &slot = ring_[derived_ % ring_.size()];
+    if (slot.present) {
+        // fell out of the window of late messages we wait for
+        erase(slot);
+    }
 
     std::copy_n(hmac.begin(), 32, chain_key_.begin());
-    std::copy_n(hmac.begin() + 32, 32, message_key.begin());
+    std::copy_n(hmac.begin() + 32, 32, slot.key.begin());
+    slot.index = derived_;
+    slot.present = true;
+    stored_++;
+    derived_++;
+
+    sodium_memzero(hmac.data(), hmac.size());
+}
+
+void KDFChain::derive_through(uint64_t index) {
+    while (derived_ <= index) {
+        derive();
+    }
+}
 
-    return message_key;
+void KDFChain::erase(Slot &slot) {
+    sodium_memzero(slot.key.data(), slot.key.size());
+    slot.present = false;
+    stored_--;
 }
@@ -1,18 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
 #include <span>
-#include <vector>
 
 #include <sodium.h>
 
+#include "crypto/secure_arena.h"
+
+using MessageKey = std::array<uint8_t, 32>;
+
+struct KDFChainOptions {
+    /// how many keys behind the chain are kept for late messages, older
+    /// ones are erased
+    size_t max_skipped = 1024;
+    /// the furthest key_at derives ahead in one call, so a bogus index
+    /// cannot make us spin
+    size_t max_skip = 8192;
+    /// keys derived ahead of the last one handed out, so that in-order
+    /// and slightly early messages never wait on HKDF
+    size_t precompute = 0;
+};
+
+/// a symmetric ratchet: every step derives the next chain key and a
+/// message key from the current chain key.
+///
+/// messages in a delay-tolerant mesh arrive out of order, so key_at hands
+/// out keys by index. the keys skipped on the way are kept in a ring
+/// indexed by their index modulo its size, which bounds it and makes a
+/// late message's lookup O(1). every key is handed out once and erased
+/// from the chain when it is, or when it falls out of the ring.
+///
+/// the chain keys and the ring live in the SecureArena, which zeroes them
+/// when the chain goes away.
 class KDFChain {
 public:
-    explicit KDFChain(std::span<uint8_t> seed);
+    explicit KDFChain(
+            std::span<uint8_t> seed, KDFChainOptions const &options = {});
+
+    KDFChain(KDFChain &&) noexcept = default;
+
+    KDFChain(KDFChain const &) = delete;
 
-    std::array<uint8_t, 32> next_key();
+    /// the key after the furthest one handed out so far
+    MessageKey next_key();
 
-    size_t n() const { return n_; }
+    /// the key for message `index`, or nullopt if it was already handed
+    /// out, was erased, or is more than max_skip ahead of the chain
+    std::optional<MessageKey> key_at(uint64_t index);
+
+    /// one past the furthest key handed out
+    uint64_t n() const { return n_; }
+
+    /// keys derived so far, handed out or not
+    uint64_t derived() const { return derived_; }
+
+    /// keys derived and still waiting to be handed out
+    size_t stored() const { return stored_; }
 
 private:
-    std::vector<uint8_t> root_key_;
-    std::vector<uint8_t> chain_key_;
-    size_t n_ = 0;
+    struct Slot {
+        uint64_t index = 0;
+        bool present = false;
+        MessageKey key{};
+    };
+
+    KDFChainOptions options_;
+    SecureArray<uint8_t> root_key_;
+    SecureArray<uint8_t> chain_key_;
+    /// skipped and precomputed keys, key i lives at i % size
+    SecureArray<Slot> ring_;
+    uint64_t n_ = 0;
+    uint64_t derived_ = 0;
+    size_t stored_ = 0;
+
+    /// advances the chain by one step, storing the key it yields
+    void derive();
+
+    /// derives until `index` is stored
+    void derive_through(uint64_t index);
+
+    void erase(Slot &slot);
 };
@@ -0,0 +1,100 @@
+#include "secure_arena.h"
+
+#include <sodium.h>
+
+SecureArena &SecureArena::global() {
+    static auto *arena = new SecureArena();
+    return *arena;
+}
+
+SecureArena::~SecureArena() {
+    for (void *slab : slabs_) {
+        sodium_free(slab);
+    }
+}
+
+void *SecureArena::allocate(size_t size) {
+    if (size > kSlabSize) {
+        void *block = sodium_malloc(size);
+        if (block == nullptr) {
+            return nullptr;
+        }
+        sodium_memzero(block, size);
+
+        std::scoped_lock lock(mutex_);
+        slabs_.push_back(block);
+        stats_.slabs++;
+        stats_.blocks++;
+        stats_.block_bytes += size;
+        return block;
+    }
+
+    size_t size_class = class_of(size);
+
+    std::scoped_lock lock(mutex_);
+    if (free_[size_class] == nullptr && !refill(size_class)) {
+        return nullptr;
+    }
+
+    FreeBlock *block = free_[size_class];
+    free_[size_class] = block->next;
+    // the rest of the block was zeroed when it was freed
+    sodium_memzero(block, sizeof(FreeBlock));
+
+    stats_.blocks++;
+    stats_.block_bytes += block_size(size_class);
+    return block;
+}
+
+void SecureArena::deallocate(void *block, size_t size) {
+    if (block == nullptr) {
+        return;
+    }
+
+    if (size > kSlabSize) {
+        std::scoped_lock lock(mutex_);
+        std::erase(slabs_, block);
+        stats_.slabs--;
+        stats_.blocks--;
+        stats_.block_bytes -= size;
+        sodium_free(block);
+        return;
+    }
+
+    size_t size_class = class_of(size);
+    sodium_memzero(block, block_size(size_class));
+
+    std::scoped_lock lock(mutex_);
+    auto *free_block = static_cast<FreeBlock *>(block);
+    free_block->next = free_[size_class];
+    free_[size_class] = free_block;
+
+    stats_.blocks--;
+    stats_.block_bytes -= block_size(size_class);
+}
+
+SecureArenaStats SecureArena::stats() const {
+    std::scoped_lock lock(mutex_);
+    return stats_;
+}
+
+bool SecureArena::refill(size_t size_class) {
+    // a slab is a multiple of the page size, so sodium_malloc, which puts
+    // the end of a block against its guard page, returns it page aligned
+    auto *slab = static_cast<uint8_t *>(sodium_malloc(kSlabSize));
+    if (slab == nullptr) {
+        return false;
+    }
+    sodium_memzero(slab, kSlabSize);
+    slabs_.push_back(slab);
+    stats_.slabs++;
+
+    size_t size = block_size(size_class);
+    for (size_t offset = kSlabSize; offset >= size; offset -= size) {
+        auto *block = reinterpret_cast<FreeBlock *>(slab + offset - size);
+        block->next = free_[size_class];
+        free_[size_class] = block;
+    }
+
+    return true;
+}
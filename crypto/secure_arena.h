@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct SecureArenaStats {
+    /// slabs taken from the system, each locked and kept out of core dumps
+    size_t slabs = 0;
+    /// blocks handed out and not yet released
+    size_t blocks = 0;
+    /// bytes in those blocks, rounded up to their size class
+    size_t block_bytes = 0;
+};
+
+/// memory for secrets: private keys, chain keys and skipped message keys.
+///
+/// sodium_malloc locks its pages, keeps them out of core dumps and puts
+/// guard pages around them, which takes several syscalls and at least
+/// three pages per call. that is fine once, not for every ratchet of
+/// thousands of contacts. the arena takes slabs from sodium_malloc and
+/// carves them into power-of-two blocks, with a free list per size, so a
+/// block is allocated and freed in O(1) without a syscall. blocks are
+/// zeroed when released, a fresh block is always all zero.
+///
+/// requests larger than a slab get a sodium_malloc of their own.
+class SecureArena {
+public:
+    static constexpr size_t kMinBlockSize = 32;
+    static constexpr size_t kSlabSize = 256 * 1024;
+
+    /// the arena every SecureArray uses unless told otherwise. never
+    /// destroyed, so secrets may outlive static destructors.
+    static SecureArena &global();
+
+    SecureArena() = default;
+
+    /// frees the slabs, which are zeroed by sodium_free
+    ~SecureArena();
+
+    SecureArena(SecureArena const &) = delete;
+
+    /// a zeroed block of at least `size` bytes, aligned for any
+    /// fundamental type, or nullptr if the system is out of memory
+    void *allocate(size_t size);
+
+    /// zeroes a block and takes it back. `size` is what it was allocated
+    /// with.
+    void deallocate(void *block, size_t size);
+
+    SecureArenaStats stats() const;
+
+private:
+    static constexpr size_t kClasses = std::countr_zero(kSlabSize)
+            - std::countr_zero(kMinBlockSize) + 1;
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    mutable std::mutex mutex_;
+    std::array<FreeBlock *, kClasses> free_{};
+    /// slabs and the blocks too large for them, all from sodium_malloc
+    std::vector<void *> slabs_;
+    SecureArenaStats stats_;
+
+    static size_t class_of(size_t size) {
+        return std::bit_width(std::max(size, kMinBlockSize) - 1)
+                - std::countr_zero(kMinBlockSize);
+    }
+
+    static size_t block_size(size_t size_class) {
+        return kMinBlockSize << size_class;
+    }
+
+    /// carves a new slab into free blocks of `size_class`
+    bool refill(size_t size_class);
+};
+
+/// a fixed number of trivially copyable values in a SecureArena, zeroed
+/// when released
+template<typename T>
+class SecureArray {
+    static_assert(std::is_trivially_copyable_v<T>
+            && std::is_trivially_destructible_v<T>);
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+
+public:
+    SecureArray() = default;
+
+    explicit SecureArray(
+            size_t size, SecureArena &arena = SecureArena::global())
+        : arena_{&arena}, size_{size} {
+        if (size_ == 0) {
+            return;
+        }
+
+        void *block = arena_->allocate(size_ * sizeof(T));
+        if (block == nullptr) {
+            throw std::bad_alloc{};
+        }
+        data_ = static_cast<T *>(block);
+        std::uninitialized_value_construct_n(data_, size_);
+    }
+
+    SecureArray(SecureArray &&other) noexcept
+        : arena_{std::exchange(other.arena_, nullptr)},
+          data_{std::exchange(other.data_, nullptr)},
+          size_{std::exchange(other.size_, 0)} {}
+
+    SecureArray &operator=(SecureArray &&other) noexcept {
+        if (this != &other) {
+            release();
+            arena_ = std::exchange(other.arena_, nullptr);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    SecureArray(SecureArray const &) = delete;
+
+    ~SecureArray() { release(); }
+
+    T *data() { return data_; }
+    T const *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T &operator[](size_t index) { return data_[index]; }
+    T const &operator[](size_t index) const { return data_[index]; }
+
+    T *begin() { return data_; }
+    T *end() { return data_ + size_; }
+    T const *begin() const { return data_; }
+    T const *end() const { return data_ + size_; }
+
+    std::span<T> span() { return {data_, size_}; }
+    std::span<T const> span() const { return {data_, size_}; }
+
+private:
+    SecureArena *arena_ = nullptr;
+    T *data_ = nullptr;
+    size_t size_ = 0;
+
+    void release() {
+        if (data_ != nullptr) {
+            arena_->deallocate(data_, size_ * sizeof(T));
+            data_ = nullptr;
+        }
+    }
+};
@@ -0,0 +1,229 @@
+#include "crypto/session.h"
+
+#include <algorithm>
+
+namespace {
+
+using Seed = std::array<uint8_t, crypto_kx_SESSIONKEYBYTES>;
+
+/// the directional seeds of a crypto_kx exchange, in the role picked by
+/// the long-term keys
+bool exchange(bool client,
+        std::span<uint8_t const> own_pubkey,
+        std::span<uint8_t const> own_privkey,
+        std::span<uint8_t const> peer_pubkey,
+        Seed &rx,
+        Seed &tx) {
+    int result = client ? crypto_kx_client_session_keys(rx.data(),
+                                  tx.data(),
+                                  own_pubkey.data(),
+                                  own_privkey.data(),
+                                  peer_pubkey.data())
+                        : crypto_kx_server_session_keys(rx.data(),
+                                  tx.data(),
+                                  own_pubkey.data(),
+                                  own_privkey.data(),
+                                  peer_pubkey.data());
+    return result == 0;
+}
+
+/// folds the fresh seed into the long-term one, in place
+void mix(Seed &seed, Seed const &fresh) {
+    crypto_generichash(seed.data(),
+            seed.size(),
+            seed.data(),
+            seed.size(),
+            fresh.data(),
+            fresh.size());
+}
+
+using Nonce = std::array<uint8_t, crypto_aead_chacha20poly1305_ietf_NPUBBYTES>;
+
+/// the counter, little endian, in the last eight bytes of the nonce
+Nonce counter_nonce(uint64_t counter) {
+    Nonce nonce{};
+    for (size_t i = 0; i < sizeof(counter); ++i) {
+        nonce[nonce.size() - sizeof(counter) + i] =
+                static_cast<uint8_t>(counter >> (8 * i));
+    }
+    return nonce;
+}
+
+} // namespace
+
+EphemeralKey EphemeralKey::generate() {
+    Public pubkey{};
+    SecureArray<uint8_t> secret{crypto_kx_SECRETKEYBYTES};
+    crypto_kx_keypair(pubkey.data(), secret.data());
+    return EphemeralKey{pubkey, std::move(secret)};
+}
+
+std::optional<Session> Session::establish(Keypair const &self,
+        EphemeralKey const &ephemeral,
+        Pubkey const &peer,
+        EphemeralKey::Public const &peer_ephemeral,
+        SessionOptions const &options) {
+    // a reflected handshake would give both directions the same keys
+    if (self.pubkey == peer || ephemeral.pubkey() == peer_ephemeral
+            || options.rekey_interval == 0) {
+        return std::nullopt;
+    }
+
+    std::array<uint8_t, crypto_kx_PUBLICKEYBYTES> own_pubkey{};
+    std::array<uint8_t, crypto_kx_SECRETKEYBYTES> own_privkey{};
+    std::array<uint8_t, crypto_kx_PUBLICKEYBYTES> peer_pubkey{};
+    if (crypto_sign_ed25519_pk_to_curve25519(
+                own_pubkey.data(), self.pubkey.data().data())
+                    != 0
+            || crypto_sign_ed25519_pk_to_curve25519(
+                       peer_pubkey.data(), peer.data().data())
+                    != 0) {
+        return std::nullopt;
+    }
+    crypto_sign_ed25519_sk_to_curve25519(
+            own_privkey.data(), self.privkey.data().data());
+
+    // both sides agree on who plays the client: the smaller pubkey
+    bool client = std::ranges::lexicographical_compare(
+            self.pubkey.data(), peer.data());
+
+    Seed rx_seed{};
+    Seed tx_seed{};
+    Seed fresh_rx_seed{};
+    Seed fresh_tx_seed{};
+    bool exchanged = exchange(client,
+                             own_pubkey,
+                             own_privkey,
+                             peer_pubkey,
+                             rx_seed,
+                             tx_seed)
+            && exchange(client,
+                    ephemeral.pubkey_,
+                    ephemeral.secret_.span(),
+                    peer_ephemeral,
+                    fresh_rx_seed,
+                    fresh_tx_seed);
+    sodium_memzero(own_privkey.data(), own_privkey.size());
+
+    if (exchanged) {
+        mix(rx_seed, fresh_rx_seed);
+        mix(tx_seed, fresh_tx_seed);
+    }
+    sodium_memzero(fresh_rx_seed.data(), fresh_rx_seed.size());
+    sodium_memzero(fresh_tx_seed.data(), fresh_tx_seed.size());
+
+    std::optional<Session> session;
+    if (exchanged) {
+        session.emplace(Session{options, tx_seed, rx_seed});
+    }
+
+    sodium_memzero(rx_seed.data(), rx_seed.size());
+    sodium_memzero(tx_seed.data(), tx_seed.size());
+
+    return session;
+}
+
+// keys are only ever taken in order, so the chains keep no ring of skipped
+// ones, which would take a locked block per connection
+Session::Session(SessionOptions const &options,
+        std::span<uint8_t> tx_seed,
+        std::span<uint8_t> rx_seed)
+    : options_{options},
+      tx_chain_{tx_seed, {.max_skipped = 0}},
+      rx_chain_{rx_seed, {.max_skipped = 0}} {
+    tx_key_ = tx_chain_.next_key();
+    rx_key_ = rx_chain_.next_key();
+    rx_next_key_ = rx_chain_.next_key();
+}
+
+Session::~Session() {
+    sodium_memzero(tx_key_.data(), tx_key_.size());
+    sodium_memzero(rx_key_.data(), rx_key_.size());
+    sodium_memzero(rx_next_key_.data(), rx_next_key_.size());
+}
+
+bool Session::seal_into(
+        std::span<uint8_t const> message, std::span<uint8_t> out) {
+    if (out.size() != message.size() + kSessionOverhead) {
+        return false;
+    }
+
+    if (tx_counter_ != 0 && tx_counter_ % options_.rekey_interval == 0) {
+        Key old = tx_key_;
+        tx_key_ = tx_chain_.next_key();
+        sodium_memzero(old.data(), old.size());
+    }
+
+    uint64_t counter = tx_counter_++;
+    Nonce nonce = counter_nonce(counter);
+
+    // the ciphertext goes where an in-place message already is
+    uint8_t *tag = out.data() + sizeof(counter);
+    uint8_t *ciphertext = tag + crypto_aead_chacha20poly1305_ietf_ABYTES;
+    crypto_aead_chacha20poly1305_ietf_encrypt_detached(ciphertext,
+            tag,
+            nullptr,
+            message.data(),
+            message.size(),
+            nullptr,
+            0,
+            nullptr,
+            nonce.data(),
+            tx_key_.data());
+
+    std::copy_n(nonce.end() - sizeof(counter), sizeof(counter), out.begin());
+
+    return true;
+}
+
+bool Session::open_into(
+        std::span<uint8_t const> sealed, std::span<uint8_t> out) {
+    if (sealed.size() < kSessionOverhead
+            || out.size() != sealed.size() - kSessionOverhead) {
+        return false;
+    }
+
+    uint64_t counter = 0;
+    for (size_t i = 0; i < sizeof(counter); ++i) {
+        counter |= static_cast<uint64_t>(sealed[i]) << (8 * i);
+    }
+    if (counter < rx_counter_) {
+        // a replay, or older than what we already accepted
+        return false;
+    }
+
+    uint64_t epoch = counter / options_.rekey_interval;
+    if (epoch > rx_epoch_ + 1) {
+        // a whole epoch went missing, or the counter is forged
+        return false;
+    }
+
+    bool next_epoch = epoch == rx_epoch_ + 1;
+    Key const &key = next_epoch ? rx_next_key_ : rx_key_;
+    Nonce nonce = counter_nonce(counter);
+
+    uint8_t const *tag = sealed.data() + sizeof(counter);
+    if (crypto_aead_chacha20poly1305_ietf_decrypt_detached(out.data(),
+                nullptr,
+                tag + crypto_aead_chacha20poly1305_ietf_ABYTES,
+                sealed.size() - kSessionOverhead,
+                tag,
+                nullptr,
+                0,
+                nonce.data(),
+                key.data())
+            != 0) {
+        return false;
+    }
+
+    // only ratchet once the peer proved it did too
+    if (next_epoch) {
+        sodium_memzero(rx_key_.data(), rx_key_.size());
+        rx_key_ = rx_next_key_;
+        rx_next_key_ = rx_chain_.next_key();
+        rx_epoch_ = epoch;
+    }
+    rx_counter_ = counter + 1;
+
+    return true;
+}
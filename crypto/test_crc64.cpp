@@ -1,3 +1,6 @@
+#include <cstdint>
+#include <random>
+#include <span>
 #include <vector>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
@@ -5,7 +8,61 @@
 
 #include "crc64.h"
 
+namespace {
+
+std::vector<uint8_t> random_bytes(size_t size, std::mt19937_64 &rng) {
+    std::vector<uint8_t> bytes(size);
+    for (auto &byte : bytes) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return bytes;
+}
+
+} // namespace
+
 TEST_CASE("Check(\"123456789\"): 0xe9c6d914c4b8d9ca") {
     std::vector<uint8_t> bytes{'1', '2', '3', '4', '5', '6', '7', '8', '9'};
     CHECK_EQ(crypto::crc64(bytes), 0xe9c6d914c4b8d9ca);
+    CHECK_EQ(crypto::detail::crc64_bytewise(0, bytes), 0xe9c6d914c4b8d9ca);
+    CHECK_EQ(crypto::detail::crc64_slicing8(0, bytes), 0xe9c6d914c4b8d9ca);
+    CHECK_EQ(crypto::detail::crc64_slicing16(0, bytes), 0xe9c6d914c4b8d9ca);
+}
+
+TEST_CASE("kernels agree with the bytewise crc") {
+    std::mt19937_64 rng{42};
+    auto bytes = random_bytes(4096 + 64, rng);
+
+    for (size_t size : {0, 1, 7, 8, 15, 16, 17, 63, 64, 65, 127, 128, 200,
+                 1000, 4096}) {
+        // unaligned starts too
+        for (size_t offset : {0, 1, 3, 8, 13}) {
+            std::span<uint8_t const> data{bytes.data() + offset, size};
+            uint64_t seed = rng();
+            uint64_t expected = crypto::detail::crc64_bytewise(seed, data);
+
+            CAPTURE(size);
+            CAPTURE(offset);
+            CHECK_EQ(crypto::detail::crc64_slicing8(seed, data), expected);
+            CHECK_EQ(crypto::detail::crc64_slicing16(seed, data), expected);
+            if (crypto::detail::crc64_clmul_supported()) {
+                CHECK_EQ(crypto::detail::crc64_clmul(seed, data), expected);
+            }
+            CHECK_EQ(crypto::crc64(seed, data), expected);
+        }
+    }
+}
+
+TEST_CASE("crc64_combine") {
+    std::mt19937_64 rng{7};
+    auto bytes = random_bytes(3000, rng);
+    std::span<uint8_t const> all{bytes};
+
+    for (size_t split : {0, 1, 9, 16, 100, 1500, 2999, 3000}) {
+        uint64_t crc_a = crypto::crc64(all.first(split));
+        uint64_t crc_b = crypto::crc64(all.subspan(split));
+
+        CAPTURE(split);
+        CHECK_EQ(crypto::crc64_combine(crc_a, crc_b, bytes.size() - split),
+                crypto::crc64(all));
+    }
 }
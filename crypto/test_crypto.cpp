@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "crypto.h"
+
+TEST_CASE("verify_batch") {
+    REQUIRE(sodium_init() >= 0);
+
+    std::vector<Keypair> keypairs;
+    std::vector<std::vector<uint8_t>> messages;
+    std::vector<Signature> signatures;
+
+    for (uint8_t i = 0; i < 16; ++i) {
+        Keypair &keypair = keypairs.emplace_back(Keypair::generate());
+        std::vector<uint8_t> &message =
+                messages.emplace_back(std::vector<uint8_t>(i + 1, i));
+        signatures.push_back(keypair.privkey.sign(message));
+    }
+
+    auto batch = [&] {
+        std::vector<SignedMessage> items;
+        for (size_t i = 0; i < keypairs.size(); ++i) {
+            items.push_back({
+                    .pubkey = keypairs[i].pubkey.data(),
+                    .message = messages[i],
+                    .signature = signatures[i].bytes,
+            });
+        }
+        return items;
+    };
+
+    SUBCASE("all valid") { CHECK(verify_batch(batch()).empty()); }
+
+    SUBCASE("empty") { CHECK(verify_batch({}).empty()); }
+
+    SUBCASE("finds the bad signatures") {
+        signatures[3].bytes[0] ^= 1;
+        messages[11][0] ^= 1;
+
+        std::vector<SignedMessage> items = batch();
+        // signed by someone else
+        items[7].pubkey = keypairs[8].pubkey.data();
+
+        std::vector<size_t> expected{3, 7, 11};
+        CHECK_EQ(verify_batch(items), expected);
+
+        signatures[3].bytes[0] ^= 1;
+        messages[11][0] ^= 1;
+    }
+
+    SUBCASE("rejects malformed items") {
+        std::vector<SignedMessage> items = batch();
+        items[0].signature = items[0].signature.first(kSignatureSize - 1);
+        items[1].pubkey = {};
+
+        std::vector<size_t> expected{0, 1};
+        CHECK_EQ(verify_batch(items), expected);
+    }
+}
+
+TEST_CASE("sealing") {
+    REQUIRE(sodium_init() >= 0);
+
+    Keypair keypair = Keypair::generate();
+    std::vector<uint8_t> message{'h', 'r', 'a', 'f', 'n'};
+
+    SUBCASE("into caller buffers") {
+        std::vector<uint8_t> sealed(message.size() + kSealOverhead);
+        REQUIRE(keypair.pubkey.seal_into(message, sealed));
+
+        std::vector<uint8_t> opened(message.size());
+        REQUIRE(keypair.privkey.open_into(sealed, opened));
+        CHECK_EQ(opened, message);
+
+        CHECK_FALSE(keypair.pubkey.seal_into(message, opened));
+        CHECK_FALSE(keypair.privkey.open_into(sealed, sealed));
+    }
+
+    SUBCASE("in place") {
+        std::vector<uint8_t> buffer(kSealOverhead);
+        buffer.insert(buffer.end(), message.begin(), message.end());
+
+        REQUIRE(keypair.pubkey.seal_in_place(buffer));
+
+        auto opened = keypair.privkey.open_in_place(buffer);
+        REQUIRE(opened.has_value());
+        CHECK(std::ranges::equal(opened.value(), message));
+    }
+
+    SUBCASE("only opens for the recipient") {
+        Keypair someone_else = Keypair::generate();
+        std::vector<uint8_t> sealed = keypair.pubkey.encrypt_to(message);
+
+        CHECK_FALSE(someone_else.privkey.decrypt(sealed).has_value());
+        CHECK_EQ(keypair.privkey.decrypt(sealed), message);
+    }
+
+    SUBCASE("rejects short input") {
+        std::vector<uint8_t> sealed(kSealOverhead - 1);
+        CHECK_FALSE(keypair.privkey.decrypt(sealed).has_value());
+        CHECK_FALSE(keypair.privkey.open_in_place(sealed).has_value());
+    }
+}
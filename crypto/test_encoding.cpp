@@ -0,0 +1,155 @@
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "encoding.h"
+
+namespace {
+
+std::vector<uint8_t> random_bytes(size_t size, std::mt19937_64 &rng) {
+    std::vector<uint8_t> bytes(size);
+    for (auto &byte : bytes) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return bytes;
+}
+
+std::span<uint8_t const> as_bytes(std::string_view str) {
+    return {reinterpret_cast<uint8_t const *>(str.data()), str.size()};
+}
+
+std::optional<std::vector<uint8_t>> from_base64(std::string_view base64) {
+    auto size = crypto::base64_decoded_size(base64);
+    if (!size.has_value()) {
+        return std::nullopt;
+    }
+
+    std::vector<uint8_t> bytes(size.value());
+    if (!crypto::base64_decode(base64, bytes)) {
+        return std::nullopt;
+    }
+    return bytes;
+}
+
+std::optional<std::vector<uint8_t>> from_hex(std::string_view hex) {
+    std::vector<uint8_t> bytes(hex.size() / 2);
+    if (!crypto::hex_decode(hex, bytes)) {
+        return std::nullopt;
+    }
+    return bytes;
+}
+
+/// sizes around every vector width, and a few larger
+constexpr size_t kSizes[] = {0, 1, 2, 3, 11, 12, 15, 16, 17, 31, 32, 33, 47,
+        48, 49, 63, 64, 65, 100, 1000};
+
+} // namespace
+
+TEST_CASE("hex") {
+    std::vector<uint8_t> bytes{0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef};
+    CHECK_EQ(crypto::hex_string(bytes), "0123456789abcdef");
+    CHECK_EQ(from_hex("0123456789ABCDEF"), bytes);
+    CHECK_EQ(from_hex("0123456789abcdef"), bytes);
+
+    SUBCASE("Rejects what is not hex") {
+        CHECK_FALSE(from_hex("abc").has_value());
+        CHECK_FALSE(from_hex("0g").has_value());
+        CHECK_FALSE(from_hex("-1").has_value());
+    }
+
+    SUBCASE("Every char in every vector lane") {
+        std::string hex(64, '0');
+        std::vector<uint8_t> out(32);
+        for (size_t position : {0, 17, 31, 32, 63}) {
+            for (int c = 0; c < 256; ++c) {
+                hex[position] = static_cast<char>(c);
+                bool digit = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')
+                        || (c >= 'A' && c <= 'F');
+                CHECK_EQ(crypto::hex_decode(hex, out), digit);
+            }
+            hex[position] = '0';
+        }
+    }
+
+    SUBCASE("Matches the scalar kernels") {
+        std::mt19937_64 rng{42};
+        for (size_t size : kSizes) {
+            auto input = random_bytes(size, rng);
+
+            std::string expected(crypto::hex_encoded_size(size), '\0');
+            crypto::detail::hex_encode_scalar(input, expected.data());
+            std::string hex = crypto::hex_string(input);
+            CHECK_EQ(hex, expected);
+            CHECK_EQ(from_hex(hex), input);
+        }
+    }
+}
+
+TEST_CASE("base64") {
+    // RFC 4648, section 10
+    std::pair<std::string_view, std::string_view> const vectors[] = {
+            {"", ""},
+            {"f", "Zg=="},
+            {"fo", "Zm8="},
+            {"foo", "Zm9v"},
+            {"foob", "Zm9vYg=="},
+            {"fooba", "Zm9vYmE="},
+            {"foobar", "Zm9vYmFy"},
+    };
+    for (auto [plain, encoded] : vectors) {
+        CHECK_EQ(crypto::base64_string(as_bytes(plain)), encoded);
+
+        auto decoded = from_base64(encoded);
+        REQUIRE(decoded.has_value());
+        CHECK_EQ(std::string(decoded->begin(), decoded->end()), plain);
+    }
+
+    SUBCASE("Padding is optional but not misplaced") {
+        CHECK_EQ(from_base64("Zm8"), from_base64("Zm8="));
+        CHECK_FALSE(from_base64("Zm8==").has_value());
+        CHECK_FALSE(from_base64("Zg=").has_value());
+        CHECK_FALSE(from_base64("Z===").has_value());
+        CHECK_FALSE(from_base64("Zm9vY").has_value());
+        CHECK_FALSE(from_base64("Zm=v").has_value());
+    }
+
+    SUBCASE("Every char in every vector lane") {
+        std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstu"
+                               "vwxyz0123456789+/";
+        std::string base64(128, 'A');
+        std::vector<uint8_t> out(96);
+        for (size_t position : {0, 11, 15, 16, 47, 63, 64, 127}) {
+            for (int c = 0; c < 256; ++c) {
+                base64[position] = static_cast<char>(c);
+                // the last char may be padding
+                bool valid = (c != 0
+                                     && alphabet.find(static_cast<char>(c))
+                                             != std::string::npos)
+                        || (position == base64.size() - 1 && c == '=');
+                CHECK_EQ(crypto::base64_decode(base64, out), valid);
+            }
+            base64[position] = 'A';
+        }
+    }
+
+    SUBCASE("Matches the scalar kernels") {
+        std::mt19937_64 rng{42};
+        for (size_t size : kSizes) {
+            auto input = random_bytes(size, rng);
+
+            std::string expected(crypto::base64_encoded_size(size), '\0');
+            crypto::detail::base64_encode_scalar(input, expected.data());
+            std::string base64 = crypto::base64_string(input);
+            CHECK_EQ(base64, expected);
+            CHECK_EQ(from_base64(base64), input);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "envelope.h"
+
+TEST_CASE("envelope") {
+    REQUIRE(sodium_init() >= 0);
+
+    std::vector<Keypair> keypairs;
+    std::vector<Pubkey> recipients;
+    for (int i = 0; i < 5; ++i) {
+        Keypair &keypair = keypairs.emplace_back(Keypair::generate());
+        recipients.push_back(keypair.pubkey);
+    }
+
+    std::vector<uint8_t> payload(300);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i);
+    }
+
+    auto envelope = seal_envelope(payload, recipients);
+    REQUIRE(envelope.has_value());
+
+    SUBCASE("grows by a slot per recipient") {
+        CHECK_EQ(envelope->size(),
+                envelope_size(payload.size(), recipients.size()));
+        CHECK_EQ(envelope_size(payload.size(), 6)
+                        - envelope_size(payload.size(), 5),
+                kEnvelopeSlotSize);
+        CHECK_EQ(envelope_payload_size(envelope.value()), payload.size());
+    }
+
+    SUBCASE("every recipient opens it") {
+        for (Keypair const &keypair : keypairs) {
+            CHECK_EQ(open_envelope(envelope.value(), keypair), payload);
+        }
+    }
+
+    SUBCASE("others cannot") {
+        Keypair outsider = Keypair::generate();
+        CHECK_FALSE(open_envelope(envelope.value(), outsider).has_value());
+    }
+
+    SUBCASE("tampering is detected") {
+        std::vector<uint8_t> tampered = envelope.value();
+
+        SUBCASE("payload") { tampered.back() ^= 1; }
+        SUBCASE("a slot") { tampered[envelope_size(0, 0)] ^= 1; }
+        SUBCASE("the recipient count") {
+            tampered[crypto_box_PUBLICKEYBYTES] ^= 1;
+        }
+
+        CHECK_FALSE(open_envelope(tampered, keypairs[0]).has_value());
+    }
+
+    SUBCASE("rejects truncated envelopes") {
+        std::vector<uint8_t> truncated(
+                envelope->begin(), envelope->begin() + envelope_size(0, 2));
+        CHECK_FALSE(envelope_payload_size(truncated).has_value());
+        CHECK_FALSE(open_envelope(truncated, keypairs[0]).has_value());
+    }
+
+    SUBCASE("writes into caller buffers") {
+        std::vector<uint8_t> out(envelope_size(payload.size(), 1));
+        std::vector<Pubkey> one{keypairs[2].pubkey};
+        REQUIRE(seal_envelope(payload, one, out));
+
+        std::vector<uint8_t> opened(payload.size());
+        CHECK(open_envelope(out, keypairs[2], opened));
+        CHECK_EQ(opened, payload);
+        CHECK_FALSE(seal_envelope(payload, one, opened));
+    }
+}
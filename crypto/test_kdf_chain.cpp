@@ -0,0 +1,89 @@
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "kdf_chain.h"
+
+namespace {
+
+std::array<uint8_t, 32> seed() {
+    std::array<uint8_t, 32> bytes{};
+    bytes.fill(7);
+    return bytes;
+}
+
+std::vector<MessageKey> in_order(size_t count) {
+    auto bytes = seed();
+    KDFChain chain{bytes};
+
+    std::vector<MessageKey> keys;
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(chain.next_key());
+    }
+    return keys;
+}
+
+} // namespace
+
+TEST_CASE("KDFChain") {
+    std::vector<MessageKey> expected = in_order(64);
+    auto bytes = seed();
+
+    SUBCASE("jumps ahead and keeps the skipped keys") {
+        KDFChain chain{bytes};
+
+        CHECK_EQ(chain.key_at(40), expected[40]);
+        CHECK_EQ(chain.n(), 41);
+        CHECK_EQ(chain.stored(), 40);
+
+        CHECK_EQ(chain.key_at(3), expected[3]);
+        CHECK_EQ(chain.key_at(39), expected[39]);
+        CHECK_EQ(chain.next_key(), expected[41]);
+        CHECK_EQ(chain.stored(), 38);
+    }
+
+    SUBCASE("hands every key out once") {
+        KDFChain chain{bytes};
+
+        CHECK(chain.key_at(5).has_value());
+        CHECK_FALSE(chain.key_at(5).has_value());
+        CHECK(chain.key_at(2).has_value());
+        CHECK_FALSE(chain.key_at(2).has_value());
+    }
+
+    SUBCASE("erases keys that fall out of the window") {
+        KDFChain chain{bytes, {.max_skipped = 8}};
+
+        CHECK_EQ(chain.key_at(20), expected[20]);
+        CHECK_FALSE(chain.key_at(11).has_value());
+        CHECK_EQ(chain.key_at(13), expected[13]);
+        CHECK_LE(chain.stored(), 8);
+    }
+
+    SUBCASE("refuses to skip too far") {
+        KDFChain chain{bytes, {.max_skip = 16}};
+
+        CHECK_FALSE(chain.key_at(16).has_value());
+        CHECK_EQ(chain.derived(), 0);
+        CHECK_EQ(chain.key_at(15), expected[15]);
+    }
+
+    SUBCASE("precomputes ahead") {
+        KDFChain chain{bytes, {.precompute = 4}};
+        CHECK_EQ(chain.derived(), 4);
+
+        CHECK_EQ(chain.next_key(), expected[0]);
+        CHECK_EQ(chain.derived(), 5);
+
+        CHECK_EQ(chain.key_at(10), expected[10]);
+        CHECK_EQ(chain.derived(), 15);
+
+        for (size_t i = 11; i < 30; ++i) {
+            CHECK_EQ(chain.next_key(), expected[i]);
+        }
+        CHECK_EQ(chain.key_at(4), expected[4]);
+    }
+}
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "crypto/secure_arena.h"
+
+TEST_CASE("SecureArena") {
+    SecureArena arena;
+
+    SUBCASE("blocks start zeroed and are reused zeroed") {
+        auto *block = static_cast<uint8_t *>(arena.allocate(48));
+        REQUIRE(block != nullptr);
+        CHECK(std::all_of(block, block + 64, [](uint8_t b) { return b == 0; }));
+        std::fill(block, block + 48, 0xaa);
+        arena.deallocate(block, 48);
+
+        // the free list hands the same block back
+        auto *again = static_cast<uint8_t *>(arena.allocate(64));
+        CHECK_EQ(again, block);
+        CHECK(std::all_of(again, again + 64, [](uint8_t b) { return b == 0; }));
+        arena.deallocate(again, 64);
+    }
+
+    SUBCASE("one slab serves many blocks") {
+        std::vector<void *> blocks;
+        for (size_t i = 0; i < SecureArena::kSlabSize / 32; ++i) {
+            blocks.push_back(arena.allocate(32));
+        }
+        CHECK_EQ(arena.stats().slabs, 1);
+        CHECK_EQ(arena.stats().blocks, blocks.size());
+
+        // distinct and aligned
+        std::ranges::sort(blocks);
+        CHECK(std::ranges::adjacent_find(blocks) == blocks.end());
+        for (void *block : blocks) {
+            CHECK_EQ(reinterpret_cast<uintptr_t>(block) % 32, 0);
+        }
+
+        arena.allocate(32);
+        CHECK_EQ(arena.stats().slabs, 2);
+
+        for (void *block : blocks) {
+            arena.deallocate(block, 32);
+        }
+        CHECK_EQ(arena.stats().blocks, 1);
+    }
+
+    SUBCASE("large blocks get their own allocation") {
+        size_t size = SecureArena::kSlabSize + 1;
+        auto *block = static_cast<uint8_t *>(arena.allocate(size));
+        REQUIRE(block != nullptr);
+        CHECK_EQ(block[size - 1], 0);
+        CHECK_EQ(arena.stats().block_bytes, size);
+
+        arena.deallocate(block, size);
+        CHECK_EQ(arena.stats().slabs, 0);
+        CHECK_EQ(arena.stats().block_bytes, 0);
+    }
+}
+
+TEST_CASE("SecureArray") {
+    SecureArena arena;
+
+    SecureArray<uint64_t> values(10, arena);
+    CHECK_EQ(values.size(), 10);
+    CHECK(std::ranges::all_of(values, [](uint64_t v) { return v == 0; }));
+    values[3] = 42;
+
+    SUBCASE("moves without copying") {
+        uint64_t *data = values.data();
+        SecureArray<uint64_t> moved = std::move(values);
+        CHECK_EQ(moved.data(), data);
+        CHECK_EQ(moved[3], 42);
+        CHECK(values.empty());
+        CHECK_EQ(arena.stats().blocks, 1);
+    }
+
+    SUBCASE("zeroes on release") {
+        uint64_t *data = values.data();
+        values = SecureArray<uint64_t>{};
+        CHECK_EQ(arena.stats().blocks, 0);
+
+        // released blocks stay in the arena, so this is still ours to read
+        CHECK_EQ(data[3], 0);
+    }
+}
@@ -0,0 +1,157 @@
+#include <cstdint>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "session.h"
+
+namespace {
+
+std::vector<uint8_t> seal(Session &session, std::vector<uint8_t> message) {
+    std::vector<uint8_t> sealed(message.size() + kSessionOverhead);
+    REQUIRE(session.seal_into(message, sealed));
+    return sealed;
+}
+
+std::optional<std::vector<uint8_t>> open(
+        Session &session, std::vector<uint8_t> sealed) {
+    auto message = session.open_in_place(sealed);
+    if (!message.has_value()) {
+        return std::nullopt;
+    }
+    return std::vector<uint8_t>{message->begin(), message->end()};
+}
+
+/// one side's end of a connection: its long-term and ephemeral keys
+struct Side {
+    Keypair const &keys;
+    EphemeralKey ephemeral = EphemeralKey::generate();
+};
+
+std::optional<Session> establish(Side const &self,
+        Side const &peer,
+        SessionOptions const &options = {}) {
+    return Session::establish(self.keys,
+            self.ephemeral,
+            peer.keys.pubkey,
+            peer.ephemeral.pubkey(),
+            options);
+}
+
+} // namespace
+
+TEST_CASE("Session") {
+    REQUIRE(sodium_init() >= 0);
+
+    Keypair alice_keys = Keypair::generate();
+    Keypair bob_keys = Keypair::generate();
+    SessionOptions options{.rekey_interval = 4};
+
+    Side alice_side{alice_keys};
+    Side bob_side{bob_keys};
+    auto alice = establish(alice_side, bob_side, options);
+    auto bob = establish(bob_side, alice_side, options);
+    REQUIRE(alice.has_value());
+    REQUIRE(bob.has_value());
+
+    std::vector<uint8_t> message{1, 2, 3};
+
+    SUBCASE("both directions") {
+        CHECK_EQ(open(*bob, seal(*alice, message)), message);
+        CHECK_EQ(open(*alice, seal(*bob, message)), message);
+    }
+
+    SUBCASE("locks little memory") {
+        size_t before = SecureArena::global().stats().block_bytes;
+        auto carol = establish(alice_side, bob_side, options);
+        REQUIRE(carol.has_value());
+
+        // the chain keys and one slot each, not a ring of skipped keys
+        CHECK_LE(SecureArena::global().stats().block_bytes - before, 512);
+    }
+
+    SUBCASE("in place") {
+        std::vector<uint8_t> buffer(kSessionOverhead);
+        buffer.insert(buffer.end(), message.begin(), message.end());
+        REQUIRE(alice->seal_in_place(buffer));
+        CHECK_EQ(open(*bob, buffer), message);
+    }
+
+    SUBCASE("rejects replays and tampering") {
+        std::vector<uint8_t> sealed = seal(*alice, message);
+        std::vector<uint8_t> tampered = sealed;
+        tampered.back() ^= 1;
+
+        CHECK_FALSE(open(*bob, tampered).has_value());
+        CHECK(open(*bob, sealed).has_value());
+        CHECK_FALSE(open(*bob, sealed).has_value());
+    }
+
+    SUBCASE("does not open its own messages") {
+        CHECK_FALSE(open(*alice, seal(*alice, message)).has_value());
+    }
+
+    SUBCASE("rekeys and tolerates loss") {
+        for (int i = 0; i < 10; ++i) {
+            std::vector<uint8_t> sealed = seal(*alice, message);
+            // every third message is lost
+            if (i % 3 != 2) {
+                CHECK_EQ(open(*bob, sealed), message);
+            }
+        }
+        CHECK_EQ(alice->sent(), 10);
+        CHECK_EQ(bob->received(), 10);
+    }
+
+    SUBCASE("rejects counters past the next epoch") {
+        for (int i = 0; i < 8; ++i) {
+            seal(*alice, message);
+        }
+        CHECK_FALSE(open(*bob, seal(*alice, message)).has_value());
+    }
+
+    SUBCASE("outsiders cannot open") {
+        Keypair eve_keys = Keypair::generate();
+        auto eve = establish(Side{eve_keys}, alice_side, options);
+        REQUIRE(eve.has_value());
+        CHECK_FALSE(open(*eve, seal(*alice, message)).has_value());
+
+        // knowing the ephemeral keys is not enough without bob's key
+        auto fake_bob = Session::establish(eve_keys,
+                bob_side.ephemeral,
+                alice_keys.pubkey,
+                alice_side.ephemeral.pubkey(),
+                options);
+        REQUIRE(fake_bob.has_value());
+        CHECK_FALSE(open(*fake_bob, seal(*alice, message)).has_value());
+    }
+
+    SUBCASE("every connection gets fresh keys") {
+        Side alice_again{alice_keys};
+        Side bob_again{bob_keys};
+        auto alice2 = establish(alice_again, bob_again, options);
+        auto bob2 = establish(bob_again, alice_again, options);
+        REQUIRE(alice2.has_value());
+        REQUIRE(bob2.has_value());
+
+        // same pair, same message, same counter: different ciphertext
+        std::vector<uint8_t> first = seal(*alice, message);
+        std::vector<uint8_t> second = seal(*alice2, message);
+        CHECK_NE(first, second);
+
+        // and a recorded earlier connection does not replay into this one
+        CHECK_FALSE(open(*bob2, first).has_value());
+        CHECK_EQ(open(*bob2, second), message);
+    }
+
+    SUBCASE("not with ourselves") {
+        CHECK_FALSE(establish(alice_side, Side{alice_keys}).has_value());
+        // nor with our own ephemeral key reflected back
+        CHECK_FALSE(Session::establish(alice_keys,
+                alice_side.ephemeral,
+                bob_keys.pubkey,
+                alice_side.ephemeral.pubkey())
+                        .has_value());
+    }
+}
@@ -0,0 +1,77 @@
+#include <cstdint>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "verify_cache.h"
+
+TEST_CASE("VerifyCache") {
+    REQUIRE(sodium_init() >= 0);
+
+    Keypair keypair = Keypair::generate();
+    std::vector<uint8_t> message{1, 2, 3, 4};
+    Signature signature = keypair.privkey.sign(message);
+
+    VerifyCache cache{64};
+
+    SUBCASE("hits once verified") {
+        CHECK(cache.verify(keypair.pubkey.data(), message, signature.bytes));
+        CHECK(cache.verify(keypair.pubkey.data(), message, signature.bytes));
+
+        VerifyCacheStats stats = cache.stats();
+        CHECK_EQ(stats.hits, 1);
+        CHECK_EQ(stats.misses, 1);
+    }
+
+    SUBCASE("does not cache bad signatures") {
+        Signature bad = signature;
+        bad.bytes[0] ^= 1;
+
+        CHECK_FALSE(cache.verify(keypair.pubkey.data(), message, bad.bytes));
+        CHECK_FALSE(cache.verify(keypair.pubkey.data(), message, bad.bytes));
+        CHECK_EQ(cache.stats().hits, 0);
+    }
+
+    SUBCASE("a cached signature does not vouch for another message") {
+        CHECK(cache.verify(keypair.pubkey.data(), message, signature.bytes));
+
+        std::vector<uint8_t> other{1, 2, 3, 5};
+        CHECK_FALSE(
+                cache.verify(keypair.pubkey.data(), other, signature.bytes));
+
+        Keypair someone_else = Keypair::generate();
+        CHECK_FALSE(cache.verify(
+                someone_else.pubkey.data(), message, signature.bytes));
+    }
+
+    SUBCASE("batches mix hits and misses") {
+        std::vector<uint8_t> second{5, 6};
+        Signature second_signature = keypair.privkey.sign(second);
+        Signature bad = second_signature;
+        bad.bytes[1] ^= 1;
+
+        CHECK(cache.verify(keypair.pubkey.data(), message, signature.bytes));
+
+        std::vector<SignedMessage> batch{
+                {keypair.pubkey.data(), second, bad.bytes},
+                {keypair.pubkey.data(), message, signature.bytes},
+                {keypair.pubkey.data(), second, second_signature.bytes},
+        };
+        std::vector<size_t> expected{0};
+        CHECK_EQ(cache.verify_batch(batch), expected);
+        CHECK_EQ(cache.verify_batch(batch), expected);
+    }
+
+    SUBCASE("stays within its capacity") {
+        std::vector<uint8_t> bytes(8);
+        for (uint64_t i = 0; i < 1000; ++i) {
+            bytes[0] = static_cast<uint8_t>(i);
+            bytes[1] = static_cast<uint8_t>(i >> 8);
+            Signature each = keypair.privkey.sign(bytes);
+            CHECK(cache.verify(keypair.pubkey.data(), bytes, each.bytes));
+        }
+
+        CHECK_GE(cache.stats().evictions, 1000 - cache.capacity());
+    }
+}
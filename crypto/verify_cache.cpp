@@ -0,0 +1,144 @@
+#include "verify_cache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+VerifyCache::VerifyCache(size_t capacity)
+    : buckets_per_shard_{std::bit_ceil(
+              std::max<size_t>(1, capacity / (kShards * kWays)))} {
+    crypto_shorthash_siphashx24_keygen(key_.data());
+
+    shards_.reserve(kShards);
+    for (size_t i = 0; i < kShards; ++i) {
+        auto &shard = shards_.emplace_back(std::make_unique<Shard>());
+        shard->slots.resize(buckets_per_shard_ * kWays);
+    }
+}
+
+bool VerifyCache::verify(std::span<uint8_t const> pubkey,
+        std::span<uint8_t const> message,
+        std::span<uint8_t const> signature) {
+    SignedMessage item{
+            .pubkey = pubkey,
+            .message = message,
+            .signature = signature,
+    };
+
+    return verify_batch({&item, 1}).empty();
+}
+
+std::vector<size_t> VerifyCache::verify_batch(
+        std::span<SignedMessage const> batch) {
+    std::vector<SignedMessage> misses;
+    // indices into `batch` of the entries of `misses`
+    std::vector<size_t> miss_indices;
+    std::vector<Fingerprint> miss_fingerprints;
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (batch[i].pubkey.size() != kPubkeySize
+                || batch[i].signature.size() != kSignatureSize) {
+            // left to ::verify_batch to reject
+            misses.push_back(batch[i]);
+            miss_indices.push_back(i);
+            miss_fingerprints.emplace_back();
+            continue;
+        }
+
+        Fingerprint print = fingerprint(batch[i]);
+        if (contains(print)) {
+            continue;
+        }
+
+        misses.push_back(batch[i]);
+        miss_indices.push_back(i);
+        miss_fingerprints.push_back(print);
+    }
+
+    hits_.fetch_add(batch.size() - misses.size(), std::memory_order_relaxed);
+    misses_.fetch_add(misses.size(), std::memory_order_relaxed);
+
+    std::vector<size_t> invalid = ::verify_batch(misses);
+
+    auto next_invalid = invalid.begin();
+    for (size_t i = 0; i < misses.size(); ++i) {
+        if (next_invalid != invalid.end() && *next_invalid == i) {
+            *next_invalid++ = miss_indices[i];
+            continue;
+        }
+
+        insert(miss_fingerprints[i]);
+    }
+
+    return invalid;
+}
+
+VerifyCacheStats VerifyCache::stats() const {
+    return {
+            .hits = hits_.load(std::memory_order_relaxed),
+            .misses = misses_.load(std::memory_order_relaxed),
+            .evictions = evictions_.load(std::memory_order_relaxed),
+    };
+}
+
+VerifyCache::Fingerprint VerifyCache::fingerprint(
+        SignedMessage const &item) const {
+    // pubkey, signature and a hash of the message, which can be long
+    std::array<uint8_t, kPubkeySize + kSignatureSize + sizeof(Fingerprint)>
+            input{};
+    std::memcpy(input.data(), item.pubkey.data(), kPubkeySize);
+    std::memcpy(input.data() + kPubkeySize, item.signature.data(),
+            kSignatureSize);
+    crypto_shorthash_siphashx24(input.data() + kPubkeySize + kSignatureSize,
+            item.message.data(),
+            item.message.size(),
+            key_.data());
+
+    Fingerprint print{};
+    crypto_shorthash_siphashx24(
+            print.data(), input.data(), input.size(), key_.data());
+
+    return print;
+}
+
+std::pair<VerifyCache::Shard &, size_t> VerifyCache::locate(
+        Fingerprint const &fingerprint) const {
+    uint64_t bits = 0;
+    std::memcpy(&bits, fingerprint.data(), sizeof(bits));
+
+    Shard &shard = *shards_[bits % kShards];
+    size_t bucket = (bits / kShards) & (buckets_per_shard_ - 1);
+
+    return {shard, bucket * kWays};
+}
+
+bool VerifyCache::contains(Fingerprint const &fingerprint) {
+    auto [shard, first] = locate(fingerprint);
+
+    std::scoped_lock lock(shard.mutex);
+    auto bucket = std::span{shard.slots}.subspan(first, kWays);
+
+    return std::ranges::find(bucket, fingerprint) != bucket.end();
+}
+
+void VerifyCache::insert(Fingerprint const &fingerprint) {
+    auto [shard, first] = locate(fingerprint);
+
+    std::scoped_lock lock(shard.mutex);
+    auto bucket = std::span{shard.slots}.subspan(first, kWays);
+
+    if (std::ranges::find(bucket, fingerprint) != bucket.end()) {
+        // verified concurrently
+        return;
+    }
+
+    auto empty = std::ranges::find(bucket, Fingerprint{});
+    if (empty != bucket.end()) {
+        *empty = fingerprint;
+        return;
+    }
+
+    // the fingerprint is random, so are its last bits
+    bucket[fingerprint.back() % kWays] = fingerprint;
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <sodium.h>
+
+#include "crypto/crypto.h"
+
+struct VerifyCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    /// verified signatures that replaced an older entry
+    uint64_t evictions = 0;
+
+    double hit_rate() const {
+        uint64_t lookups = hits + misses;
+        return lookups == 0 ? 0.0
+                            : static_cast<double>(hits)
+                        / static_cast<double>(lookups);
+    }
+};
+
+/// remembers which signatures were already verified, so that a message
+/// arriving from several neighbours is only checked once.
+///
+/// entries are keyed fingerprints of (pubkey, message hash, signature).
+/// the key is random per process, so a peer cannot craft a bad signature
+/// whose fingerprint matches a verified one. only valid signatures are
+/// cached, a miss always falls back to a full check.
+///
+/// the cache is split into shards with a lock each, and every shard is a
+/// fixed set-associative table, so it never grows past its capacity.
+class VerifyCache {
+public:
+    static constexpr size_t kDefaultCapacity = 16384;
+
+    explicit VerifyCache(size_t capacity = kDefaultCapacity);
+
+    /// Pubkey::verify, skipped when the signature was verified before
+    bool verify(std::span<uint8_t const> pubkey,
+            std::span<uint8_t const> message,
+            std::span<uint8_t const> signature);
+
+    /// ::verify_batch over the signatures that are not cached
+    std::vector<size_t> verify_batch(std::span<SignedMessage const> batch);
+
+    VerifyCacheStats stats() const;
+
+    size_t capacity() const { return kShards * buckets_per_shard_ * kWays; }
+
+private:
+    using Fingerprint = std::array<uint8_t, crypto_shorthash_siphashx24_BYTES>;
+
+    static constexpr size_t kShards = 16;
+    static constexpr size_t kWays = 4;
+
+    struct Shard {
+        std::mutex mutex;
+        /// buckets of kWays fingerprints, all zero when empty
+        std::vector<Fingerprint> slots;
+    };
+
+    std::array<uint8_t, crypto_shorthash_siphashx24_KEYBYTES> key_{};
+    std::vector<std::unique_ptr<Shard>> shards_;
+    size_t buckets_per_shard_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+
+    Fingerprint fingerprint(SignedMessage const &item) const;
+
+    bool contains(Fingerprint const &fingerprint);
+
+    void insert(Fingerprint const &fingerprint);
+
+    /// the shard and the first slot of the bucket a fingerprint maps to
+    std::pair<Shard &, size_t> locate(Fingerprint const &fingerprint) const;
+};
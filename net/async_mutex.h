@@ -0,0 +1,55 @@
+#pragma once
+
+#include <utility>
+
+#include <asio.hpp>
+#include <asio/experimental/channel.hpp>
+
+/// a mutex for coroutines on one executor. waiting for it suspends the
+/// coroutine rather than blocking the thread, so it can be held across
+/// co_await, and waiters get it in the order they asked.
+///
+/// it is a channel with room for one token: locking sends the token,
+/// which waits while another holds it, and unlocking takes it back out.
+class AsyncMutex {
+public:
+    class Guard {
+    public:
+        Guard(Guard &&other) noexcept
+            : mutex_{std::exchange(other.mutex_, nullptr)} {}
+        Guard &operator=(Guard &&) = delete;
+
+        ~Guard() {
+            if (mutex_ != nullptr) {
+                mutex_->unlock();
+            }
+        }
+
+    private:
+        friend class AsyncMutex;
+
+        explicit Guard(AsyncMutex &mutex) : mutex_{&mutex} {}
+
+        AsyncMutex *mutex_;
+    };
+
+    explicit AsyncMutex(asio::any_io_executor executor)
+        : token_{std::move(executor), 1} {}
+
+    /// must not be moved while locked
+    AsyncMutex(AsyncMutex &&) = default;
+
+    /// unlocks when the guard goes out of scope
+    asio::awaitable<Guard> lock() {
+        co_await token_.async_send(asio::error_code{}, asio::use_awaitable);
+        co_return Guard{*this};
+    }
+
+    void unlock() {
+        // hands the token to the next waiter, if any
+        token_.try_receive([](asio::error_code) {});
+    }
+
+private:
+    asio::experimental::channel<void(asio::error_code)> token_;
+};
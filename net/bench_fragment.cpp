@@ -0,0 +1,154 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <absl/strings/str_format.h>
+
+#include "net/fragment.h"
+#include "net/loopback_stream.h"
+#include "utils/bench.h"
+
+namespace {
+
+constexpr size_t kMessageSize = 64 * 1024;
+// a typical synced message: its serialized header, then its data
+constexpr size_t kSyncHeaderSize = 48;
+constexpr size_t kSyncDataSize = 120;
+constexpr size_t kSyncMtu = 185;
+
+} // namespace
+
+int main() {
+    bench::Runner runner;
+
+    std::vector<uint8_t> message(kMessageSize, 0x5a);
+
+    // 23 is the BLE 4.0 default, 185 what iOS usually negotiates, 512 the
+    // largest attribute
+    for (size_t mtu : {23, 64, 185, 251, 512, 4096}) {
+        asio::io_context context;
+        auto [a, b] = LoopbackStream::pair(
+                context.get_executor(), {.mtu = mtu});
+
+        FragmentChannel sender{*a, {.mtu = mtu}};
+        FragmentChannel receiver{*b, {.mtu = mtu}};
+
+        runner.run(absl::StrFormat("fragment/roundtrip/mtu:%d", mtu),
+                [&] {
+                    asio::co_spawn(context, sender.send(message),
+                            asio::detached);
+                    asio::co_spawn(context,
+                            [&]() -> asio::awaitable<void> {
+                                bench::do_not_optimize(
+                                        co_await receiver.receive());
+                            },
+                            asio::detached);
+
+                    context.restart();
+                    context.run();
+                },
+                kMessageSize);
+
+        size_t fragments = (kMessageSize + mtu - FragmentHeader::kSize - 1)
+                / (mtu - FragmentHeader::kSize);
+        runner.record(absl::StrFormat("fragment/overhead/mtu:%d", mtu),
+                {
+                        {"fragments", static_cast<double>(fragments)},
+                        {"header_bytes",
+                                static_cast<double>(
+                                        fragments * FragmentHeader::kSize)},
+                });
+    }
+
+    // the header and data of a synced message as two sends, and as one
+    // gather send
+    std::vector<uint8_t> header(kSyncHeaderSize, 0x11);
+    std::vector<uint8_t> data(kSyncDataSize, 0x22);
+
+    for (bool gather : {false, true}) {
+        asio::io_context context;
+        auto [a, b] = LoopbackStream::pair(
+                context.get_executor(), {.mtu = kSyncMtu});
+
+        FragmentChannel sender{*a, {.mtu = kSyncMtu}};
+        FragmentChannel receiver{*b, {.mtu = kSyncMtu}};
+
+        auto send = [&]() -> asio::awaitable<void> {
+            if (gather) {
+                std::array<asio::const_buffer, 2> parts{
+                        asio::buffer(header), asio::buffer(data)};
+                co_await sender.send(parts);
+            } else {
+                co_await sender.send(header);
+                co_await sender.send(data);
+            }
+        };
+        auto receive = [&]() -> asio::awaitable<void> {
+            for (int i = gather ? 1 : 2; i > 0; --i) {
+                bench::do_not_optimize(co_await receiver.receive());
+            }
+        };
+
+        std::string name = gather ? "sync_message/gather"
+                                  : "sync_message/separate";
+        size_t messages = 0;
+        runner.run(name,
+                [&] {
+                    asio::co_spawn(context, send, asio::detached);
+                    asio::co_spawn(context, receive, asio::detached);
+
+                    context.restart();
+                    context.run();
+                    messages++;
+                },
+                kSyncHeaderSize + kSyncDataSize);
+
+        runner.record(name + "/writes",
+                {{"writes_per_message",
+                        static_cast<double>(a->writes())
+                                / static_cast<double>(messages)}});
+    }
+
+    // a 64 KiB message over something like a busy 1M PHY connection
+    {
+        LinkConditions ble{
+                .bandwidth = 100'000,
+                .latency = std::chrono::milliseconds(15),
+                .jitter = std::chrono::milliseconds(10),
+                .mtu = kSyncMtu,
+                .loss = 0.01,
+                .retransmission_timeout = std::chrono::milliseconds(30),
+        };
+
+        asio::io_context context;
+        auto [a, b] = LoopbackStream::pair(context.get_executor(), ble);
+
+        FragmentChannel sender{*a, {.mtu = kSyncMtu}};
+        FragmentChannel receiver{*b, {.mtu = kSyncMtu}};
+
+        asio::co_spawn(context, sender.send(message), asio::detached);
+        asio::co_spawn(context,
+                [&]() -> asio::awaitable<void> {
+                    bench::do_not_optimize(co_await receiver.receive());
+                },
+                asio::detached);
+
+        auto start = std::chrono::steady_clock::now();
+        context.run();
+        std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+
+        runner.record("fragment/simulated_ble",
+                {
+                        {"seconds", elapsed.count()},
+                        {"goodput_bytes_per_s",
+                                static_cast<double>(kMessageSize)
+                                        / elapsed.count()},
+                        {"retransmissions",
+                                static_cast<double>(
+                                        a->stats().retransmissions)},
+                });
+    }
+}
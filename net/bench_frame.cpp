@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <vector>
+
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_format.h>
+
+#include "net/frame.h"
+#include "utils/bench.h"
+
+namespace {
+
+constexpr size_t kStreamSize = 1 << 20;
+
+std::vector<uint8_t> frames_of(size_t frame_size) {
+    std::vector<uint8_t> stream;
+    FramePrefix prefix{frame_size};
+
+    while (stream.size() + prefix.size + frame_size <= kStreamSize) {
+        stream.insert(stream.end(), prefix.span().begin(), prefix.span().end());
+        stream.resize(stream.size() + frame_size, 0x5a);
+    }
+
+    return stream;
+}
+
+} // namespace
+
+int main() {
+    bench::Runner runner;
+
+    for (size_t frame_size : {16, 64, 256, 4096}) {
+        std::vector<uint8_t> stream = frames_of(frame_size);
+
+        // whole reads, and reads of one BLE fragment's payload each
+        for (size_t piece : {stream.size(), size_t{168}}) {
+            FrameDecoder decoder{1 << 20};
+
+            runner.run(absl::StrFormat("frame/decode/size:%d/piece:%s",
+                               frame_size,
+                               piece == stream.size()
+                                       ? "whole"
+                                       : absl::StrCat(piece)),
+                    [&] {
+                        for (size_t offset = 0; offset < stream.size();
+                                offset += piece) {
+                            decoder.feed(std::span{stream}.subspan(offset,
+                                    std::min(piece, stream.size() - offset)));
+                            while (auto frame = decoder.next()) {
+                                bench::do_not_optimize(frame->size());
+                            }
+                        }
+                    },
+                    stream.size());
+        }
+    }
+}
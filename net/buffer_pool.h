@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "utils/varint.h"
+
+/// recycles the byte buffers messages are serialized into, so the sync hot
+/// path doesn't allocate once the pool is warm. pools are per thread, and a
+/// buffer goes back to the pool it came from: it must be released on the
+/// thread that acquired it.
+class BufferPool {
+public:
+    /// buffers kept around at most
+    static constexpr size_t kMaxPooled = 64;
+    /// larger buffers are freed instead of pooled
+    static constexpr size_t kMaxPooledCapacity = 64 * 1024;
+
+    class Buffer {
+    public:
+        Buffer(Buffer &&other) noexcept
+            : pool_{std::exchange(other.pool_, nullptr)},
+              bytes_{std::move(other.bytes_)} {}
+
+        Buffer &operator=(Buffer &&other) noexcept {
+            if (this != &other) {
+                release();
+                pool_ = std::exchange(other.pool_, nullptr);
+                bytes_ = std::move(other.bytes_);
+            }
+            return *this;
+        }
+
+        ~Buffer() { release(); }
+
+        uint8_t *data() { return bytes_.data(); }
+        uint8_t const *data() const { return bytes_.data(); }
+        size_t size() const { return bytes_.size(); }
+
+        std::span<uint8_t> span() { return bytes_; }
+        std::span<uint8_t const> span() const { return bytes_; }
+
+    private:
+        friend class BufferPool;
+
+        Buffer(BufferPool *pool, std::vector<uint8_t> bytes)
+            : pool_{pool}, bytes_{std::move(bytes)} {}
+
+        void release() {
+            if (pool_ != nullptr) {
+                pool_->release(std::move(bytes_));
+                pool_ = nullptr;
+            }
+        }
+
+        BufferPool *pool_;
+        std::vector<uint8_t> bytes_;
+    };
+
+    static BufferPool &local() {
+        thread_local BufferPool pool;
+        return pool;
+    }
+
+    /// a buffer of `size` bytes, with unspecified contents
+    Buffer acquire(size_t size) {
+        std::vector<uint8_t> bytes;
+        if (!free_.empty()) {
+            bytes = std::move(free_.back());
+            free_.pop_back();
+        }
+
+        bytes.resize(size);
+        return Buffer{this, std::move(bytes)};
+    }
+
+    size_t pooled() const { return free_.size(); }
+
+private:
+    std::vector<std::vector<uint8_t>> free_;
+
+    void release(std::vector<uint8_t> bytes) {
+        if (free_.size() < kMaxPooled
+                && bytes.capacity() <= kMaxPooledCapacity) {
+            free_.push_back(std::move(bytes));
+        }
+    }
+};
+
+/// serializes a protobuf message into a pooled buffer
+template<typename T>
+BufferPool::Buffer serialize_pooled(T const &message) {
+    size_t size = message.ByteSizeLong();
+
+    BufferPool::Buffer buffer = BufferPool::local().acquire(size);
+    message.SerializeWithCachedSizesToArray(buffer.data());
+
+    return buffer;
+}
+
+/// serializes a protobuf message into a pooled buffer after its varuint
+/// length, so that more bytes can follow it
+template<typename T>
+BufferPool::Buffer serialize_pooled_delimited(T const &message) {
+    size_t size = message.ByteSizeLong();
+    size_t prefix = varuint_size(size);
+
+    BufferPool::Buffer buffer = BufferPool::local().acquire(prefix + size);
+    encode_varuint(size, buffer.span());
+    message.SerializeWithCachedSizesToArray(buffer.data() + prefix);
+
+    return buffer;
+}
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+#include "net/fragment.h"
+
+namespace {
+
+template<typename T>
+void store_le(uint8_t *out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+}
+
+template<typename T>
+T load_le(uint8_t const *in) {
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<T>(static_cast<T>(in[i]) << (i * 8));
+    }
+    return value;
+}
+
+} // namespace
+
+void FragmentHeader::encode(std::span<uint8_t, kSize> out) const {
+    store_le(out.data(), message_id);
+    store_le(out.data() + 4, offset);
+    store_le(out.data() + 8, total);
+    store_le(out.data() + 12, length);
+}
+
+FragmentHeader FragmentHeader::decode(std::span<uint8_t const, kSize> in) {
+    return {
+            .message_id = load_le<uint32_t>(in.data()),
+            .offset = load_le<uint32_t>(in.data() + 4),
+            .total = load_le<uint32_t>(in.data() + 8),
+            .length = load_le<uint16_t>(in.data() + 12),
+    };
+}
+
+std::optional<std::span<uint8_t>> Reassembler::accept(
+        FragmentHeader const &header, Clock::time_point now) {
+    if (header.total > options_.max_message_size
+            || uint64_t{header.offset} + header.length > header.total) {
+        return std::nullopt;
+    }
+
+    auto it = reassemblies_.find(header.message_id);
+
+    if (it == reassemblies_.end()) {
+        expire(now);
+
+        // the messages already under way are the likelier ones to finish
+        if (buffered_bytes_ + header.total > options_.max_reassembly_bytes) {
+            dropped_++;
+            return std::nullopt;
+        }
+
+        it = reassemblies_
+                     .emplace(header.message_id,
+                             Reassembly{
+                                     .buffer = std::vector<uint8_t>(
+                                             header.total),
+                                     .received = 0,
+                                     .deadline = now
+                                             + options_.reassembly_timeout,
+                             })
+                     .first;
+        buffered_bytes_ += header.total;
+    } else if (it->second.buffer.size() != header.total
+            || it->second.received + header.length > header.total) {
+        // either the ids wrapped around or the sender is confused
+        drop(it);
+        return std::nullopt;
+    }
+
+    // a fragment received twice would count its bytes twice and complete
+    // the message with holes in it
+    if (!it->second.cover(header.offset, header.length)) {
+        return std::nullopt;
+    }
+
+    return std::span{it->second.buffer}.subspan(header.offset, header.length);
+}
+
+std::optional<std::vector<uint8_t>> Reassembler::complete(
+        FragmentHeader const &header) {
+    auto it = reassemblies_.find(header.message_id);
+    if (it == reassemblies_.end()) {
+        return std::nullopt;
+    }
+
+    Reassembly &reassembly = it->second;
+    reassembly.received += header.length;
+    if (reassembly.received < reassembly.buffer.size()) {
+        return std::nullopt;
+    }
+
+    std::vector<uint8_t> message = std::move(reassembly.buffer);
+    buffered_bytes_ -= message.size();
+    reassemblies_.erase(it);
+
+    return message;
+}
+
+bool Reassembler::Reassembly::cover(uint32_t offset, uint32_t length) {
+    if (length == 0) {
+        return true;
+    }
+    uint32_t end = offset + length;
+
+    auto next = covered.upper_bound(offset);
+    if (next != covered.end() && next->first < end) {
+        return false;
+    }
+    if (next != covered.begin() && std::prev(next)->second > offset) {
+        return false;
+    }
+
+    if (next != covered.end() && next->first == end) {
+        end = next->second;
+        next = covered.erase(next);
+    }
+    if (next != covered.begin() && std::prev(next)->second == offset) {
+        std::prev(next)->second = end;
+    } else {
+        covered.emplace_hint(next, offset, end);
+    }
+
+    return true;
+}
+
+void Reassembler::expire(Clock::time_point now) {
+    for (auto it = reassemblies_.begin(); it != reassemblies_.end();) {
+        auto current = it++;
+        if (current->second.deadline <= now) {
+            drop(current);
+        }
+    }
+}
+
+void Reassembler::drop(std::unordered_map<uint32_t, Reassembly>::iterator it) {
+    buffered_bytes_ -= it->second.buffer.size();
+    reassemblies_.erase(it);
+    dropped_++;
+}
+
+FragmentChannel::FragmentChannel(
+        Stream &stream, FragmentOptions const &options)
+    : stream_{&stream}, options_{options}, reassembler_{options} {
+    assert(options.mtu > FragmentHeader::kSize);
+    assert(options.mtu <= FragmentHeader::kSize + UINT16_MAX);
+}
+
+asio::awaitable<std::expected<void, asio::error_code>> FragmentChannel::send(
+        std::span<uint8_t const> message) {
+    std::array<asio::const_buffer, 1> parts{
+            asio::buffer(message.data(), message.size())};
+    co_return co_await send(parts);
+}
+
+asio::awaitable<std::expected<void, asio::error_code>> FragmentChannel::send(
+        std::span<asio::const_buffer const> parts) {
+    size_t total = asio::buffer_size(parts);
+    if (total > options_.max_message_size) {
+        co_return std::unexpected(asio::error::message_size);
+    }
+
+    size_t max_payload = options_.mtu - FragmentHeader::kSize;
+    uint32_t message_id = next_message_id_++;
+
+    // kept in the coroutine frame, other sends may run while a write is
+    // suspended. the fragment being written, reused across its writes.
+    std::array<uint8_t, FragmentHeader::kSize> header_bytes{};
+    std::vector<asio::const_buffer> gather;
+    gather.reserve(parts.size() + 1);
+
+    // where the next fragment starts
+    size_t offset = 0;
+    size_t part = 0;
+    size_t part_offset = 0;
+
+    // an empty message still takes one fragment
+    do {
+        size_t length = std::min(max_payload, total - offset);
+
+        FragmentHeader{
+                .message_id = message_id,
+                .offset = static_cast<uint32_t>(offset),
+                .total = static_cast<uint32_t>(total),
+                .length = static_cast<uint16_t>(length),
+        }
+                .encode(header_bytes);
+
+        gather.clear();
+        gather.push_back(asio::buffer(header_bytes));
+
+        for (size_t left = length; left > 0;) {
+            asio::const_buffer slice = parts[part] + part_offset;
+            size_t taken = std::min(left, slice.size());
+            gather.push_back(asio::buffer(slice.data(), taken));
+
+            left -= taken;
+            part_offset += taken;
+            if (part_offset == parts[part].size()) {
+                part++;
+                part_offset = 0;
+            }
+        }
+
+        auto written = co_await stream_->write(
+                std::span<asio::const_buffer const>{gather});
+        co_try_unwrap(written);
+
+        offset += length;
+    } while (offset < total);
+
+    co_return std::expected<void, asio::error_code>{};
+}
+
+asio::awaitable<std::expected<std::vector<uint8_t>, asio::error_code>>
+FragmentChannel::receive() {
+    std::array<uint8_t, FragmentHeader::kSize> header_bytes{};
+
+    while (true) {
+        auto header_read = co_await stream_->read(header_bytes);
+        co_try_unwrap(header_read);
+        FragmentHeader header = FragmentHeader::decode(header_bytes);
+
+        auto destination =
+                reassembler_.accept(header, Reassembler::Clock::now());
+        if (!destination.has_value()) {
+            // the payload still has to come off the stream
+            if (discard_.size() < header.length) {
+                discard_.resize(header.length);
+            }
+            auto discarded = co_await stream_->read(
+                    std::span{discard_}.first(header.length));
+            co_try_unwrap(discarded);
+            continue;
+        }
+
+        auto payload_read = co_await stream_->read(destination.value());
+        co_try_unwrap(payload_read);
+
+        if (auto message = reassembler_.complete(header)) {
+            co_return std::move(message.value());
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <expected>
+#include <map>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "net/net.h"
+
+/// every fragment starts with this, little-endian on the wire
+struct FragmentHeader {
+    static constexpr size_t kSize = 14;
+
+    /// chosen by the sender, unique among its messages in flight
+    uint32_t message_id;
+    /// where the fragment's payload goes in the message
+    uint32_t offset;
+    /// size of the whole message
+    uint32_t total;
+    /// size of the fragment's payload
+    uint16_t length;
+
+    void encode(std::span<uint8_t, kSize> out) const;
+    static FragmentHeader decode(std::span<uint8_t const, kSize> in);
+};
+
+struct FragmentOptions {
+    /// the largest single write, header included. at most
+    /// FragmentHeader::kSize + UINT16_MAX.
+    size_t mtu = 182;
+    /// larger messages are refused on both ends
+    uint32_t max_message_size = 1 << 20;
+    /// bound on the memory held by incomplete reassemblies
+    size_t max_reassembly_bytes = 4 << 20;
+    /// incomplete reassemblies are dropped this long after their first
+    /// fragment arrived
+    std::chrono::steady_clock::duration reassembly_timeout =
+            std::chrono::seconds(30);
+};
+
+/// rebuilds messages from fragments that may arrive interleaved and out of
+/// order. each message gets one buffer of its final size when its first
+/// fragment arrives, and fragment payloads are read straight into it.
+class Reassembler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Reassembler(FragmentOptions const &options) : options_{options} {}
+
+    /// where the payload of the fragment goes, or nothing if it is to be
+    /// discarded: it is malformed, overlaps bytes already received, or the
+    /// message would go over the memory cap
+    std::optional<std::span<uint8_t>> accept(
+            FragmentHeader const &header, Clock::time_point now);
+
+    /// to be called once the payload was written to where accept() said,
+    /// hands out the message when this was its last fragment
+    std::optional<std::vector<uint8_t>> complete(FragmentHeader const &header);
+
+    /// drops the reassemblies that timed out by `now`
+    void expire(Clock::time_point now);
+
+    size_t buffered_bytes() const { return buffered_bytes_; }
+    size_t in_flight() const { return reassemblies_.size(); }
+    /// messages given up on: timed out, malformed, or over the memory cap
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    struct Reassembly {
+        std::vector<uint8_t> buffer;
+        size_t received;
+        Clock::time_point deadline;
+        /// the byte ranges handed out so far, start to end, adjacent ones
+        /// merged. a message arriving in order keeps a single one.
+        std::map<uint32_t, uint32_t> covered = {};
+
+        /// marks [offset, offset + length) as covered, false if any of it
+        /// already was
+        bool cover(uint32_t offset, uint32_t length);
+    };
+
+    FragmentOptions options_;
+    std::unordered_map<uint32_t, Reassembly> reassemblies_;
+    size_t buffered_bytes_ = 0;
+    uint64_t dropped_ = 0;
+
+    void drop(std::unordered_map<uint32_t, Reassembly>::iterator it);
+};
+
+/// sends and receives whole messages over a stream whose writes are limited
+/// to the link's mtu.
+///
+/// sends may overlap: each keeps its state in its own coroutine, and every
+/// fragment is a single write, so the fragments of concurrent messages
+/// interleave on the stream whole, and the receiver reassembles them by
+/// message id. only one receive may run at a time.
+class FragmentChannel {
+public:
+    FragmentChannel(Stream &stream, FragmentOptions const &options);
+
+    asio::awaitable<std::expected<void, asio::error_code>> send(
+            std::span<uint8_t const> message);
+    /// sends the concatenation of `parts` as one message. every fragment
+    /// is a gather write of its header and slices of the parts, copied
+    /// only by streams that cannot send them as they are.
+    asio::awaitable<std::expected<void, asio::error_code>> send(
+            std::span<asio::const_buffer const> parts);
+
+    /// the next message to complete, fragments of others are buffered
+    asio::awaitable<std::expected<std::vector<uint8_t>, asio::error_code>>
+    receive();
+
+    Reassembler const &reassembler() const { return reassembler_; }
+
+private:
+    Stream *stream_;
+    FragmentOptions options_;
+    Reassembler reassembler_;
+    uint32_t next_message_id_ = 0;
+
+    /// where discarded payloads are read to
+    std::vector<uint8_t> discard_;
+};
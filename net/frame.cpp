@@ -0,0 +1,136 @@
+#include <algorithm>
+
+#include "net/frame.h"
+
+void FrameDecoder::feed(std::span<uint8_t const> bytes) {
+    input_ = bytes;
+}
+
+std::optional<FrameDecoder::Parsed> FrameDecoder::parse(
+        std::span<uint8_t const> bytes) {
+    auto decoded = parse_varuint(bytes);
+    if (!decoded.has_value()) {
+        // a truncated prefix may still be completed by the next read
+        if (decoded.error() == VaruintError::Malformed) {
+            failed_ = true;
+        }
+        return std::nullopt;
+    }
+
+    auto [payload_size, prefix_size] = decoded.value();
+    if (payload_size > max_frame_size_) {
+        failed_ = true;
+        return std::nullopt;
+    }
+
+    return Parsed{
+            .frame_size = prefix_size + payload_size,
+            .prefix_size = prefix_size,
+    };
+}
+
+std::optional<std::span<uint8_t const>> FrameDecoder::next() {
+    while (!failed_) {
+        size_t dropped = std::min(skip_left_, input_.size());
+        skip_left_ -= dropped;
+        input_ = input_.subspan(dropped);
+        if (skip_left_ != 0) {
+            return std::nullopt;
+        }
+
+        auto frame = buffered() != 0 ? next_buffered() : next_input();
+        if (frame.has_value() && skip_next_) {
+            skip_next_ = false;
+            continue;
+        }
+
+        // a skipped frame was cut off, drop what is left of it
+        if (!frame.has_value() && skip_left_ != 0) {
+            continue;
+        }
+
+        return frame;
+    }
+
+    return std::nullopt;
+}
+
+std::optional<std::span<uint8_t const>> FrameDecoder::next_input() {
+    // the common case: frames come whole and are not copied
+    auto parsed = parse(input_);
+    if (parsed.has_value() && parsed->frame_size <= input_.size()) {
+        std::span<uint8_t const> frame = input_.subspan(
+                parsed->prefix_size, parsed->frame_size - parsed->prefix_size);
+        input_ = input_.subspan(parsed->frame_size);
+        return frame;
+    }
+
+    if (failed_) {
+        return std::nullopt;
+    }
+
+    if (skip_next_ && parsed.has_value()) {
+        skip_next_ = false;
+        skip_left_ = parsed->frame_size - input_.size();
+        input_ = {};
+        return std::nullopt;
+    }
+
+    // keep the start of the cut off frame for when the rest arrives
+    buffer_.assign(input_.begin(), input_.end());
+    buffer_begin_ = 0;
+    input_ = {};
+
+    return std::nullopt;
+}
+
+std::optional<std::span<uint8_t const>> FrameDecoder::next_buffered() {
+    while (true) {
+        std::span<uint8_t const> buffered{
+                buffer_.data() + buffer_begin_, buffer_.size() - buffer_begin_};
+
+        auto parsed = parse(buffered);
+        if (failed_) {
+            return std::nullopt;
+        }
+
+        if (parsed.has_value() && parsed->frame_size <= buffered.size()) {
+            buffer_begin_ += parsed->frame_size;
+            if (buffer_begin_ == buffer_.size()) {
+                // later frames are read from the input again, the payload
+                // stays valid as clear() keeps the storage
+                buffer_.clear();
+                buffer_begin_ = 0;
+            }
+
+            return buffered.subspan(parsed->prefix_size,
+                    parsed->frame_size - parsed->prefix_size);
+        }
+
+        if (skip_next_ && parsed.has_value()) {
+            skip_next_ = false;
+            skip_left_ = parsed->frame_size - buffered.size();
+            buffer_.clear();
+            buffer_begin_ = 0;
+            return std::nullopt;
+        }
+
+        if (input_.empty()) {
+            return std::nullopt;
+        }
+
+        // move over just what completes the frame, or its prefix
+        size_t wanted = parsed.has_value()
+                ? parsed->frame_size - buffered.size()
+                : kMaxVaruintSize - buffered.size();
+        size_t taken = std::min(wanted, input_.size());
+
+        if (buffer_begin_ != 0) {
+            buffer_.erase(buffer_.begin(),
+                    buffer_.begin() + static_cast<ptrdiff_t>(buffer_begin_));
+            buffer_begin_ = 0;
+        }
+        buffer_.insert(buffer_.end(), input_.begin(), input_.begin() + taken);
+        input_ = input_.subspan(taken);
+    }
+}
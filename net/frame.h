@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "utils/varint.h"
+
+/// a frame is a varuint length followed by that many bytes of payload
+
+/// the length prefix of a frame, to be written in front of its payload
+struct FramePrefix {
+    std::array<uint8_t, kMaxVaruintSize> bytes;
+    size_t size;
+
+    explicit FramePrefix(size_t payload_size)
+        : bytes{}, size{encode_varuint(payload_size, bytes)} {}
+
+    std::span<uint8_t const> span() const { return {bytes.data(), size}; }
+};
+
+/// splits a byte stream that arrives in arbitrary pieces into frames.
+///
+/// frames that arrive whole are handed out straight from the fed bytes;
+/// only a frame cut off at the end of a piece is copied, into a receive
+/// buffer that is reused for the whole stream.
+class FrameDecoder {
+public:
+    explicit FrameDecoder(size_t max_frame_size)
+        : max_frame_size_{max_frame_size} {}
+
+    /// the next bytes of the stream. they must stay alive until next()
+    /// returns nothing.
+    void feed(std::span<uint8_t const> bytes);
+
+    /// the payload of the next complete frame, valid until the next call to
+    /// next() or feed(). nothing when more bytes are needed, or once the
+    /// stream failed.
+    std::optional<std::span<uint8_t const>> next();
+
+    /// drops the next frame instead of handing it out. a frame that is cut
+    /// off is discarded as the rest of it arrives, it is never buffered.
+    void skip_next() { skip_next_ = true; }
+
+    /// a frame was over the size limit or its prefix was malformed, the
+    /// rest of the stream can't be framed anymore
+    bool failed() const { return failed_; }
+
+    /// bytes held back for a frame that is not complete yet
+    size_t buffered() const { return buffer_.size() - buffer_begin_; }
+
+private:
+    size_t max_frame_size_;
+    bool failed_ = false;
+
+    std::span<uint8_t const> input_;
+    std::vector<uint8_t> buffer_;
+    /// where the unconsumed part of buffer_ starts
+    size_t buffer_begin_ = 0;
+
+    bool skip_next_ = false;
+    /// what is still to come of a skipped frame that was cut off
+    size_t skip_left_ = 0;
+
+    struct Parsed {
+        /// prefix and payload
+        size_t frame_size;
+        size_t prefix_size;
+    };
+
+    /// the frame at the start of `bytes`, if its prefix is complete
+    std::optional<Parsed> parse(std::span<uint8_t const> bytes);
+    std::optional<std::span<uint8_t const>> next_input();
+    std::optional<std::span<uint8_t const>> next_buffered();
+};
@@ -0,0 +1,140 @@
+#include <algorithm>
+
+#include "net/loopback_stream.h"
+
+std::pair<std::unique_ptr<LoopbackStream>, std::unique_ptr<LoopbackStream>>
+LoopbackStream::pair(
+        asio::any_io_executor executor, LinkConditions const &conditions) {
+    auto a_to_b = std::make_shared<Direction>(executor, conditions);
+
+    LinkConditions reverse = conditions;
+    reverse.seed = conditions.seed + 1;
+    auto b_to_a = std::make_shared<Direction>(executor, reverse);
+
+    return {std::unique_ptr<LoopbackStream>{
+                    new LoopbackStream{executor, b_to_a, a_to_b}},
+            std::unique_ptr<LoopbackStream>{
+                    new LoopbackStream{executor, a_to_b, b_to_a}}};
+}
+
+LoopbackStream::LoopbackStream(asio::any_io_executor executor,
+        std::shared_ptr<Direction> incoming,
+        std::shared_ptr<Direction> outgoing)
+    : read_timer_{executor},
+      incoming_{std::move(incoming)},
+      outgoing_{std::move(outgoing)} {}
+
+LoopbackStream::~LoopbackStream() {
+    // the other end's reads fail instead of waiting forever
+    outgoing_->pipe.close();
+}
+
+asio::awaitable<std::expected<void, asio::error_code>> LoopbackStream::read(
+        std::span<uint8_t> buffer) {
+    size_t filled = 0;
+
+    while (filled < buffer.size()) {
+        if (packet_offset_ == packet_.size()) {
+            auto [error, packet] = co_await incoming_->pipe.async_receive(
+                    asio::as_tuple(asio::use_awaitable));
+            if (error) {
+                co_return std::unexpected(error);
+            }
+
+            if (packet.deliver_at > Clock::now()) {
+                read_timer_.expires_at(packet.deliver_at);
+                co_await read_timer_.async_wait(
+                        asio::as_tuple(asio::use_awaitable));
+            }
+
+            packet_ = std::move(packet.bytes);
+            packet_offset_ = 0;
+        }
+
+        size_t count = std::min(
+                buffer.size() - filled, packet_.size() - packet_offset_);
+        std::copy_n(packet_.begin() + static_cast<ptrdiff_t>(packet_offset_),
+                count,
+                buffer.begin() + static_cast<ptrdiff_t>(filled));
+
+        filled += count;
+        packet_offset_ += count;
+    }
+
+    co_return std::expected<void, asio::error_code>{};
+}
+
+asio::awaitable<std::expected<void, asio::error_code>> LoopbackStream::write(
+        std::span<uint8_t const> bytes) {
+    co_return co_await send(std::vector<uint8_t>{bytes.begin(), bytes.end()});
+}
+
+asio::awaitable<std::expected<void, asio::error_code>> LoopbackStream::write(
+        std::span<asio::const_buffer const> buffers) {
+    std::vector<uint8_t> bytes(asio::buffer_size(buffers));
+    asio::buffer_copy(asio::buffer(bytes), buffers);
+
+    co_return co_await send(std::move(bytes));
+}
+
+asio::awaitable<std::expected<void, asio::error_code>> LoopbackStream::send(
+        std::vector<uint8_t> bytes) {
+    Direction &link = *outgoing_;
+    LinkConditions const &conditions = link.conditions;
+
+    if (bytes.size() > conditions.mtu) {
+        co_return std::unexpected(asio::error::message_size);
+    }
+
+    Clock::time_point now = Clock::now();
+    Clock::time_point sent_at = std::max(now, link.busy_until);
+
+    if (conditions.bandwidth != 0) {
+        sent_at += std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(
+                        static_cast<double>(bytes.size())
+                        / static_cast<double>(conditions.bandwidth)));
+    }
+
+    // every loss costs a timeout and another trip over the link
+    std::bernoulli_distribution lost{std::clamp(conditions.loss, 0.0, 1.0)};
+    size_t losses = 0;
+    while (lost(link.random)) {
+        if (losses++ == kMaxRetransmissions) {
+            co_return std::unexpected(asio::error::timed_out);
+        }
+
+        sent_at += conditions.retransmission_timeout;
+        link.stats.retransmissions++;
+    }
+    link.busy_until = sent_at;
+
+    Clock::time_point deliver_at = sent_at + conditions.latency;
+    if (conditions.jitter.count() > 0) {
+        std::uniform_int_distribution<Clock::rep> jitter{
+                0, conditions.jitter.count()};
+        deliver_at += Clock::duration{jitter(link.random)};
+    }
+    deliver_at = std::max(deliver_at, link.last_delivery);
+    link.last_delivery = deliver_at;
+
+    link.stats.packets++;
+    link.stats.bytes += bytes.size();
+
+    auto [error] = co_await link.pipe.async_send(asio::error_code{},
+            Packet{.bytes = std::move(bytes), .deliver_at = deliver_at},
+            asio::as_tuple(asio::use_awaitable));
+    if (error) {
+        co_return std::unexpected(error);
+    }
+
+    // the sender is held up for as long as the link is busy with it, which
+    // is what throttles it to the bandwidth. the timer is this write's, a
+    // concurrent write must not cut its wait short.
+    if (sent_at > Clock::now()) {
+        asio::steady_timer timer{co_await asio::this_coro::executor, sent_at};
+        co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+    }
+
+    co_return std::expected<void, asio::error_code>{};
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <asio.hpp>
+#include <asio/experimental/channel.hpp>
+
+#include "net/net.h"
+
+/// how a simulated link behaves, in each direction. the defaults are an
+/// ideal link.
+struct LinkConditions {
+    using Duration = std::chrono::steady_clock::duration;
+
+    /// bytes per second, 0 for unlimited
+    uint64_t bandwidth = 0;
+    /// added to every packet's delivery
+    Duration latency{};
+    /// up to this much is added to a packet's latency, uniformly at random.
+    /// packets are still delivered in order.
+    Duration jitter{};
+    /// the largest single write
+    size_t mtu = std::numeric_limits<size_t>::max();
+    /// chance of a packet getting lost, in [0, 1]. streams are reliable,
+    /// so a loss costs a retransmission rather than the packet, until
+    /// LoopbackStream::kMaxRetransmissions in a row fail the write.
+    double loss = 0.0;
+    /// how long until a lost packet is sent again
+    Duration retransmission_timeout = std::chrono::milliseconds(100);
+    /// for jitter and loss, runs with the same seed behave the same
+    uint64_t seed = 0;
+};
+
+struct LinkStats {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t retransmissions = 0;
+};
+
+/// one end of an in-memory duplex stream, for tests and benchmarks. every
+/// write is delivered to the other end as one packet, after the delays the
+/// link conditions call for.
+class LoopbackStream : public Stream {
+public:
+    using Stream::write;
+    using Clock = std::chrono::steady_clock;
+
+    /// how many packets can be in flight before writes wait for the reader
+    static constexpr size_t kPipeCapacity = 1024;
+    /// a packet lost this many times in a row fails its write, the way a
+    /// real link gives up on a peer that is gone
+    static constexpr size_t kMaxRetransmissions = 16;
+
+    static std::pair<std::unique_ptr<LoopbackStream>,
+            std::unique_ptr<LoopbackStream>>
+    pair(asio::any_io_executor executor, LinkConditions const &conditions = {});
+
+    ~LoopbackStream() override;
+
+    asio::awaitable<std::expected<void, asio::error_code>> read(
+            std::span<uint8_t> buffer) override;
+    asio::awaitable<std::expected<void, asio::error_code>> write(
+            std::span<uint8_t const> bytes) override;
+    /// delivered as one packet
+    asio::awaitable<std::expected<void, asio::error_code>> write(
+            std::span<asio::const_buffer const> buffers) override;
+
+    /// until the other end is destroyed
+    bool valid() const override { return incoming_->pipe.is_open(); }
+
+    size_t max_write_size() const override {
+        return outgoing_->conditions.mtu;
+    }
+
+    /// what this end has written so far
+    LinkStats const &stats() const { return outgoing_->stats; }
+
+    /// packets written so far
+    size_t writes() const { return outgoing_->stats.packets; }
+
+private:
+    struct Packet {
+        std::vector<uint8_t> bytes;
+        Clock::time_point deliver_at;
+    };
+
+    using Pipe = asio::experimental::channel<void(asio::error_code, Packet)>;
+
+    /// one direction of the link
+    struct Direction {
+        Direction(asio::any_io_executor executor,
+                LinkConditions const &conditions)
+            : pipe{executor, kPipeCapacity},
+              conditions{conditions},
+              random{conditions.seed} {}
+
+        Pipe pipe;
+        LinkConditions conditions;
+        std::mt19937_64 random;
+
+        /// when the sender is done putting the last packet on the link
+        Clock::time_point busy_until{};
+        /// packets don't overtake each other
+        Clock::time_point last_delivery{};
+        LinkStats stats;
+    };
+
+    LoopbackStream(asio::any_io_executor executor,
+            std::shared_ptr<Direction> incoming,
+            std::shared_ptr<Direction> outgoing);
+
+    asio::awaitable<std::expected<void, asio::error_code>> send(
+            std::vector<uint8_t> bytes);
+
+    /// only one read runs at a time, writes each have their own timer
+    asio::steady_timer read_timer_;
+    std::shared_ptr<Direction> incoming_;
+    std::shared_ptr<Direction> outgoing_;
+
+    /// the packet being read, a read can end in the middle of one
+    std::vector<uint8_t> packet_;
+    size_t packet_offset_ = 0;
+};
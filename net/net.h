@@ -1,8 +1,18 @@
+#pragma once
+
+#include <cstdint>
 #include <expected>
+#include <limits>
+#include <optional>
 #include <span>
+#include <vector>
 
 #include <asio.hpp>
 
+#include "net/buffer_pool.h"
+#include "utils/error_utils.h"
+#include "utils/uuid.h"
+
 /// a bidirectional stream of data
 /// guarantees:
 /// - the packets that _are_ received are correct and full
@@ -12,15 +22,37 @@ struct Stream {
     virtual asio::awaitable<std::expected<void, asio::error_code>> read(
             std::span<uint8_t>) = 0;
     virtual asio::awaitable<std::expected<void, asio::error_code>> write(
-            std::span<uint8_t>) = 0;
+            std::span<uint8_t const>) = 0;
+
+    /// writes `buffers` back to back as a single write, so that concurrent
+    /// writers never interleave inside it. copies them into one pooled
+    /// buffer, streams that can send them as they are should override this.
+    virtual asio::awaitable<std::expected<void, asio::error_code>> write(
+            std::span<asio::const_buffer const> buffers) {
+        BufferPool::Buffer joined =
+                BufferPool::local().acquire(asio::buffer_size(buffers));
+        asio::buffer_copy(asio::buffer(joined.data(), joined.size()), buffers);
+
+        co_return co_await write(std::span<uint8_t const>{joined.span()});
+    }
+
+    /// the largest single write the link carries, e.g. the negotiated BLE
+    /// attribute length
+    virtual size_t max_write_size() const {
+        return std::numeric_limits<size_t>::max();
+    }
+
+    /// the BLE peripheral at the other end, for links that have one
+    virtual std::optional<UUID> peripheral() const { return std::nullopt; }
 
     asio::awaitable<std::expected<void, asio::error_code>> write(
             auto const *obj) {
-        std::vector<uint8_t> bytes(obj->ByteSizeLong());
-        obj->SerializeToArray(bytes.data(), bytes.size());
-        co_try_unwrap(co_await write(bytes));
+        BufferPool::Buffer bytes = serialize_pooled(*obj);
+        auto written = co_await write(std::span<uint8_t const>{bytes.span()});
+        co_try_unwrap(written);
         co_return std::expected<void, asio::error_code>{};
     }
 
-    bool valid();
+    /// false once the other end is gone
+    virtual bool valid() const = 0;
 };
@@ -0,0 +1,146 @@
+#include "routing_table.h"
+
+#include <algorithm>
+#include <utility>
+
+RoutingTable::RoutingTable() {
+    for (size_t i = 0; i < kShards; ++i) {
+        routes_[i] = std::make_unique<Shard<PeerId, Route>>();
+        peripherals_[i] = std::make_unique<Shard<UUID, PeerId>>();
+    }
+}
+
+PeerId RoutingTable::add(Contact contact) {
+    PeerId peer = PeerId::from_pubkey(contact.pubkey);
+
+    Shard<PeerId, Route> &shard = shard_of(routes_, peer);
+    std::unique_lock lock(shard.mutex);
+    shard.entries.try_emplace(peer,
+            Route{
+                    .contact = std::move(contact),
+                    .connections = {},
+                    .peripherals = {},
+            });
+
+    return peer;
+}
+
+bool RoutingTable::remove(PeerId const &peer) {
+    std::vector<UUID> peripherals;
+    {
+        Shard<PeerId, Route> &shard = shard_of(routes_, peer);
+        std::unique_lock lock(shard.mutex);
+        auto it = shard.entries.find(peer);
+        if (it == shard.entries.end()) {
+            return false;
+        }
+
+        peripherals = std::move(it->second.peripherals);
+        shard.entries.erase(it);
+    }
+
+    for (UUID const &peripheral : peripherals) {
+        Shard<UUID, PeerId> &shard = shard_of(peripherals_, peripheral);
+        std::unique_lock lock(shard.mutex);
+        // unless it moved to another peer meanwhile
+        auto it = shard.entries.find(peripheral);
+        if (it != shard.entries.end() && it->second == peer) {
+            shard.entries.erase(it);
+        }
+    }
+
+    return true;
+}
+
+bool RoutingTable::contains(PeerId const &peer) const {
+    return visit(peer, [](Route const &) {});
+}
+
+std::optional<Pubkey> RoutingTable::pubkey(PeerId const &peer) const {
+    std::optional<Pubkey> pubkey;
+    visit(peer, [&](Route const &route) { pubkey = route.contact.pubkey; });
+    return pubkey;
+}
+
+bool RoutingTable::add_connection(PeerId const &peer, ConnectionId connection) {
+    return visit(peer, [&](Route &route) {
+        if (std::ranges::find(route.connections, connection)
+                == route.connections.end()) {
+            route.connections.push_back(connection);
+        }
+    });
+}
+
+bool RoutingTable::remove_connection(
+        PeerId const &peer, ConnectionId connection) {
+    return visit(peer,
+            [&](Route &route) { std::erase(route.connections, connection); });
+}
+
+std::vector<ConnectionId> RoutingTable::connections(PeerId const &peer) const {
+    std::vector<ConnectionId> connections;
+    visit(peer, [&](Route const &route) { connections = route.connections; });
+    return connections;
+}
+
+bool RoutingTable::add_addr(PeerId const &peer, Multiaddr const &addr) {
+    SharedMultiaddr shared = addrs_.intern(addr);
+    return visit(peer, [&](Route &route) {
+        std::vector<SharedMultiaddr> &addrs = route.contact.known_addrs;
+        if (std::ranges::find(addrs, shared) == addrs.end()) {
+            addrs.push_back(std::move(shared));
+        }
+    });
+}
+
+bool RoutingTable::add_peripheral(PeerId const &peer, UUID peripheral) {
+    bool known = visit(peer, [&](Route &route) {
+        if (std::ranges::find(route.peripherals, peripheral)
+                == route.peripherals.end()) {
+            route.peripherals.push_back(peripheral);
+        }
+    });
+    if (!known) {
+        return false;
+    }
+
+    std::optional<PeerId> previous;
+    {
+        Shard<UUID, PeerId> &shard = shard_of(peripherals_, peripheral);
+        std::unique_lock lock(shard.mutex);
+        auto [it, inserted] = shard.entries.try_emplace(peripheral, peer);
+        if (!inserted && it->second != peer) {
+            previous = std::exchange(it->second, peer);
+        }
+    }
+
+    if (previous.has_value()) {
+        visit(previous.value(), [&](Route &route) {
+            std::erase(route.peripherals, peripheral);
+        });
+    }
+
+    return true;
+}
+
+std::optional<PeerId> RoutingTable::find_peripheral(
+        UUID const &peripheral) const {
+    Shard<UUID, PeerId> const &shard = shard_of(peripherals_, peripheral);
+    std::shared_lock lock(shard.mutex);
+    auto it = shard.entries.find(peripheral);
+    if (it == shard.entries.end()) {
+        return std::nullopt;
+    }
+
+    return it->second;
+}
+
+size_t RoutingTable::size() const {
+    size_t size = 0;
+    for (auto const &shard : routes_) {
+        std::shared_lock lock(shard->mutex);
+        size += shard->entries.size();
+    }
+
+    return size;
+}
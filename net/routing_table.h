@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "utils/multiaddr.h"
+#include "utils/uuid.h"
+
+struct Contact {
+    std::optional<std::string> name;
+    std::vector<SharedMultiaddr> known_addrs;
+    time_t last_sync;
+    Pubkey pubkey;
+};
+
+/// names a live connection, handed out by whoever owns the connections
+using ConnectionId = uint64_t;
+
+/// what we know about a peer
+struct Route {
+    Contact contact;
+    std::vector<ConnectionId> connections;
+    /// BLE peripherals the peer was seen as
+    std::vector<UUID> peripherals;
+};
+
+/// every known peer by PeerId, with its contact, live connections and
+/// addresses, and the peer behind every BLE peripheral uuid seen.
+///
+/// both maps are split into shards with a reader-writer lock each, so
+/// lookups from discovery and from every connection's receive loop do
+/// not queue behind each other. routes are only reached under their
+/// shard's lock, through visit.
+class RoutingTable {
+public:
+    RoutingTable();
+
+    /// adds a peer under PeerId::from_pubkey of its pubkey. a peer that is
+    /// already known keeps its route, and `contact` is dropped.
+    PeerId add(Contact contact);
+
+    /// forgets a peer, with its peripherals
+    bool remove(PeerId const &peer);
+
+    bool contains(PeerId const &peer) const;
+
+    std::optional<Pubkey> pubkey(PeerId const &peer) const;
+
+    /// calls fn(Route &) under the peer's shard lock, false if unknown.
+    /// `fn` must not call back into the table.
+    template<typename F>
+    bool visit(PeerId const &peer, F &&fn) {
+        Shard<PeerId, Route> &shard = shard_of(routes_, peer);
+        std::unique_lock lock(shard.mutex);
+        auto it = shard.entries.find(peer);
+        if (it == shard.entries.end()) {
+            return false;
+        }
+
+        fn(it->second);
+        return true;
+    }
+
+    /// calls fn(Route const &), concurrently with other readers
+    template<typename F>
+    bool visit(PeerId const &peer, F &&fn) const {
+        Shard<PeerId, Route> const &shard = shard_of(routes_, peer);
+        std::shared_lock lock(shard.mutex);
+        auto it = shard.entries.find(peer);
+        if (it == shard.entries.end()) {
+            return false;
+        }
+
+        fn(it->second);
+        return true;
+    }
+
+    bool add_connection(PeerId const &peer, ConnectionId connection);
+
+    bool remove_connection(PeerId const &peer, ConnectionId connection);
+
+    std::vector<ConnectionId> connections(PeerId const &peer) const;
+
+    /// remembers where the peer was reached, once per address. peers
+    /// seen at the same address share one copy of it.
+    bool add_addr(PeerId const &peer, Multiaddr const &addr);
+
+    /// records that `peripheral` is the peer, moving the uuid over from
+    /// whichever peer had it before
+    bool add_peripheral(PeerId const &peer, UUID peripheral);
+
+    /// the peer behind a discovered peripheral
+    std::optional<PeerId> find_peripheral(UUID const &peripheral) const;
+
+    size_t size() const;
+
+private:
+    static constexpr size_t kShards = 16;
+
+    template<typename Key, typename Value>
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Key, Value> entries;
+    };
+
+    template<typename Key, typename Value>
+    using Shards = std::array<std::unique_ptr<Shard<Key, Value>>, kShards>;
+
+    Shards<PeerId, Route> routes_;
+    /// only ever locked on its own, never while holding a route's shard
+    Shards<UUID, PeerId> peripherals_;
+    MultiaddrInterner addrs_;
+
+    /// the hash picks the bucket with its low bits, the shard gets the
+    /// high ones
+    template<typename Key, typename Value>
+    static Shard<Key, Value> &shard_of(
+            Shards<Key, Value> const &shards, Key const &key) {
+        size_t hash = std::hash<Key>{}(key);
+        return *shards[(hash >> 60) % kShards];
+    }
+};
@@ -0,0 +1,46 @@
+#include <chrono>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "async_mutex.h"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("AsyncMutex") {
+    asio::io_context context;
+    AsyncMutex mutex{context.get_executor()};
+    std::vector<int> events;
+
+    // each holds the mutex across a wait, on the one thread
+    auto critical = [&](int id) -> asio::awaitable<void> {
+        AsyncMutex::Guard guard = co_await mutex.lock();
+        events.push_back(id);
+
+        asio::steady_timer timer{context, 1ms};
+        co_await timer.async_wait(asio::use_awaitable);
+
+        events.push_back(id);
+    };
+
+    for (int id = 0; id < 3; ++id) {
+        asio::co_spawn(context, critical(id), asio::detached);
+    }
+    context.run();
+
+    // nothing interleaves, and the waiters go in order
+    CHECK_EQ(events, std::vector<int>{0, 0, 1, 1, 2, 2});
+
+    SUBCASE("Free again once every guard is gone") {
+        bool locked = false;
+        asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+            AsyncMutex::Guard guard = co_await mutex.lock();
+            locked = true;
+        }, asio::detached);
+
+        context.restart();
+        context.run();
+        CHECK(locked);
+    }
+}
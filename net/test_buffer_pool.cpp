@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <cstdint>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "buffer_pool.h"
+
+TEST_CASE("BufferPool") {
+    BufferPool pool;
+
+    uint8_t const *first = nullptr;
+    {
+        BufferPool::Buffer buffer = pool.acquire(100);
+        CHECK_EQ(buffer.size(), 100);
+        first = buffer.data();
+    }
+    CHECK_EQ(pool.pooled(), 1);
+
+    SUBCASE("Reuses released buffers") {
+        BufferPool::Buffer buffer = pool.acquire(50);
+        CHECK_EQ(buffer.size(), 50);
+        CHECK_EQ(buffer.data(), first);
+        CHECK_EQ(pool.pooled(), 0);
+    }
+
+    SUBCASE("Moved buffers are released once") {
+        BufferPool::Buffer a = pool.acquire(10);
+        BufferPool::Buffer b = std::move(a);
+        a = pool.acquire(20);
+        CHECK_EQ(pool.pooled(), 0);
+    }
+
+    SUBCASE("Large buffers are not kept") {
+        { BufferPool::Buffer buffer =
+                        pool.acquire(BufferPool::kMaxPooledCapacity + 1); }
+        CHECK_EQ(pool.pooled(), 0);
+    }
+}
+
+TEST_CASE("serialize_pooled_delimited") {
+    struct Fake {
+        size_t ByteSizeLong() const { return 300; }
+        uint8_t *SerializeWithCachedSizesToArray(uint8_t *out) const {
+            std::fill_n(out, 300, 0xab);
+            return out + 300;
+        }
+    };
+
+    BufferPool::Buffer buffer = serialize_pooled_delimited(Fake{});
+    REQUIRE_EQ(buffer.size(), 302);
+
+    auto [size, read] = decode_varuint(buffer.span()).value();
+    CHECK_EQ(size, 300);
+    CHECK_EQ(read, 2);
+    CHECK_EQ(buffer.data()[2], 0xab);
+}
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "fragment.h"
+#include "loopback_stream.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::vector<uint8_t> pattern(size_t size, uint8_t seed = 0) {
+    std::vector<uint8_t> bytes(size);
+    std::iota(bytes.begin(), bytes.end(), seed);
+    return bytes;
+}
+
+/// fills the span accept() handed out from the message the fragment is of
+void deliver(Reassembler &reassembler,
+        FragmentHeader const &header,
+        std::vector<uint8_t> const &message,
+        Reassembler::Clock::time_point now) {
+    auto destination = reassembler.accept(header, now);
+    REQUIRE(destination.has_value());
+    std::copy_n(message.begin() + header.offset,
+            header.length,
+            destination->begin());
+}
+
+/// only the writes every stream has, so gather writes take the default
+/// path
+class PlainStream : public Stream {
+public:
+    using Stream::write;
+
+    explicit PlainStream(LoopbackStream &inner) : inner_{inner} {}
+
+    asio::awaitable<std::expected<void, asio::error_code>> read(
+            std::span<uint8_t> buffer) override {
+        return inner_.read(buffer);
+    }
+
+    asio::awaitable<std::expected<void, asio::error_code>> write(
+            std::span<uint8_t const> bytes) override {
+        return inner_.write(bytes);
+    }
+
+    size_t max_write_size() const override {
+        return inner_.max_write_size();
+    }
+
+    bool valid() const override { return inner_.valid(); }
+
+private:
+    LoopbackStream &inner_;
+};
+
+} // namespace
+
+TEST_CASE("FragmentHeader round trip") {
+    FragmentHeader header{
+            .message_id = 0xdeadbeef,
+            .offset = 1234,
+            .total = 0x01020304,
+            .length = 0xfffe,
+    };
+
+    std::array<uint8_t, FragmentHeader::kSize> bytes{};
+    header.encode(bytes);
+    CHECK_EQ(bytes[0], 0xef);
+
+    FragmentHeader decoded = FragmentHeader::decode(bytes);
+    CHECK_EQ(decoded.message_id, header.message_id);
+    CHECK_EQ(decoded.offset, header.offset);
+    CHECK_EQ(decoded.total, header.total);
+    CHECK_EQ(decoded.length, header.length);
+}
+
+TEST_CASE("Reassembler") {
+    Reassembler reassembler{{.max_reassembly_bytes = 1000,
+            .reassembly_timeout = 10s}};
+    auto now = Reassembler::Clock::now();
+
+    std::vector<uint8_t> a = pattern(300, 1);
+    std::vector<uint8_t> b = pattern(250, 7);
+
+    SUBCASE("Interleaved and out of order") {
+        FragmentHeader a1{.message_id = 1, .offset = 200, .total = 300, .length = 100};
+        FragmentHeader b0{.message_id = 2, .offset = 0, .total = 250, .length = 250};
+        FragmentHeader a0{.message_id = 1, .offset = 0, .total = 300, .length = 200};
+
+        deliver(reassembler, a1, a, now);
+        CHECK(!reassembler.complete(a1).has_value());
+
+        deliver(reassembler, b0, b, now);
+        CHECK_EQ(reassembler.complete(b0), b);
+
+        deliver(reassembler, a0, a, now);
+        CHECK_EQ(reassembler.complete(a0), a);
+
+        CHECK_EQ(reassembler.in_flight(), 0);
+        CHECK_EQ(reassembler.buffered_bytes(), 0);
+    }
+
+    SUBCASE("A fragment received twice is discarded") {
+        FragmentHeader a0{.message_id = 1, .offset = 0, .total = 300, .length = 100};
+        FragmentHeader a1{.message_id = 1, .offset = 100, .total = 300, .length = 100};
+        FragmentHeader a2{.message_id = 1, .offset = 200, .total = 300, .length = 100};
+        FragmentHeader overlap{.message_id = 1, .offset = 150, .total = 300, .length = 100};
+
+        deliver(reassembler, a0, a, now);
+        CHECK(!reassembler.complete(a0).has_value());
+
+        // would count 300 bytes with 100 of them still zero
+        CHECK(!reassembler.accept(a0, now).has_value());
+        CHECK(!reassembler.accept(a0, now).has_value());
+
+        deliver(reassembler, a2, a, now);
+        CHECK(!reassembler.complete(a2).has_value());
+        CHECK(!reassembler.accept(overlap, now).has_value());
+
+        deliver(reassembler, a1, a, now);
+        CHECK_EQ(reassembler.complete(a1), a);
+        CHECK_EQ(reassembler.buffered_bytes(), 0);
+    }
+
+    SUBCASE("Memory cap") {
+        FragmentHeader big{.message_id = 1, .offset = 0, .total = 800, .length = 10};
+        FragmentHeader other{.message_id = 2, .offset = 0, .total = 300, .length = 10};
+
+        CHECK(reassembler.accept(big, now).has_value());
+        CHECK(!reassembler.accept(other, now).has_value());
+        CHECK_EQ(reassembler.buffered_bytes(), 800);
+        CHECK_EQ(reassembler.dropped(), 1);
+    }
+
+    SUBCASE("Timeout") {
+        FragmentHeader first{.message_id = 1, .offset = 0, .total = 800, .length = 10};
+        FragmentHeader later{.message_id = 2, .offset = 0, .total = 300, .length = 10};
+
+        CHECK(reassembler.accept(first, now).has_value());
+
+        // the stale reassembly makes room for the new one
+        CHECK(reassembler.accept(later, now + 11s).has_value());
+        CHECK_EQ(reassembler.in_flight(), 1);
+        CHECK_EQ(reassembler.buffered_bytes(), 300);
+        CHECK_EQ(reassembler.dropped(), 1);
+    }
+
+    SUBCASE("Malformed") {
+        FragmentHeader past_end{.message_id = 1, .offset = 290, .total = 300, .length = 20};
+        CHECK(!reassembler.accept(past_end, now).has_value());
+
+        FragmentHeader head{.message_id = 1, .offset = 0, .total = 300, .length = 20};
+        FragmentHeader other_total{.message_id = 1, .offset = 20, .total = 400, .length = 20};
+        CHECK(reassembler.accept(head, now).has_value());
+        CHECK(!reassembler.accept(other_total, now).has_value());
+        CHECK_EQ(reassembler.in_flight(), 0);
+    }
+}
+
+TEST_CASE("FragmentChannel over a loopback stream") {
+    constexpr size_t kMtu = 64;
+
+    asio::io_context context;
+    auto [a, b] = LoopbackStream::pair(
+            context.get_executor(), {.mtu = kMtu});
+
+    FragmentChannel sender{*a, {.mtu = kMtu}};
+    FragmentChannel receiver{*b, {.mtu = kMtu}};
+
+    std::vector<std::vector<uint8_t>> messages;
+    for (size_t size : {0, 1, 49, 50, 51, 1000, 65536}) {
+        messages.push_back(pattern(size, static_cast<uint8_t>(size)));
+    }
+
+    asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+        for (auto const &message : messages) {
+            CHECK((co_await sender.send(message)).has_value());
+        }
+    }, asio::detached);
+
+    std::vector<std::vector<uint8_t>> received;
+    asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+        for (size_t i = 0; i < messages.size(); ++i) {
+            auto message = co_await receiver.receive();
+            REQUIRE(message.has_value());
+            received.push_back(std::move(message.value()));
+        }
+    }, asio::detached);
+
+    context.run();
+
+    CHECK_EQ(received, messages);
+    // one fragment per 50 bytes of payload, and one for the empty message
+    CHECK_EQ(a->writes(), 1 + 1 + 1 + 1 + 2 + 20 + 1311);
+}
+
+TEST_CASE("FragmentChannel gather send") {
+    constexpr size_t kMtu = 64;
+
+    asio::io_context context;
+    auto [a, b] = LoopbackStream::pair(
+            context.get_executor(), {.mtu = kMtu});
+
+    FragmentChannel sender{*a, {.mtu = kMtu}};
+    FragmentChannel receiver{*b, {.mtu = kMtu}};
+
+    std::vector<uint8_t> header = pattern(30, 1);
+    std::vector<uint8_t> body = pattern(100, 2);
+
+    std::vector<uint8_t> expected = header;
+    expected.insert(expected.end(), body.begin(), body.end());
+
+    asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+        std::array<asio::const_buffer, 3> parts{
+                asio::buffer(header), asio::const_buffer{}, asio::buffer(body)};
+        CHECK((co_await sender.send(parts)).has_value());
+    }, asio::detached);
+
+    std::optional<std::vector<uint8_t>> received;
+    asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+        auto message = co_await receiver.receive();
+        if (message.has_value()) {
+            received = std::move(message.value());
+        }
+    }, asio::detached);
+
+    context.run();
+
+    CHECK_EQ(received, expected);
+    // fragments straddle the parts, each is still one write
+    CHECK_EQ(a->writes(), 3);
+}
+
+TEST_CASE("FragmentChannel concurrent sends") {
+    constexpr size_t kMtu = 64;
+
+    asio::io_context context;
+    // slow enough that every write suspends, and the sends interleave
+    auto [a, b] = LoopbackStream::pair(context.get_executor(),
+            {.bandwidth = 1 << 20, .mtu = kMtu});
+
+    FragmentChannel sender{*a, {.mtu = kMtu}};
+    FragmentChannel receiver{*b, {.mtu = kMtu}};
+
+    std::vector<std::vector<uint8_t>> messages{
+            pattern(1000, 1), pattern(777, 2), pattern(1500, 3)};
+
+    for (auto const &message : messages) {
+        asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+            CHECK((co_await sender.send(message)).has_value());
+        }, asio::detached);
+    }
+
+    std::vector<std::vector<uint8_t>> received;
+    asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+        for (size_t i = 0; i < messages.size(); ++i) {
+            auto message = co_await receiver.receive();
+            REQUIRE(message.has_value());
+            received.push_back(std::move(message.value()));
+        }
+    }, asio::detached);
+
+    context.run();
+
+    // they complete in whatever order their last fragments arrive
+    std::ranges::sort(messages);
+    std::ranges::sort(received);
+    CHECK_EQ(received, messages);
+}
+
+TEST_CASE("FragmentChannel concurrent sends over default gather writes") {
+    constexpr size_t kMtu = 64;
+
+    asio::io_context context;
+    auto [a, b] = LoopbackStream::pair(context.get_executor(),
+            {.bandwidth = 1 << 20, .mtu = kMtu});
+    PlainStream plain{*a};
+
+    FragmentChannel sender{plain, {.mtu = kMtu}};
+    FragmentChannel receiver{*b, {.mtu = kMtu}};
+
+    std::vector<std::vector<uint8_t>> messages{
+            pattern(1000, 1), pattern(777, 2), pattern(1500, 3)};
+
+    for (auto const &message : messages) {
+        asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+            CHECK((co_await sender.send(message)).has_value());
+        }, asio::detached);
+    }
+
+    std::vector<std::vector<uint8_t>> received;
+    asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+        for (size_t i = 0; i < messages.size(); ++i) {
+            auto message = co_await receiver.receive();
+            REQUIRE(message.has_value());
+            received.push_back(std::move(message.value()));
+        }
+    }, asio::detached);
+
+    context.run();
+
+    // a header and its payload went out as one write, never split by
+    // another message's
+    std::ranges::sort(messages);
+    std::ranges::sort(received);
+    CHECK_EQ(received, messages);
+}
@@ -0,0 +1,143 @@
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "frame.h"
+
+namespace {
+
+std::vector<uint8_t> encode_frames(std::vector<size_t> const &sizes) {
+    std::vector<uint8_t> stream;
+    for (size_t size : sizes) {
+        FramePrefix prefix{size};
+        stream.insert(stream.end(), prefix.span().begin(), prefix.span().end());
+
+        for (size_t i = 0; i < size; ++i) {
+            stream.push_back(static_cast<uint8_t>(size + i));
+        }
+    }
+    return stream;
+}
+
+/// feeds `stream` in pieces of `piece` bytes and collects the frames
+std::vector<std::vector<uint8_t>> decode_in_pieces(
+        FrameDecoder &decoder, std::vector<uint8_t> const &stream, size_t piece) {
+    std::vector<std::vector<uint8_t>> frames;
+
+    for (size_t offset = 0; offset < stream.size(); offset += piece) {
+        decoder.feed(std::span{stream}.subspan(
+                offset, std::min(piece, stream.size() - offset)));
+
+        while (auto frame = decoder.next()) {
+            frames.emplace_back(frame->begin(), frame->end());
+        }
+    }
+
+    return frames;
+}
+
+} // namespace
+
+TEST_CASE("FrameDecoder") {
+    std::vector<size_t> sizes{0, 1, 127, 128, 300, 5, 0, 16384, 2};
+    std::vector<uint8_t> stream = encode_frames(sizes);
+
+    for (size_t piece : {size_t{1}, size_t{2}, size_t{3}, size_t{7},
+                 size_t{185}, stream.size()}) {
+        CAPTURE(piece);
+
+        FrameDecoder decoder{1 << 20};
+        auto frames = decode_in_pieces(decoder, stream, piece);
+
+        REQUIRE_EQ(frames.size(), sizes.size());
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            CHECK_EQ(frames[i].size(), sizes[i]);
+            if (sizes[i] != 0) {
+                CHECK_EQ(frames[i].front(), static_cast<uint8_t>(sizes[i]));
+                CHECK_EQ(frames[i].back(),
+                        static_cast<uint8_t>(2 * sizes[i] - 1));
+            }
+        }
+
+        CHECK_EQ(decoder.buffered(), 0);
+        CHECK(!decoder.failed());
+    }
+}
+
+TEST_CASE("FrameDecoder limits") {
+    SUBCASE("Oversized frame") {
+        FrameDecoder decoder{100};
+        std::vector<uint8_t> stream = encode_frames({10, 101, 10});
+
+        auto frames = decode_in_pieces(decoder, stream, stream.size());
+        CHECK_EQ(frames.size(), 1);
+        CHECK(decoder.failed());
+    }
+
+    SUBCASE("Malformed prefix") {
+        FrameDecoder decoder{100};
+        std::vector<uint8_t> stream(12, 0xff);
+
+        auto frames = decode_in_pieces(decoder, stream, 3);
+        CHECK(frames.empty());
+        CHECK(decoder.failed());
+    }
+
+    SUBCASE("Overlong prefix") {
+        FrameDecoder decoder{100};
+        // 0 as two bytes, rejected without waiting for more
+        std::vector<uint8_t> stream{0x80, 0x00};
+
+        auto frames = decode_in_pieces(decoder, stream, stream.size());
+        CHECK(frames.empty());
+        CHECK(decoder.failed());
+    }
+
+    SUBCASE("Partial frame is held back") {
+        FrameDecoder decoder{100};
+        std::vector<uint8_t> stream = encode_frames({50});
+        stream.resize(20);
+
+        auto frames = decode_in_pieces(decoder, stream, stream.size());
+        CHECK(frames.empty());
+        CHECK_EQ(decoder.buffered(), 20);
+        CHECK(!decoder.failed());
+    }
+}
+
+TEST_CASE("FrameDecoder skip") {
+    // every small frame announces that the frame after it is to be skipped
+    std::vector<size_t> sizes{1, 300, 1, 5, 2, 1, 16384, 1, 0, 3, 1, 200};
+    std::vector<uint8_t> stream = encode_frames(sizes);
+
+    for (size_t piece : {size_t{1}, size_t{2}, size_t{7}, size_t{185},
+                 stream.size()}) {
+        CAPTURE(piece);
+
+        FrameDecoder decoder{1 << 20};
+        std::vector<size_t> received;
+        size_t most_buffered = 0;
+
+        for (size_t offset = 0; offset < stream.size(); offset += piece) {
+            decoder.feed(std::span{stream}.subspan(
+                    offset, std::min(piece, stream.size() - offset)));
+
+            while (auto frame = decoder.next()) {
+                received.push_back(frame->size());
+                if (frame->size() == 1) {
+                    decoder.skip_next();
+                }
+            }
+            most_buffered = std::max(most_buffered, decoder.buffered());
+        }
+
+        CHECK_EQ(received, std::vector<size_t>{1, 1, 2, 1, 1, 3, 1});
+        // skipped frames are never held back, only the prefix of one
+        CHECK_LT(most_buffered, 10);
+        CHECK_EQ(decoder.buffered(), 0);
+        CHECK(!decoder.failed());
+    }
+}
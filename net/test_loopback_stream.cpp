@@ -0,0 +1,158 @@
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "loopback_stream.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct Transfer {
+    std::vector<uint8_t> received;
+    LinkStats stats;
+    std::chrono::steady_clock::duration elapsed;
+};
+
+/// writes `packets` packets of `size` bytes from one end and reads them at
+/// the other
+Transfer transfer(
+        LinkConditions const &conditions, size_t packets, size_t size) {
+    asio::io_context context;
+    auto [a, b] = LoopbackStream::pair(context.get_executor(), conditions);
+
+    Transfer result;
+    result.received.resize(packets * size);
+
+    asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+        std::vector<uint8_t> packet(size);
+        for (size_t i = 0; i < packets; ++i) {
+            std::fill(packet.begin(), packet.end(), static_cast<uint8_t>(i));
+            CHECK((co_await a->write(std::span<uint8_t const>{packet}))
+                            .has_value());
+        }
+    }, asio::detached);
+
+    asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+        CHECK((co_await b->read(result.received)).has_value());
+    }, asio::detached);
+
+    auto start = std::chrono::steady_clock::now();
+    context.run();
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    result.stats = a->stats();
+
+    return result;
+}
+
+bool in_order(Transfer const &transfer, size_t size) {
+    for (size_t i = 0; i < transfer.received.size(); ++i) {
+        if (transfer.received[i] != static_cast<uint8_t>(i / size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("LoopbackStream") {
+    SUBCASE("Ideal link") {
+        Transfer result = transfer({}, 100, 50);
+
+        CHECK(in_order(result, 50));
+        CHECK_EQ(result.stats.packets, 100);
+        CHECK_EQ(result.stats.bytes, 5000);
+    }
+
+    SUBCASE("MTU") {
+        asio::io_context context;
+        auto [a, b] =
+                LoopbackStream::pair(context.get_executor(), {.mtu = 20});
+        CHECK_EQ(a->max_write_size(), 20);
+
+        asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+            std::vector<uint8_t> packet(21);
+            auto written = co_await a->write(std::span<uint8_t const>{packet});
+            CHECK_EQ(written.error(), asio::error::message_size);
+        }, asio::detached);
+
+        context.run();
+    }
+
+    SUBCASE("Bandwidth") {
+        // 20 KB at 200 KB/s
+        Transfer result = transfer({.bandwidth = 200'000}, 20, 1000);
+
+        CHECK(in_order(result, 1000));
+        CHECK_GE(result.elapsed, 95ms);
+    }
+
+    SUBCASE("Latency and jitter keep the order") {
+        Transfer result = transfer({.latency = 5ms, .jitter = 5ms}, 50, 10);
+
+        CHECK(in_order(result, 10));
+        CHECK_GE(result.elapsed, 5ms);
+    }
+
+    SUBCASE("Losses are retransmitted") {
+        LinkConditions conditions{
+                .loss = 0.2,
+                .retransmission_timeout = 1ms,
+                .seed = 42,
+        };
+        Transfer result = transfer(conditions, 100, 10);
+
+        CHECK(in_order(result, 10));
+        CHECK_GT(result.stats.retransmissions, 0);
+        CHECK_EQ(result.stats.packets, 100);
+
+        // the same seed, the same losses
+        CHECK_EQ(transfer(conditions, 100, 10).stats.retransmissions,
+                result.stats.retransmissions);
+    }
+
+    SUBCASE("Total loss fails the write") {
+        asio::io_context context;
+        auto [a, b] = LoopbackStream::pair(context.get_executor(),
+                {.loss = 1.0, .retransmission_timeout = 1ms});
+
+        asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+            std::vector<uint8_t> packet(10);
+            auto written = co_await a->write(std::span<uint8_t const>{packet});
+            CHECK_EQ(written.error(), asio::error::timed_out);
+        }, asio::detached);
+
+        context.run();
+        CHECK_EQ(a->stats().retransmissions,
+                LoopbackStream::kMaxRetransmissions);
+        CHECK_EQ(a->stats().packets, 0);
+    }
+
+    SUBCASE("Concurrent writes are each throttled") {
+        asio::io_context context;
+        // 10 KB at 1 MB/s keeps the link busy for 10ms
+        auto [a, b] = LoopbackStream::pair(
+                context.get_executor(), {.bandwidth = 1'000'000});
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::chrono::steady_clock::duration> elapsed;
+        for (size_t i = 0; i < 2; ++i) {
+            asio::co_spawn(context, [&]() -> asio::awaitable<void> {
+                std::vector<uint8_t> packet(10'000);
+                CHECK((co_await a->write(std::span<uint8_t const>{packet}))
+                                .has_value());
+                elapsed.push_back(std::chrono::steady_clock::now() - start);
+            }, asio::detached);
+        }
+
+        context.run();
+        REQUIRE_EQ(elapsed.size(), 2);
+        // the second write's wait did not cut the first one's short
+        CHECK_GE(elapsed[0], 9ms);
+        CHECK_GE(elapsed[1], 19ms);
+    }
+}
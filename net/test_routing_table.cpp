@@ -0,0 +1,150 @@
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "routing_table.h"
+
+namespace {
+
+Contact contact_for(Pubkey pubkey) {
+    return Contact{
+            .name = std::nullopt,
+            .known_addrs = {},
+            .last_sync = 0,
+            .pubkey = pubkey,
+    };
+}
+
+Pubkey pubkey_from(uint8_t seed) {
+    std::array<uint8_t, kPubkeySize> bytes{};
+    bytes.fill(seed);
+    return Pubkey{bytes};
+}
+
+} // namespace
+
+TEST_CASE("PeerId") {
+    Pubkey pubkey = pubkey_from(1);
+    PeerId id = PeerId::from_pubkey(pubkey);
+
+    CHECK_EQ(id, PeerId::from_pubkey(pubkey));
+    CHECK_NE(id, PeerId::from_pubkey(pubkey_from(2)));
+    CHECK_EQ(std::hash<PeerId>{}(id), id.hash());
+
+    auto decoded = PeerId::from_base64(id.to_base64());
+    REQUIRE(decoded.has_value());
+    CHECK_EQ(decoded.value(), id);
+
+    CHECK_FALSE(PeerId::from_base64("c2hvcnQ=").has_value());
+}
+
+TEST_CASE("RoutingTable") {
+    RoutingTable table;
+    Pubkey pubkey = pubkey_from(1);
+    PeerId peer = table.add(contact_for(pubkey));
+
+    CHECK_EQ(peer, PeerId::from_pubkey(pubkey));
+    CHECK(table.contains(peer));
+    CHECK_EQ(table.size(), 1);
+    CHECK_EQ(table.pubkey(peer), pubkey);
+
+    SUBCASE("Keeps the route of a known peer") {
+        REQUIRE(table.add_connection(peer, 7));
+        CHECK_EQ(table.add(contact_for(pubkey)), peer);
+        CHECK_EQ(table.size(), 1);
+        CHECK_EQ(table.connections(peer).size(), 1);
+    }
+
+    SUBCASE("Connections") {
+        CHECK(table.add_connection(peer, 1));
+        CHECK(table.add_connection(peer, 2));
+        CHECK(table.add_connection(peer, 1));
+        CHECK_EQ(table.connections(peer).size(), 2);
+
+        CHECK(table.remove_connection(peer, 1));
+        std::vector<ConnectionId> expected{2};
+        CHECK_EQ(table.connections(peer), expected);
+
+        PeerId unknown = PeerId::from_pubkey(pubkey_from(9));
+        CHECK_FALSE(table.add_connection(unknown, 1));
+        CHECK(table.connections(unknown).empty());
+    }
+
+    SUBCASE("Addresses") {
+        auto addr = Multiaddr::parse(
+                "/btle/123e4567-e89b-12d3-a456-426614174000")
+                            .value();
+        PeerId other = table.add(contact_for(pubkey_from(2)));
+
+        CHECK(table.add_addr(peer, addr));
+        CHECK(table.add_addr(peer, addr));
+        CHECK(table.add_addr(other, addr));
+        CHECK_FALSE(table.add_addr(PeerId::from_pubkey(pubkey_from(9)), addr));
+
+        SharedMultiaddr known;
+        table.visit(peer, [&](Route const &route) {
+            REQUIRE_EQ(route.contact.known_addrs.size(), 1);
+            known = route.contact.known_addrs[0];
+        });
+        // one copy for both peers
+        table.visit(other, [&](Route const &route) {
+            REQUIRE_EQ(route.contact.known_addrs.size(), 1);
+            CHECK_EQ(route.contact.known_addrs[0], known);
+        });
+        CHECK_EQ(*known, addr);
+    }
+
+    SUBCASE("Peripherals") {
+        UUID peripheral = UUID::generate_random();
+        CHECK_FALSE(table.find_peripheral(peripheral).has_value());
+
+        REQUIRE(table.add_peripheral(peer, peripheral));
+        CHECK_EQ(table.find_peripheral(peripheral), peer);
+
+        // the uuid moves over when another peer turns out to be behind it
+        PeerId other = table.add(contact_for(pubkey_from(2)));
+        REQUIRE(table.add_peripheral(other, peripheral));
+        CHECK_EQ(table.find_peripheral(peripheral), other);
+        table.visit(peer, [](Route const &route) {
+            CHECK(route.peripherals.empty());
+        });
+
+        CHECK(table.remove(other));
+        CHECK_FALSE(table.find_peripheral(peripheral).has_value());
+        CHECK_FALSE(table.contains(other));
+    }
+
+    SUBCASE("Concurrent lookups") {
+        constexpr int kThreads = 4;
+        constexpr int kPeers = 256;
+
+        std::vector<PeerId> peers;
+        for (int i = 0; i < kPeers; ++i) {
+            std::array<uint8_t, kPubkeySize> bytes{};
+            bytes[0] = static_cast<uint8_t>(i);
+            bytes[1] = static_cast<uint8_t>(i >> 8);
+            peers.push_back(table.add(contact_for(Pubkey{bytes})));
+        }
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < kPeers; ++i) {
+                    table.add_connection(peers[i], t);
+                    table.pubkey(peers[i]);
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+
+        CHECK_EQ(table.size(), kPeers + 1);
+        for (PeerId const &id : peers) {
+            CHECK_EQ(table.connections(id).size(), kThreads);
+        }
+    }
+}
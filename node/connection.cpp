@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <memory>
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include "messages.pb.h"
+#include "node/connection.h"
+
+namespace {
+
+constexpr uint32_t kHandshakeMessageMaxSize = 1024;
+// how far a handshake's timestamp may be from our clock. older handshakes
+// are taken for replays.
+constexpr absl::Duration kHandshakeMaxSkew = absl::Minutes(5);
+// the largest fragment we write, even on links that take more at once
+constexpr size_t kFragmentMaxSize = 4096;
+
+// protocol:
+// 1. handshake:
+// - peer id
+// - timestamp
+// - checksum
+// - flags?
+// 2. stream of messages:
+// messages should be pretty much strip down as much as possible
+// message header have:
+// - timestamp
+// - checksum
+// - (bloom) filter?
+// then bytes
+// the inner messages structure:
+// - sender
+// - signature (OTR?) or should this be in an encrypted header?
+// - ratchet slot?
+// - associated id (full messages might be split across multiple small messages)
+
+struct HandshakeMessage {
+    uint32_t flags;
+    uint64_t timestamp;
+    Pubkey pubkey;
+    EphemeralKey::Public ephemeral;
+    Signature signature;
+
+    using SignedBytes = std::array<uint8_t,
+            sizeof(uint64_t) + kPubkeySize + sizeof(EphemeralKey::Public)>;
+
+    /// what the signature covers: the timestamp, the pubkey, then the
+    /// ephemeral key
+    static SignedBytes signed_bytes(uint64_t timestamp,
+            Pubkey const &pubkey,
+            EphemeralKey::Public const &ephemeral) {
+        SignedBytes bytes{};
+        for (size_t i = 0; i < sizeof(timestamp); ++i) {
+            bytes[i] = static_cast<uint8_t>(timestamp >> (8 * i));
+        }
+        auto rest = std::ranges::copy(
+                pubkey.data(), bytes.begin() + sizeof(timestamp));
+        std::ranges::copy(ephemeral, rest.out);
+
+        return bytes;
+    }
+
+    static HandshakeMessage generate(
+            Keypair const &keypair, EphemeralKey const &ephemeral) {
+        auto timestamp =
+                static_cast<uint64_t>(absl::ToUnixSeconds(absl::Now()));
+        SignedBytes bytes =
+                signed_bytes(timestamp, keypair.pubkey, ephemeral.pubkey());
+
+        return HandshakeMessage{
+                .flags = 0,
+                .timestamp = timestamp,
+                .pubkey = keypair.pubkey,
+                .ephemeral = ephemeral.pubkey(),
+                .signature = keypair.privkey.sign(bytes),
+        };
+    }
+
+    /// the peer's handshake, once its signature checks out and it was made
+    /// within kHandshakeMaxSkew of `now`
+    static std::expected<HandshakeMessage, HandshakeError> from_proto(
+            hrafn::HandshakeMessage const &message, absl::Time now) {
+        if (message.pubkey().size() != kPubkeySize) {
+            return std::unexpected(HandshakeError::InvalidPubkey);
+        }
+        if (message.ephemeral().size() != sizeof(EphemeralKey::Public)) {
+            return std::unexpected(HandshakeError::InvalidFormat);
+        }
+        if (message.signature().size() != kSignatureSize) {
+            return std::unexpected(HandshakeError::InvalidSignature);
+        }
+
+        Pubkey pubkey = Pubkey::from_stringbytes(message.pubkey());
+        EphemeralKey::Public ephemeral{};
+        std::ranges::copy(message.ephemeral(), ephemeral.begin());
+        Signature signature = Signature::from_stringbytes(message.signature());
+
+        SignedBytes bytes =
+                signed_bytes(message.timestamp(), pubkey, ephemeral);
+        if (!pubkey.verify(bytes, signature.bytes)) {
+            return std::unexpected(HandshakeError::InvalidSignature);
+        }
+
+        // in unsigned seconds. one so large that adding the skew wraps
+        // around is taken for stale.
+        auto now_seconds = static_cast<uint64_t>(absl::ToUnixSeconds(now));
+        auto skew = static_cast<uint64_t>(
+                absl::ToInt64Seconds(kHandshakeMaxSkew));
+        if (message.timestamp() + skew < now_seconds
+                || message.timestamp() > now_seconds + skew) {
+            return std::unexpected(HandshakeError::InvalidTimestamp);
+        }
+
+        return HandshakeMessage{
+                .flags = message.flags(),
+                .timestamp = message.timestamp(),
+                .pubkey = pubkey,
+                .ephemeral = ephemeral,
+                .signature = signature,
+        };
+    }
+
+    hrafn::HandshakeMessage proto() const {
+        hrafn::HandshakeMessage message;
+        message.set_flags(flags);
+        message.set_timestamp(timestamp);
+        message.set_pubkey(pubkey.data().data(), pubkey.data().size());
+        message.set_signature(signature.bytes.data(), signature.bytes.size());
+        message.set_ephemeral(ephemeral.data(), ephemeral.size());
+        return message;
+    }
+};
+
+} // namespace
+
+asio::awaitable<std::expected<Connection, HandshakeError>>
+Connection::negotiate(std::unique_ptr<Stream> stream, Keypair const &keypair) {
+    // made for this connection alone, so its keys and nonces are never
+    // used again, and a recording of it does not replay into another
+    EphemeralKey ephemeral = EphemeralKey::generate();
+    co_await stream_write_frame(
+            *stream, HandshakeMessage::generate(keypair, ephemeral).proto());
+
+    auto proto = co_await stream_read_frame<hrafn::HandshakeMessage,
+            kHandshakeMessageMaxSize>(*stream);
+    co_try_unwrap_or(proto, HandshakeError::InvalidFormat);
+
+    auto handshake = HandshakeMessage::from_proto(proto.value(), absl::Now());
+    HandshakeMessage peer = co_try_unwrap(handshake);
+
+    // the session keys come from both long-term keys, so only the holder of
+    // the private key behind the pubkey it sent can talk to us, and from
+    // both ephemeral keys, so they are fresh
+    auto session = Session::establish(
+            keypair, ephemeral, peer.pubkey, peer.ephemeral);
+    if (!session.has_value()) {
+        co_return std::unexpected(HandshakeError::InvalidPubkey);
+    }
+
+    Stream &link = *stream;
+    co_return Connection{
+            .stream = std::move(stream),
+            .channel = FragmentChannel{link,
+                    {
+                            .mtu = std::min(
+                                    link.max_write_size(), kFragmentMaxSize),
+                            // a sync frame and the data frame after it
+                            .max_message_size =
+                                    2 * kSyncFrameMaxSize + kSessionOverhead,
+                    }},
+            .send_mutex = AsyncMutex{co_await asio::this_coro::executor},
+            .contact = Contact{
+                    .name = std::nullopt,
+                    .known_addrs = {},
+                    .last_sync = 0,
+                    .pubkey = peer.pubkey,
+            },
+            .session = std::move(session.value()),
+    };
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <optional>
+#include <span>
+
+#include <asio.hpp>
+
+#include "crypto/crypto.h"
+#include "crypto/session.h"
+#include "net/async_mutex.h"
+#include "net/buffer_pool.h"
+#include "net/fragment.h"
+#include "net/net.h"
+#include "net/routing_table.h"
+#include "utils/error_utils.h"
+#include "utils/varint.h"
+
+constexpr uint32_t kSyncFrameMaxSize = 1 << 20;
+
+// everything on the wire is framed by a varuint length prefix, see
+// net/frame.h
+
+/// reads exactly one frame, so that nothing after it is consumed
+template<typename T, size_t kMaxSize>
+asio::awaitable<std::expected<T, asio::error_code>> stream_read_frame(
+        Stream &stream) {
+    std::array<uint8_t, kMaxVaruintSize> prefix{};
+    size_t prefix_size = 0;
+
+    do {
+        if (prefix_size == prefix.size()) {
+            co_return std::unexpected{asio::error::invalid_argument};
+        }
+
+        auto read = co_await stream.read(
+                std::span{prefix}.subspan(prefix_size++, 1));
+        co_try_unwrap(read);
+    } while ((prefix[prefix_size - 1] & 0x80) != 0);
+
+    auto [size, _] =
+            decode_varuint(std::span{prefix}.first(prefix_size)).value();
+    if (size > kMaxSize) {
+        co_return std::unexpected{asio::error::message_size};
+    }
+
+    BufferPool::Buffer buffer = BufferPool::local().acquire(size);
+    auto read = co_await stream.read(buffer.span());
+    co_try_unwrap(read);
+
+    T root;
+    if (!root.ParseFromArray(buffer.data(), static_cast<int>(size))) {
+        co_return std::unexpected{asio::error::invalid_argument};
+    }
+
+    co_return root;
+}
+
+template<typename T>
+asio::awaitable<std::expected<void, asio::error_code>> stream_write_frame(
+        Stream &stream, T const &val) {
+    BufferPool::Buffer frame = serialize_pooled_delimited(val);
+    co_return co_await stream.write(
+            std::span<uint8_t const>{frame.span()});
+}
+
+enum class HandshakeError {
+    InvalidFormat,
+    InvalidVersion,
+    InvalidChecksum,
+    InvalidSignature,
+    InvalidPubkey,
+    InvalidTimestamp,
+};
+
+struct Connection {
+    std::unique_ptr<Stream> stream;
+    /// whole messages over `stream`, split to the link's write size
+    FragmentChannel channel;
+    /// held from sealing a message until it is sent. the io thread runs
+    /// several coroutines per connection, which wait on it, not block.
+    AsyncMutex send_mutex;
+    Contact contact;
+    /// seals every message after the handshake
+    Session session;
+
+    static asio::awaitable<std::expected<Connection, HandshakeError>> negotiate(
+            std::unique_ptr<Stream> stream, Keypair const &keypair);
+};
+
+/// sends `val` as a frame, followed by a frame of `data` if given, as one
+/// message sealed by the connection's session. both frames are laid out
+/// behind the seal's headroom in a pooled buffer and sealed in place, so
+/// the data is copied once, by the cipher. sealing and sending hold the
+/// send mutex, so messages go out whole and in the order of their counters.
+template<typename T>
+asio::awaitable<std::expected<void, asio::error_code>> channel_send_frames(
+        Connection &connection,
+        T const &val,
+        std::optional<std::span<uint8_t const>> data = std::nullopt) {
+    size_t val_size = val.ByteSizeLong();
+    size_t frames_size = varuint_size(val_size) + val_size;
+    if (data.has_value()) {
+        frames_size += varuint_size(data->size()) + data->size();
+    }
+
+    BufferPool::Buffer buffer =
+            BufferPool::local().acquire(kSessionOverhead + frames_size);
+    std::span<uint8_t> frames = buffer.span().subspan(kSessionOverhead);
+
+    size_t written = encode_varuint(val_size, frames);
+    val.SerializeWithCachedSizesToArray(frames.data() + written);
+    written += val_size;
+
+    if (data.has_value()) {
+        written += encode_varuint(data->size(), frames.subspan(written));
+        std::ranges::copy(data.value(), frames.begin() + written);
+    }
+
+    AsyncMutex::Guard guard = co_await connection.send_mutex.lock();
+    if (!connection.session.seal_in_place(buffer.span())) {
+        co_return std::unexpected{asio::error::invalid_argument};
+    }
+
+    co_return co_await connection.channel.send(
+            std::span<uint8_t const>{buffer.span()});
+}
@@ -0,0 +1,341 @@
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+#include <spdlog/spdlog.h>
+
+#include "messages.pb.h"
+#include "net/frame.h"
+#include "node/node.h"
+#include "sync/have_summary.h"
+#include "sync/message_id.h"
+#include "sync/range_reconciler.h"
+
+namespace {
+
+// past this many messages a have summary outgrows a BLE connection window
+// and we reconcile ranges instead
+constexpr size_t kHaveSummaryMaxMessages = 8192;
+constexpr absl::Duration kSyncInterval = absl::Minutes(2);
+constexpr absl::Duration kLogCommitInterval = absl::Seconds(1);
+// received messages have their signatures checked in bursts of up to this
+// many, a lone message waits at most kVerifyBatchDelay for company
+constexpr size_t kVerifyBatchSize = 64;
+constexpr absl::Duration kVerifyBatchDelay = absl::Milliseconds(5);
+
+asio::awaitable<void> handle_sync_frame(
+        Connection &connection, Context &ctx, hrafn::SyncFrame const &frame) {
+    if (frame.has_have()) {
+        auto summary = HaveSummary::deserialize(
+                std::span{reinterpret_cast<uint8_t const *>(
+                                  frame.have().filter().data()),
+                        frame.have().filter().size()});
+        if (!summary.has_value()) {
+            co_return;
+        }
+
+        co_await ctx.syncer.sync(connection, SyncMode::Full, &summary.value());
+        co_return;
+    }
+
+    if (frame.has_reconcile()) {
+        auto message = ReconcileMessage::deserialize(
+                std::span{reinterpret_cast<uint8_t const *>(
+                                  frame.reconcile().message().data()),
+                        frame.reconcile().message().size()});
+        if (!message.has_value()) {
+            co_return;
+        }
+
+        co_await ctx.syncer.reconcile(connection, message.value());
+    }
+}
+
+/// received messages waiting for their signatures to be checked. the
+/// checks run a burst at a time, which is what a peer sends right after
+/// reconnecting.
+///
+/// bodies are staged back to back in one buffer and headers in reused
+/// slots, and each staging is recycled after its flush. once warm, queueing
+/// a message copies it without allocating, and storing it copies it once
+/// more, into its log record.
+class VerifyBatch {
+public:
+    size_t size() const { return staging_.size; }
+
+    /// queues a received message, unless it is malformed or already held
+    void add(Context &ctx,
+            hrafn::MessageHeader const &header,
+            std::span<uint8_t const> data) {
+        auto id = message_id_from_stringbytes(header.message_id());
+        if (data.size() != header.size() || id != message_id(data)) {
+            return;
+        }
+
+        // skips the signature check for messages we already verified
+        if (ctx.syncer.refresh(id.value())) {
+            ctx.duplicates.remember(id.value(), DuplicateFilter::Clock::now());
+            return;
+        }
+
+        // a malformed recipient is no one's, the message is dropped
+        auto bytes = signed_bytes(header);
+        if (!bytes.has_value()) {
+            return;
+        }
+
+        if (staging_.size == staging_.pending.size()) {
+            staging_.pending.emplace_back();
+        }
+        Pending &item = staging_.pending[staging_.size++];
+
+        item.id = id.value();
+        // reuses the strings the slot's previous header left behind
+        item.header = header;
+        item.body_offset = staging_.bodies.size();
+        item.signed_bytes = bytes.value();
+        staging_.bodies.insert(staging_.bodies.end(), data.begin(), data.end());
+    }
+
+    /// verifies everything queued on the worker pool and stores the
+    /// authentic messages. more can be queued meanwhile, they go into the
+    /// next flush.
+    asio::awaitable<void> flush(Context &ctx) {
+        if (staging_.size == 0) {
+            co_return;
+        }
+
+        Staging staging = std::exchange(staging_, spare());
+        std::span<Pending const> pending =
+                std::span{staging.pending}.first(staging.size);
+
+        staging.batch.clear();
+        for (Pending const &item : pending) {
+            staging.batch.push_back({
+                    .pubkey = as_bytes(item.header.author()),
+                    .message = item.signed_bytes,
+                    .signature = as_bytes(item.header.signature()),
+            });
+        }
+
+        // the views into `staging` stay valid, we are suspended until the
+        // workers are done with them
+        std::vector<size_t> invalid = co_await ctx.workers.run([&] {
+            return ctx.verify_cache.verify_batch(staging.batch);
+        });
+        if (!invalid.empty()) {
+            spdlog::warn("Dropped {} received messages with bad signatures",
+                    invalid.size());
+        }
+
+        auto next_invalid = invalid.begin();
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (next_invalid != invalid.end() && *next_invalid == i) {
+                ++next_invalid;
+                continue;
+            }
+
+            Pending const &item = pending[i];
+            std::span<uint8_t const> body = std::span{staging.bodies}.subspan(
+                    item.body_offset, item.header.size());
+            if (!ctx.syncer.add_message(item.header, body).has_value()) {
+                spdlog::error("Failed to store a received message");
+                continue;
+            }
+
+            ctx.duplicates.remember(item.id, DuplicateFilter::Clock::now());
+        }
+
+        staging.size = 0;
+        staging.bodies.clear();
+        spares_.push_back(std::move(staging));
+    }
+
+private:
+    struct Pending {
+        MessageId id;
+        hrafn::MessageHeader header;
+        /// where the body starts in the staging's bodies
+        size_t body_offset;
+        SignedBytes signed_bytes;
+    };
+
+    /// what a flush works on
+    struct Staging {
+        /// the first `size` are queued, the rest are kept for their strings
+        std::vector<Pending> pending;
+        size_t size = 0;
+        std::vector<uint8_t> bodies;
+        std::vector<SignedMessage> batch;
+    };
+
+    Staging staging_;
+    /// stagings whose flush finished, one per flush that ran concurrently
+    std::vector<Staging> spares_;
+
+    Staging spare() {
+        if (spares_.empty()) {
+            return {};
+        }
+
+        Staging staging = std::move(spares_.back());
+        spares_.pop_back();
+        return staging;
+    }
+
+    static std::span<uint8_t const> as_bytes(std::string const &bytes) {
+        return {reinterpret_cast<uint8_t const *>(bytes.data()), bytes.size()};
+    }
+};
+
+/// flushes whatever is still queued once the batch delay ran out
+asio::awaitable<void> flush_later(
+        std::shared_ptr<VerifyBatch> batch, Context &ctx) {
+    asio::steady_timer timer(ctx.executor);
+    timer.expires_after(absl::ToChronoMilliseconds(kVerifyBatchDelay));
+    co_await timer.async_wait(asio::use_awaitable);
+
+    co_await batch->flush(ctx);
+}
+
+} // namespace
+
+asio::awaitable<void> handle_messages(Connection &connection, Context &ctx) {
+    FrameDecoder decoder{kSyncFrameMaxSize};
+    // parsed into again and again, which reuses their strings
+    hrafn::SyncFrame frame;
+    // a header frame is followed by a frame with the message's data
+    hrafn::MessageHeader header;
+    bool header_pending = false;
+    // shared with the flush_later that bounds how long it is held
+    auto batch = std::make_shared<VerifyBatch>();
+
+    while (connection.stream->valid() && !decoder.failed()) {
+        auto bytes = co_await connection.channel.receive();
+        if (!bytes.has_value()) {
+            continue;
+        }
+
+        // everything after the handshake is sealed by the session
+        auto frames = connection.session.open_in_place(bytes.value());
+        if (!frames.has_value()) {
+            continue;
+        }
+
+        // one read usually carries several frames
+        decoder.feed(frames.value());
+
+        while (auto payload = decoder.next()) {
+            if (header_pending) {
+                batch->add(ctx, header, payload.value());
+                header_pending = false;
+
+                if (batch->size() >= kVerifyBatchSize) {
+                    co_await batch->flush(ctx);
+                } else if (batch->size() == 1) {
+                    asio::co_spawn(ctx.executor,
+                            flush_later(batch, ctx),
+                            asio::detached);
+                }
+                continue;
+            }
+
+            if (!frame.ParseFromArray(
+                        payload->data(), static_cast<int>(payload->size()))) {
+                continue;
+            }
+
+            if (frame.has_header()) {
+                // relayed to us again over another path, the body is
+                // dropped as it arrives. refresh() confirms we hold it.
+                auto id = message_id_from_stringbytes(
+                        frame.header().message_id());
+                if (id.has_value()
+                        && ctx.duplicates.seen(id.value(),
+                                frame.header().size(),
+                                DuplicateFilter::Clock::now(),
+                                [&](MessageId const &held) {
+                                    return ctx.syncer.refresh(held);
+                                })) {
+                    decoder.skip_next();
+                    continue;
+                }
+
+                header = frame.header();
+                header_pending = true;
+                continue;
+            }
+
+            co_await handle_sync_frame(connection, ctx, frame);
+        }
+    }
+
+    co_await batch->flush(ctx);
+}
+
+asio::awaitable<void> periodic_sync(Connection &connection, Context &ctx) {
+    asio::steady_timer timer(ctx.executor);
+
+    while (ctx.running.load(std::memory_order_relaxed)
+            && connection.stream->valid()) {
+        if (ctx.syncer.size() > kHaveSummaryMaxMessages) {
+            co_await ctx.syncer.sync(connection, SyncMode::Reconcile);
+        } else {
+            std::vector<uint8_t> filter = ctx.syncer.summary().serialize();
+
+            hrafn::SyncFrame frame;
+            frame.mutable_have()->set_filter(filter.data(), filter.size());
+
+            co_await channel_send_frames(connection, frame);
+        }
+
+        timer.expires_after(absl::ToChronoSeconds(kSyncInterval));
+        co_await timer.async_wait(asio::use_awaitable);
+    }
+}
+
+asio::awaitable<void> periodic_commit(Context &ctx) {
+    asio::steady_timer timer(ctx.executor);
+
+    while (ctx.running.load(std::memory_order_relaxed)) {
+        timer.expires_after(absl::ToChronoMilliseconds(kLogCommitInterval));
+        co_await timer.async_wait(asio::use_awaitable);
+
+        if (auto result = ctx.syncer.commit(); !result.has_value()) {
+            spdlog::error("Failed to commit the message log");
+        }
+
+        ctx.syncer.expire(
+                static_cast<uint64_t>(absl::ToUnixSeconds(absl::Now())));
+
+        RelayCacheStats const &stats = ctx.syncer.cache_stats();
+        spdlog::debug(
+                "Relay cache: {} messages, {} bytes ({} pinned), "
+                "hit rate {:.2f}, {} evicted, {} expired",
+                stats.count,
+                stats.bytes,
+                stats.pinned_bytes,
+                stats.hit_rate(),
+                stats.evictions,
+                stats.expirations);
+
+        VerifyCacheStats verify_stats = ctx.verify_cache.stats();
+        spdlog::debug("Verify cache: hit rate {:.2f}, {} evicted",
+                verify_stats.hit_rate(),
+                verify_stats.evictions);
+
+        DuplicateFilterStats const &duplicate_stats = ctx.duplicates.stats();
+        spdlog::debug("Duplicates: {} of {} received messages ({:.2f}), "
+                      "{} bytes skipped, {} false positives",
+                duplicate_stats.duplicates,
+                duplicate_stats.messages,
+                duplicate_stats.duplicate_rate(),
+                duplicate_stats.duplicate_bytes,
+                duplicate_stats.false_positives);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include <absl/time/time.h>
+#include <asio.hpp>
+
+#include "crypto/crypto.h"
+#include "crypto/verify_cache.h"
+#include "net/routing_table.h"
+#include "node/connection.h"
+#include "node/syncer.h"
+#include "sync/duplicate_filter.h"
+#include "utils/worker_pool.h"
+
+// a message received again within this long is dropped on its header. the
+// filter keeps kDuplicateGenerations generations of up to
+// kDuplicateGenerationSize ids each.
+constexpr absl::Duration kDuplicateHorizon = absl::Minutes(10);
+constexpr size_t kDuplicateGenerationSize = 16384;
+constexpr size_t kDuplicateGenerations = 4;
+
+struct Context {
+    asio::io_context &executor;
+    Keypair keypair;
+    /// every peer we know of, by PeerId
+    RoutingTable routes;
+    std::atomic<ConnectionId> next_connection{0};
+    Syncer syncer;
+    /// a message relayed by several neighbours is verified once
+    VerifyCache verify_cache;
+    /// and, while it is recent, not even read again
+    DuplicateFilter duplicates;
+    /// checks signatures off the io thread. declared after what its jobs
+    /// use, so that it is joined first.
+    WorkerPool workers;
+    std::atomic<bool> running{true};
+    // error stack?
+};
+
+/// reads the connection's frames until it closes, storing the messages the
+/// peer sends and answering its sync requests
+asio::awaitable<void> handle_messages(Connection &connection, Context &ctx);
+
+// syncing is pull-based: we periodically tell the peer what we hold, and
+// handle_messages on its side answers with what we are missing
+asio::awaitable<void> periodic_sync(Connection &connection, Context &ctx);
+
+/// makes the log durable, expires relayed messages and logs the caches'
+/// stats, once per commit interval
+asio::awaitable<void> periodic_commit(Context &ctx);
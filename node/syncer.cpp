@@ -0,0 +1,484 @@
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+#include <absl/time/time.h>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+#include "node/syncer.h"
+#include "utils/varint.h"
+
+static_assert(std::is_same_v<RecipientKey, std::array<uint8_t, kPubkeySize>>);
+
+std::optional<SignedBytes> signed_bytes(hrafn::MessageHeader const &header) {
+    std::string const &id = header.message_id();
+    if (id.size() != kMessageIdSize) {
+        return std::nullopt;
+    }
+
+    SignedBytes bytes{};
+    std::copy(id.begin(), id.end(), bytes.begin());
+
+    uint64_t timestamp = header.timestamp();
+    for (size_t i = 0; i < sizeof(timestamp); ++i) {
+        bytes[kMessageIdSize + i] = static_cast<uint8_t>(timestamp >> (8 * i));
+    }
+
+    crypto_generichash_state recipients;
+    crypto_generichash_init(&recipients, nullptr, 0, kMessageIdSize);
+    for (std::string const &recipient : header.recipients()) {
+        if (recipient.size() != kPubkeySize) {
+            return std::nullopt;
+        }
+
+        crypto_generichash_update(&recipients,
+                reinterpret_cast<uint8_t const *>(recipient.data()),
+                recipient.size());
+    }
+    crypto_generichash_final(&recipients,
+            bytes.data() + kMessageIdSize + sizeof(timestamp),
+            kMessageIdSize);
+
+    return bytes;
+}
+
+void sign_message(Message &message, Keypair const &keypair) {
+    MessageId id = message_id(message.data);
+    message.header.set_message_id(id.data(), id.size());
+    message.header.clear_recipients();
+    for (Pubkey const &recipient : message.recipients) {
+        message.header.add_recipients(
+                recipient.data().data(), recipient.data().size());
+    }
+
+    SignedBytes bytes = signed_bytes(message.header).value();
+    Signature signature = keypair.privkey.sign(bytes);
+
+    Pubkey const &author = keypair.pubkey;
+    message.header.set_author(author.data().data(), author.data().size());
+    message.header.set_signature(
+            signature.bytes.data(), signature.bytes.size());
+}
+
+namespace {
+
+// relayed messages are dropped this long after they were sent
+constexpr absl::Duration kRelayTtl = absl::Hours(24 * 7);
+// the message log is compacted once it holds this many records, dead ones
+// included, per message still held
+constexpr size_t kLogCompactionRatio = 2;
+
+// a message record in the log is the varuint length of a StoredMessage, the
+// StoredMessage itself, and then the raw data. the data stays outside the
+// protobuf so that syncing can write it straight out of the mapping.
+//
+// encodes into `stored` and `record`, whose capacity is reused from message
+// to message.
+void encode_message_record(MessageId const &id,
+        hrafn::MessageHeader const &header,
+        std::span<uint8_t const> data,
+        MessageOrigin origin,
+        hrafn::StoredMessage &stored,
+        std::vector<uint8_t> &record) {
+    *stored.mutable_header() = header;
+    stored.mutable_header()->set_message_id(id.data(), id.size());
+    stored.set_local(origin == MessageOrigin::Local);
+
+    size_t stored_size = stored.ByteSizeLong();
+    size_t stored_offset = varuint_size(stored_size);
+    record.resize(stored_offset + stored_size + data.size());
+
+    encode_varuint(stored_size, record);
+    stored.SerializeWithCachedSizesToArray(record.data() + stored_offset);
+    std::ranges::copy(data, record.begin() + stored_offset + stored_size);
+}
+
+// a tombstone is a record of a StoredMessage with only the message id and
+// `evicted` set. it keeps an evicted message from coming back when the log
+// is read again on restart.
+void encode_tombstone_record(
+        MessageId const &id, std::vector<uint8_t> &record) {
+    hrafn::StoredMessage stored;
+    stored.mutable_header()->set_message_id(id.data(), id.size());
+    stored.set_evicted(true);
+
+    size_t stored_size = stored.ByteSizeLong();
+    size_t stored_offset = varuint_size(stored_size);
+    record.resize(stored_offset + stored_size);
+
+    encode_varuint(stored_size, record);
+    stored.SerializeWithCachedSizesToArray(record.data() + stored_offset);
+}
+
+/// the recipients `header` lists. malformed ones are skipped, though
+/// signed_bytes already rejects a header that has any.
+std::vector<RecipientKey> recipient_keys(hrafn::MessageHeader const &header) {
+    std::vector<RecipientKey> keys;
+    for (std::string const &recipient : header.recipients()) {
+        if (recipient.size() != std::tuple_size_v<RecipientKey>) {
+            continue;
+        }
+
+        RecipientKey &key = keys.emplace_back();
+        std::copy(recipient.begin(), recipient.end(), key.begin());
+    }
+
+    return keys;
+}
+
+struct StoredMessageView {
+    hrafn::StoredMessage stored;
+    /// points into the message log
+    std::span<uint8_t const> data;
+
+    std::vector<RecipientKey> recipients() const {
+        return recipient_keys(stored.header());
+    }
+};
+
+std::optional<StoredMessageView> decode_message_record(
+        std::span<uint8_t const> record) {
+    auto [stored_size, read] = try_unwrap_optional(decode_varuint(record));
+    if (read + stored_size > record.size()) {
+        return std::nullopt;
+    }
+
+    StoredMessageView view;
+    if (!view.stored.ParseFromArray(
+                record.data() + read, static_cast<int>(stored_size))) {
+        return std::nullopt;
+    }
+    view.data = record.subspan(read + stored_size);
+
+    return view;
+}
+
+} // namespace
+
+Syncer::Syncer(MessageLog log, Pubkey self, RelayCacheOptions const &options)
+    : log_{std::move(log)}, self_{self}, cache_{options} {
+    // the last record of every message that was not evicted after it:
+    // compaction copies live records forward, and evictions leave a
+    // tombstone behind
+    std::unordered_map<MessageId, LogOffset, MessageIdHash> held;
+    for (LogRecord record : log_) {
+        auto message = decode_message_record(record.data);
+        if (!message.has_value()) {
+            continue;
+        }
+
+        auto id = message_id_from_stringbytes(
+                message->stored.header().message_id());
+        if (!id.has_value()) {
+            continue;
+        }
+
+        if (message->stored.evicted()) {
+            held.erase(id.value());
+        } else {
+            held.insert_or_assign(id.value(), record.offset);
+        }
+    }
+
+    // in log order, which is about the order they were received in
+    std::vector<LogOffset> offsets;
+    offsets.reserve(held.size());
+    for (auto const &[_, offset] : held) {
+        offsets.push_back(offset);
+    }
+    std::ranges::sort(offsets);
+
+    std::vector<MessageCache::Entry> evicted;
+    for (LogOffset offset : offsets) {
+        // read above, the log did not change since
+        std::span<uint8_t const> record = log_.read(offset).value();
+        auto message = decode_message_record(record);
+        hrafn::MessageHeader const &header = message->stored.header();
+        MessageId id =
+                message_id_from_stringbytes(header.message_id()).value();
+
+        std::vector<RecipientKey> recipients = message->recipients();
+        track(id, header.timestamp(), offset, recipients);
+
+        std::ranges::move(cache_.insert(cache_entry(id,
+                                  record.size(),
+                                  header.timestamp(),
+                                  message->stored.local(),
+                                  recipients)),
+                std::back_inserter(evicted));
+    }
+
+    drop(evicted);
+}
+
+std::expected<void, LogError> Syncer::add_message(
+        hrafn::MessageHeader const &header,
+        std::span<uint8_t const> data,
+        MessageOrigin origin) {
+    MessageId id = message_id(data);
+    if (offsets_.contains(id)) {
+        // receiving it again is what makes a relayed message popular
+        cache_.access(id);
+        return {};
+    }
+
+    encode_message_record(id, header, data, origin, stored_, record_);
+    LogOffset offset = try_unwrap(log_.append(record_));
+
+    std::vector<RecipientKey> recipients = recipient_keys(header);
+    track(id, header.timestamp(), offset, recipients);
+
+    drop(cache_.insert(cache_entry(id,
+            record_.size(),
+            header.timestamp(),
+            origin == MessageOrigin::Local,
+            recipients)));
+
+    return {};
+}
+
+HaveSummary Syncer::summary() const {
+    HaveSummary summary{offsets_.size()};
+    for (auto const &[id, _] : offsets_) {
+        summary.add(id);
+    }
+
+    return summary;
+}
+
+asio::awaitable<std::expected<void, asio::error_code>> Syncer::sync(
+        Connection &connection,
+        SyncMode mode,
+        HaveSummary const *peer_summary) {
+    if (mode == SyncMode::Reconcile) {
+        co_await write_reconcile(connection, reconciler_.initiate());
+        co_return std::expected<void, asio::error_code>{};
+    }
+
+    // FIXME: this does not work
+    auto since = static_cast<uint64_t>(connection.contact.last_sync);
+
+    // direct syncs only touch the messages pending for this contact
+    MessageIndex::Range pending = mode == SyncMode::Direct
+            ? index_.for_recipient(connection.contact.pubkey.data(), since)
+            : index_.since(since);
+
+    // copied, messages received while we are suspended modify the index
+    std::vector<IndexEntry> entries{pending.begin(), pending.end()};
+
+    for (IndexEntry entry : entries) {
+        auto record = log_.read(entry.offset);
+        if (!record.has_value()) {
+            // its segment was deleted while we were suspended
+            continue;
+        }
+
+        auto message = decode_message_record(record.value());
+        if (!message.has_value()) {
+            continue;
+        }
+
+        hrafn::MessageHeader const &header = message->stored.header();
+
+        auto id = message_id_from_stringbytes(header.message_id());
+        if (!id.has_value()
+                || (peer_summary != nullptr
+                        && peer_summary->might_have(id.value()))) {
+            continue;
+        }
+
+        // evicted or compacted away while we were suspended, the
+        // next sync picks it up from where it went
+        auto held = offsets_.find(id.value());
+        if (held == offsets_.end() || held->second != entry.offset) {
+            continue;
+        }
+
+        cache_.access(id.value());
+        co_await sync_one(connection, header, message->data);
+    }
+
+    // weird.
+    co_return std::expected<void, asio::error_code>{};
+}
+
+asio::awaitable<std::expected<void, asio::error_code>> Syncer::reconcile(
+        Connection &connection, ReconcileMessage const &message) {
+    ReconcileStep step = reconciler_.process(message);
+
+    for (MessageId const &id : step.to_send) {
+        auto offset = offsets_.find(id);
+        if (offset == offsets_.end()) {
+            // evicted while we were suspended
+            continue;
+        }
+        cache_.access(id);
+
+        auto record = decode_message_record(
+                log_.read(offset->second).value_or(
+                        std::span<uint8_t const>{}));
+        if (record.has_value()) {
+            co_await sync_one(
+                    connection, record->stored.header(), record->data);
+        }
+    }
+
+    if (!step.reply.empty()) {
+        co_await write_reconcile(connection, step.reply);
+    }
+
+    co_return std::expected<void, asio::error_code>{};
+}
+
+void Syncer::track(MessageId const &id,
+        uint64_t timestamp,
+        LogOffset offset,
+        std::span<RecipientKey const> recipients) {
+    offsets_.emplace(id, offset);
+    reconciler_.insert(timestamp, id);
+    index_.insert({.timestamp = timestamp, .offset = offset}, recipients);
+    live_records_[log_offset_segment(offset)]++;
+}
+
+MessageCache::Entry Syncer::cache_entry(MessageId const &id,
+        uint64_t size,
+        uint64_t timestamp,
+        bool local,
+        std::span<RecipientKey const> recipients) const {
+    return {
+            .key = id,
+            .size = size,
+            .expires_at = timestamp
+                    + static_cast<uint64_t>(
+                            absl::ToInt64Seconds(kRelayTtl)),
+            .pinned = local
+                    || std::ranges::contains(recipients, self_.data()),
+    };
+}
+
+void Syncer::drop(std::vector<MessageCache::Entry> const &entries) {
+    if (entries.empty()) {
+        return;
+    }
+
+    for (MessageCache::Entry const &entry : entries) {
+        auto offset = offsets_.find(entry.key);
+        if (offset == offsets_.end()) {
+            continue;
+        }
+
+        if (auto message = decode_message_record(
+                    log_.read(offset->second).value_or(
+                            std::span<uint8_t const>{}))) {
+            uint64_t timestamp = message->stored.header().timestamp();
+            index_.erase(
+                    {.timestamp = timestamp, .offset = offset->second},
+                    message->recipients());
+            reconciler_.erase(timestamp, entry.key);
+        }
+
+        auto live = live_records_.find(log_offset_segment(offset->second));
+        if (--live->second == 0) {
+            live_records_.erase(live);
+        }
+
+        offsets_.erase(offset);
+
+        encode_tombstone_record(entry.key, record_);
+        if (!log_.append(record_).has_value()) {
+            spdlog::error("Failed to log the eviction of a message");
+        }
+    }
+
+    drop_dead_segments();
+    compact();
+}
+
+void Syncer::drop_dead_segments() {
+    uint32_t first_live = live_records_.empty()
+            ? log_.active_segment()
+            : live_records_.begin()->first;
+    if (!log_.drop_segments_before(first_live).has_value()) {
+        spdlog::error("Failed to delete old message log segments");
+    }
+}
+
+void Syncer::compact() {
+    while (log_.first_segment() != log_.active_segment()
+            && log_.record_count()
+                    > kLogCompactionRatio * offsets_.size()) {
+        uint32_t first = log_.first_segment();
+
+        for (LogOffset offset = log_.begin_offset();
+                log_offset_segment(offset) == first;
+                offset = log_.next(offset)) {
+            if (!relocate(offset)) {
+                spdlog::error("Failed to compact the message log");
+                return;
+            }
+        }
+
+        drop_dead_segments();
+        if (log_.first_segment() == first) {
+            return;
+        }
+    }
+}
+
+bool Syncer::relocate(LogOffset offset) {
+    std::span<uint8_t const> record = log_.read(offset).value();
+    auto message = decode_message_record(record);
+    if (!message.has_value() || message->stored.evicted()) {
+        return true;
+    }
+
+    hrafn::MessageHeader const &header = message->stored.header();
+    auto id = message_id_from_stringbytes(header.message_id());
+    auto held = id.has_value() ? offsets_.find(id.value()) : offsets_.end();
+    if (held == offsets_.end() || held->second != offset) {
+        return true;
+    }
+
+    // the old segment stays mapped until it is dropped, so the record
+    // is copied straight from it
+    auto moved = log_.append(record);
+    if (!moved.has_value()) {
+        return false;
+    }
+
+    std::vector<RecipientKey> recipients = message->recipients();
+    index_.erase({.timestamp = header.timestamp(), .offset = offset},
+            recipients);
+    index_.insert(
+            {.timestamp = header.timestamp(), .offset = moved.value()},
+            recipients);
+
+    auto live = live_records_.find(log_offset_segment(offset));
+    if (--live->second == 0) {
+        live_records_.erase(live);
+    }
+    live_records_[log_offset_segment(moved.value())]++;
+    held->second = moved.value();
+
+    return true;
+}
+
+asio::awaitable<void> Syncer::write_reconcile(
+        Connection &connection, ReconcileMessage const &message) {
+    std::vector<uint8_t> bytes = message.serialize();
+
+    hrafn::SyncFrame frame;
+    frame.mutable_reconcile()->set_message(bytes.data(), bytes.size());
+
+    co_await channel_send_frames(connection, frame);
+}
+
+asio::awaitable<void> Syncer::sync_one(Connection &connection,
+        hrafn::MessageHeader const &header,
+        std::span<uint8_t const> data) {
+    hrafn::SyncFrame frame;
+    *frame.mutable_header() = header;
+
+    co_await channel_send_frames(connection, frame, data);
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <map>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "crypto/crypto.h"
+#include "messages.pb.h"
+#include "node/connection.h"
+#include "store/message_index.h"
+#include "store/message_log.h"
+#include "store/relay_cache.h"
+#include "sync/have_summary.h"
+#include "sync/message_id.h"
+#include "sync/range_reconciler.h"
+
+struct Message {
+    std::vector<uint8_t> data;
+    // should use an internal header that packs into it
+    hrafn::MessageHeader header;
+    std::vector<Pubkey> recipients;
+};
+
+enum class MessageOrigin : uint8_t {
+    /// authored on this device
+    Local,
+    /// received from a peer, kept to forward it
+    Relayed,
+};
+
+using SignedBytes =
+        std::array<uint8_t, kMessageIdSize + sizeof(uint64_t) + kMessageIdSize>;
+
+/// what an author signs: the message id, which covers the data, the
+/// timestamp, which decides how long relays keep the message, and a digest
+/// of the recipients, whom relays pin and forward it for. nullopt if the
+/// id or a recipient is malformed.
+std::optional<SignedBytes> signed_bytes(hrafn::MessageHeader const &header);
+
+/// sets the id, recipients, author and signature of a message authored on
+/// this device
+void sign_message(Message &message, Keypair const &keypair);
+
+enum class SyncMode : uint8_t {
+    Full,
+    Direct,
+    /// range-based set reconciliation, for large stores on both sides
+    Reconcile,
+};
+
+using MessageCache = RelayCache<MessageId, MessageIdHash>;
+
+class Syncer {
+public:
+    /// messages authored by or addressed to `self` are pinned, everything
+    /// else is relayed and bounded by `options`
+    Syncer(MessageLog log, Pubkey self, RelayCacheOptions const &options = {});
+
+    /// stores `message` unless we already hold it. it must be signed,
+    /// which copies its recipients into the header.
+    std::expected<void, LogError> add_message(Message const &message,
+            MessageOrigin origin = MessageOrigin::Relayed) {
+        return add_message(message.header, message.data, origin);
+    }
+
+    /// stores the message `header` announces, for the recipients it lists,
+    /// unless we already hold it. `data` is copied once, into the log
+    /// record.
+    std::expected<void, LogError> add_message(
+            hrafn::MessageHeader const &header,
+            std::span<uint8_t const> data,
+            MessageOrigin origin = MessageOrigin::Relayed);
+
+    size_t size() const { return offsets_.size(); }
+
+    /// notes that a message we hold was received again, false if we do not
+    /// hold it
+    bool refresh(MessageId const &id) {
+        if (!offsets_.contains(id)) {
+            return false;
+        }
+
+        cache_.access(id);
+        return true;
+    }
+
+    /// what we hold, sent to a peer so it only streams what we lack
+    HaveSummary summary() const;
+
+    /// makes every message added so far durable. appends are already
+    /// group-committed by the log, this flushes a partial group.
+    std::expected<void, LogError> commit() { return log_.commit(); }
+
+    /// drops the relayed messages whose ttl ran out by `now`
+    void expire(uint64_t now) { drop(cache_.expire(now)); }
+
+    RelayCacheStats const &cache_stats() const { return cache_.stats(); }
+
+    /// streams our messages to the peer, skipping the ones its summary
+    /// says it already has
+    asio::awaitable<std::expected<void, asio::error_code>> sync(
+            Connection &connection,
+            SyncMode mode,
+            HaveSummary const *peer_summary = nullptr);
+
+    /// answers one round of a range reconciliation, sending the messages
+    /// the peer turned out to be missing
+    asio::awaitable<std::expected<void, asio::error_code>> reconcile(
+            Connection &connection, ReconcileMessage const &message);
+
+private:
+    MessageLog log_;
+    Pubkey self_;
+    MessageIndex index_;
+    std::unordered_map<MessageId, LogOffset, MessageIdHash> offsets_;
+    RangeReconciler reconciler_;
+    MessageCache cache_;
+    /// messages still held per log segment, a segment is deleted once it
+    /// and all the ones before it hold none, or compacted
+    std::map<uint32_t, size_t> live_records_;
+    /// what add_message and drop encode into, kept to reuse their capacity
+    hrafn::StoredMessage stored_;
+    std::vector<uint8_t> record_;
+
+    void track(MessageId const &id,
+            uint64_t timestamp,
+            LogOffset offset,
+            std::span<RecipientKey const> recipients);
+
+    MessageCache::Entry cache_entry(MessageId const &id,
+            uint64_t size,
+            uint64_t timestamp,
+            bool local,
+            std::span<RecipientKey const> recipients) const;
+
+    /// forgets messages the cache evicted or expired, leaving a tombstone
+    /// for each in the log, and deletes the log segments nothing points
+    /// into anymore
+    void drop(std::vector<MessageCache::Entry> const &entries);
+
+    /// deletes the segments before the first one still holding a message
+    void drop_dead_segments();
+
+    /// once most of the log is dead, copies the messages left in its first
+    /// segment to the end and deletes the segment, until it is not. pinned
+    /// messages cycle through the log this way, rather than keeping every
+    /// segment after theirs around.
+    void compact();
+
+    /// appends a copy of the record at `offset` and points at it instead,
+    /// if it is the live record of a message. false if the append failed.
+    bool relocate(LogOffset offset);
+
+    asio::awaitable<void> write_reconcile(
+            Connection &connection, ReconcileMessage const &message);
+
+    asio::awaitable<void> sync_one(Connection &connection,
+            hrafn::MessageHeader const &header,
+            std::span<uint8_t const> data);
+};
@@ -0,0 +1,229 @@
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+#include <asio.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "net/loopback_stream.h"
+#include "node.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::filesystem::path fresh_directory(std::string const &name) {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(path);
+    return path;
+}
+
+Context make_context(asio::io_context &executor, std::string const &name) {
+    Keypair keypair = Keypair::generate();
+    Pubkey self = keypair.pubkey;
+
+    return Context{
+            .executor = executor,
+            .keypair = std::move(keypair),
+            .routes = RoutingTable{},
+            .syncer = Syncer{MessageLog::open(fresh_directory(name)).value(),
+                    self},
+            .verify_cache = VerifyCache{},
+            .duplicates = DuplicateFilter{},
+            .workers = WorkerPool{2},
+    };
+}
+
+uint64_t unix_now() {
+    return static_cast<uint64_t>(absl::ToUnixSeconds(absl::Now()));
+}
+
+/// message `i`, signed by `author` for `recipients`
+Message make_message(Keypair const &author,
+        uint64_t now,
+        size_t i,
+        std::vector<Pubkey> recipients = {}) {
+    Message message;
+    message.data.assign(16 + i % 64, static_cast<uint8_t>(i));
+    message.data[0] = static_cast<uint8_t>(i >> 8);
+    message.header.set_size(static_cast<uint32_t>(message.data.size()));
+    // spread over a few hours, so that reconciling descends the range tree
+    message.header.set_timestamp(now - i * 60);
+    message.recipients = std::move(recipients);
+    sign_message(message, author);
+    return message;
+}
+
+/// both ends of a connection, kept alive while their handlers run
+struct Link {
+    std::optional<Connection> from;
+    std::optional<Connection> to;
+};
+
+/// connects `from` to `to` over a BLE-sized loopback link, so that messages
+/// go out in several fragments, and handles messages on both ends
+asio::awaitable<void> connect(Context &from, Context &to, Link &link) {
+    using namespace asio::experimental::awaitable_operators;
+    auto [stream_from, stream_to] =
+            LoopbackStream::pair(from.executor.get_executor(), {.mtu = 185});
+
+    auto [negotiated_from, negotiated_to] = co_await (
+            Connection::negotiate(std::move(stream_from), from.keypair)
+            && Connection::negotiate(std::move(stream_to), to.keypair));
+    REQUIRE(negotiated_from.has_value());
+    REQUIRE(negotiated_to.has_value());
+    link.from.emplace(std::move(negotiated_from.value()));
+    link.to.emplace(std::move(negotiated_to.value()));
+
+    asio::co_spawn(from.executor,
+            handle_messages(link.from.value(), from),
+            asio::detached);
+    asio::co_spawn(to.executor,
+            handle_messages(link.to.value(), to),
+            asio::detached);
+}
+
+/// polls until `done` or a deadline, received messages are stored a
+/// verify batch at a time
+asio::awaitable<void> wait_until(
+        asio::io_context &executor, std::function<bool()> done) {
+    asio::steady_timer timer{executor};
+    auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+        timer.expires_after(1ms);
+        co_await timer.async_wait(asio::use_awaitable);
+    }
+}
+
+/// runs `test` to completion. handle_messages reads until the streams
+/// close, so the executor is stopped rather than run dry.
+void run(asio::io_context &executor,
+        std::function<asio::awaitable<void>()> test) {
+    asio::co_spawn(executor, [&]() -> asio::awaitable<void> {
+        co_await test();
+        executor.stop();
+    }, asio::detached);
+
+    executor.run();
+}
+
+} // namespace
+
+TEST_CASE("Two nodes reconcile over a loopback stream") {
+    asio::io_context executor;
+    Context a = make_context(executor, "hrafn_test_sync_a");
+    Context b = make_context(executor, "hrafn_test_sync_b");
+
+    // both hold messages the other lacks, and share some
+    Keypair author = Keypair::generate();
+    uint64_t now = unix_now();
+    constexpr size_t kMessages = 300;
+    for (size_t i = 0; i < kMessages; ++i) {
+        Message message = make_message(author, now, i);
+        if (i < 200) {
+            REQUIRE(a.syncer.add_message(message).has_value());
+        }
+        if (i >= 100) {
+            REQUIRE(b.syncer.add_message(message).has_value());
+        }
+    }
+    REQUIRE_EQ(a.syncer.size(), 200);
+    REQUIRE_EQ(b.syncer.size(), 200);
+
+    Link link;
+    run(executor, [&]() -> asio::awaitable<void> {
+        co_await connect(a, b, link);
+
+        // the rounds that follow are answered by handle_messages
+        CHECK((co_await a.syncer.sync(
+                       link.from.value(), SyncMode::Reconcile))
+                        .has_value());
+
+        co_await wait_until(executor, [&] {
+            return a.syncer.size() == kMessages
+                    && b.syncer.size() == kMessages;
+        });
+    });
+
+    CHECK_EQ(a.syncer.size(), kMessages);
+    CHECK_EQ(b.syncer.size(), kMessages);
+}
+
+TEST_CASE("A received message addressed to us is pinned") {
+    asio::io_context executor;
+    Context a = make_context(executor, "hrafn_test_sync_pin_a");
+    Context b = make_context(executor, "hrafn_test_sync_pin_b");
+
+    uint64_t now = unix_now();
+    Message to_b = make_message(a.keypair, now, 0, {b.keypair.pubkey});
+    REQUIRE(a.syncer.add_message(to_b, MessageOrigin::Local).has_value());
+    Message to_no_one = make_message(a.keypair, now, 1);
+    REQUIRE(a.syncer.add_message(to_no_one, MessageOrigin::Local).has_value());
+
+    // a relay that readdresses a message invalidates its signature
+    Message readdressed = make_message(a.keypair, now, 2);
+    readdressed.header.add_recipients(b.keypair.pubkey.data().data(),
+            b.keypair.pubkey.data().size());
+    REQUIRE(a.syncer.add_message(readdressed).has_value());
+
+    Link link;
+    run(executor, [&]() -> asio::awaitable<void> {
+        co_await connect(a, b, link);
+        CHECK((co_await a.syncer.sync(link.from.value(), SyncMode::Full))
+                        .has_value());
+
+        co_await wait_until(executor, [&] { return b.syncer.size() == 2; });
+    });
+
+    // the readdressed one was sent first, being the oldest, and dropped
+    CHECK_EQ(b.syncer.size(), 2);
+    CHECK_EQ(b.syncer.cache_stats().pinned_count, 1);
+}
+
+TEST_CASE("A relay forwards a message to its recipient in Direct mode") {
+    asio::io_context executor;
+    Context a = make_context(executor, "hrafn_test_sync_direct_a");
+    Context b = make_context(executor, "hrafn_test_sync_direct_b");
+    Context c = make_context(executor, "hrafn_test_sync_direct_c");
+
+    uint64_t now = unix_now();
+    Message to_c = make_message(a.keypair, now, 0, {c.keypair.pubkey});
+    REQUIRE(a.syncer.add_message(to_c, MessageOrigin::Local).has_value());
+    Message to_b = make_message(a.keypair, now, 1, {b.keypair.pubkey});
+    REQUIRE(a.syncer.add_message(to_b, MessageOrigin::Local).has_value());
+    Message to_no_one = make_message(a.keypair, now, 2);
+    REQUIRE(a.syncer.add_message(to_no_one, MessageOrigin::Local).has_value());
+
+    Link a_to_b;
+    Link b_to_c;
+    run(executor, [&]() -> asio::awaitable<void> {
+        // b relays everything it meets, a is gone before c comes by
+        co_await connect(a, b, a_to_b);
+        CHECK((co_await a.syncer.sync(a_to_b.from.value(), SyncMode::Full))
+                        .has_value());
+        co_await wait_until(executor, [&] { return b.syncer.size() == 3; });
+        REQUIRE_EQ(b.syncer.size(), 3);
+
+        co_await connect(b, c, b_to_c);
+        CHECK((co_await b.syncer.sync(b_to_c.from.value(), SyncMode::Direct))
+                        .has_value());
+        co_await wait_until(executor, [&] { return c.syncer.size() == 1; });
+    });
+
+    // only what is addressed to c went over, found by the recipient index
+    // from the relayed header
+    CHECK_EQ(c.syncer.size(), 1);
+    CHECK_EQ(c.syncer.cache_stats().pinned_count, 1);
+    CHECK_EQ(b.syncer.cache_stats().pinned_count, 1);
+}
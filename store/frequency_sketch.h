@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+/// approximate access frequencies in 4-bit count-min counters, as used by
+/// TinyLFU admission. every key touches kDepth counters, one per row, and
+/// its frequency is the smallest of them. once sample_size increments have
+/// been seen all counters are halved, so old popularity fades out.
+class FrequencySketch {
+public:
+    static constexpr size_t kDepth = 4;
+    static constexpr uint8_t kMaxFrequency = 15;
+
+    explicit FrequencySketch(size_t capacity)
+        : table_(std::bit_ceil(std::max<size_t>(capacity, 16))),
+          sample_size_{10 * std::max<size_t>(capacity, 16)} {}
+
+    void increment(uint64_t hash) {
+        bool added = false;
+        for (size_t i = 0; i < kDepth; ++i) {
+            auto [word, shift] = counter(hash, i);
+            if (((table_[word] >> shift) & 0xf) < kMaxFrequency) {
+                table_[word] += uint64_t{1} << shift;
+                added = true;
+            }
+        }
+
+        if (added && ++size_ >= sample_size_) {
+            reset();
+        }
+    }
+
+    uint8_t frequency(uint64_t hash) const {
+        uint8_t frequency = kMaxFrequency;
+        for (size_t i = 0; i < kDepth; ++i) {
+            auto [word, shift] = counter(hash, i);
+            auto count = static_cast<uint8_t>((table_[word] >> shift) & 0xf);
+            frequency = std::min(frequency, count);
+        }
+
+        return frequency;
+    }
+
+private:
+    std::vector<uint64_t> table_;
+    size_t sample_size_;
+    size_t size_ = 0;
+
+    /// the word and bit shift of the key's counter in row `i`
+    std::pair<size_t, size_t> counter(uint64_t hash, size_t i) const {
+        static constexpr std::array<uint64_t, kDepth> kSeeds{
+                0xc3a5c85c97cb3127,
+                0xb492b66fbe98f273,
+                0x9ae16a3b2f90404f,
+                0xcbf29ce484222325,
+        };
+
+        uint64_t mixed = (hash + kSeeds[i]) * 0x9e3779b97f4a7c15;
+        mixed ^= mixed >> 32;
+
+        // each word holds 16 counters, every row uses its own quarter of them
+        size_t word = mixed & (table_.size() - 1);
+        size_t shift = ((i * 4) + ((mixed >> 40) & 3)) * 4;
+        return {word, shift};
+    }
+
+    void reset() {
+        for (uint64_t &word : table_) {
+            word = (word >> 1) & 0x7777777777777777;
+        }
+        size_ /= 2;
+    }
+};
@@ -0,0 +1,53 @@
+#include "store/message_index.h"
+
+namespace {
+
+MessageIndex::Range tail_since(
+        MessageIndex::Entries const &entries, uint64_t timestamp) {
+    return {entries.lower_bound(
+                    IndexEntry{.timestamp = timestamp, .offset = 0}),
+            entries.end()};
+}
+
+} // namespace
+
+void MessageIndex::insert(
+        IndexEntry entry, std::span<RecipientKey const> recipients) {
+    by_timestamp_.insert(entry);
+
+    for (RecipientKey const &recipient : recipients) {
+        by_recipient_[recipient].insert(entry);
+    }
+}
+
+void MessageIndex::erase(
+        IndexEntry entry, std::span<RecipientKey const> recipients) {
+    by_timestamp_.erase(entry);
+
+    for (RecipientKey const &recipient : recipients) {
+        auto it = by_recipient_.find(recipient);
+        if (it == by_recipient_.end()) {
+            continue;
+        }
+
+        it->second.erase(entry);
+        if (it->second.empty()) {
+            by_recipient_.erase(it);
+        }
+    }
+}
+
+MessageIndex::Range MessageIndex::since(uint64_t timestamp) const {
+    return tail_since(by_timestamp_, timestamp);
+}
+
+MessageIndex::Range MessageIndex::for_recipient(
+        RecipientKey const &recipient, uint64_t since) const {
+    auto it = by_recipient_.find(recipient);
+    if (it == by_recipient_.end()) {
+        // an empty range of the right type
+        return {by_timestamp_.end(), by_timestamp_.end()};
+    }
+
+    return tail_since(it->second, since);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+
+#include <absl/container/btree_set.h>
+
+#include "store/message_log.h"
+
+/// raw bytes of a recipient's public key
+using RecipientKey = std::array<uint8_t, 32>;
+
+struct RecipientKeyHash {
+    size_t operator()(RecipientKey const &key) const {
+        return std::hash<std::string_view>{}(std::string_view{
+                reinterpret_cast<char const *>(key.data()), key.size()});
+    }
+};
+
+struct IndexEntry {
+    uint64_t timestamp;
+    LogOffset offset;
+
+    auto operator<=>(IndexEntry const &) const = default;
+};
+
+/// secondary indexes over the message log: every message by timestamp, and
+/// every message addressed to a recipient by recipient then timestamp.
+///
+/// entries are kept in b-trees ordered by (timestamp, offset), so inserting
+/// and erasing are logarithmic wherever the timestamp falls, and a query is
+/// a walk over contiguous nodes.
+class MessageIndex {
+public:
+    using Entries = absl::btree_set<IndexEntry>;
+    /// valid until the index is next modified
+    using Range = std::ranges::subrange<Entries::const_iterator>;
+
+    void insert(IndexEntry entry, std::span<RecipientKey const> recipients);
+
+    /// removes the message at `offset`, the arguments must match insert()
+    void erase(IndexEntry entry, std::span<RecipientKey const> recipients);
+
+    /// every message with a timestamp of at least `since`
+    Range since(uint64_t timestamp) const;
+
+    /// every message addressed to `recipient` with a timestamp of at least
+    /// `since`
+    Range for_recipient(RecipientKey const &recipient, uint64_t since) const;
+
+    size_t size() const { return by_timestamp_.size(); }
+
+private:
+    Entries by_timestamp_;
+    std::unordered_map<RecipientKey, Entries, RecipientKeyHash> by_recipient_;
+};
@@ -0,0 +1,577 @@
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include <absl/strings/str_format.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crypto/crc64.h"
+#include "store/message_log.h"
+#include "utils/error_utils.h"
+
+namespace {
+
+constexpr uint32_t kRecordMagic = 0x6c726668; // "hfrl"
+constexpr uint64_t kCheckpointMagic = 0x74706b6368667268;
+constexpr char const *kCheckpointName = "CHECKPOINT";
+constexpr char const *kSegmentSuffix = ".seg";
+
+struct RecordHeader {
+    uint32_t length;
+    uint32_t magic;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(RecordHeader) == 16);
+
+struct Checkpoint {
+    uint64_t magic;
+    LogOffset committed;
+    uint64_t checksum;
+};
+
+constexpr size_t align_record(size_t size) {
+    return (size + alignof(RecordHeader) - 1) & ~(alignof(RecordHeader) - 1);
+}
+
+uint64_t record_checksum(
+        RecordHeader const &header, std::span<uint8_t const> data) {
+    uint64_t crc = crypto::crc64(
+            {reinterpret_cast<uint8_t const *>(&header), sizeof(uint64_t)});
+    return crypto::crc64(crc, data);
+}
+
+uint64_t checkpoint_checksum(Checkpoint const &checkpoint) {
+    return crypto::crc64({reinterpret_cast<uint8_t const *>(&checkpoint),
+            offsetof(Checkpoint, checksum)});
+}
+
+std::string segment_name(uint32_t id) {
+    return absl::StrFormat("%08x%s", id, kSegmentSuffix);
+}
+
+std::optional<uint32_t> parse_segment_name(std::string_view name) {
+    if (!name.ends_with(kSegmentSuffix)) {
+        return std::nullopt;
+    }
+
+    name.remove_suffix(std::strlen(kSegmentSuffix));
+
+    uint32_t id = 0;
+    auto [end, ec] =
+            std::from_chars(name.data(), name.data() + name.size(), id, 16);
+    if (name.size() != 8 || ec != std::errc{} || end != name.end()) {
+        return std::nullopt;
+    }
+
+    return id;
+}
+
+std::optional<LogOffset> read_checkpoint(
+        std::filesystem::path const &directory) {
+    int fd = ::open((directory / kCheckpointName).c_str(), O_RDONLY);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    Checkpoint checkpoint{};
+    ssize_t read = ::pread(fd, &checkpoint, sizeof(checkpoint), 0);
+    ::close(fd);
+
+    if (read != sizeof(checkpoint) || checkpoint.magic != kCheckpointMagic
+            || checkpoint.checksum != checkpoint_checksum(checkpoint)) {
+        return std::nullopt;
+    }
+
+    return checkpoint.committed;
+}
+
+size_t page_size() {
+    static size_t const size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+/// sizes the file to `size` bytes, all of them backed by disk. a sparse
+/// file would let the disk fill up under the mapping, and the store into
+/// the unbacked page raise SIGBUS instead of failing the append.
+bool allocate(int fd, size_t size) {
+#ifdef __APPLE__
+    fstore_t store{
+            .fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL,
+            .fst_posmode = F_PEOFPOSMODE,
+            .fst_offset = 0,
+            .fst_length = static_cast<off_t>(size),
+    };
+    if (::fcntl(fd, F_PREALLOCATE, &store) == -1) {
+        // contiguous space is a preference, not a requirement
+        store.fst_flags = F_ALLOCATEALL;
+        if (::fcntl(fd, F_PREALLOCATE, &store) == -1) {
+            return false;
+        }
+    }
+
+    return ::ftruncate(fd, static_cast<off_t>(size)) == 0;
+#else
+    // falls back to writing the blocks where the filesystem cannot
+    // allocate them directly
+    return ::posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0;
+#endif
+}
+
+} // namespace
+
+std::expected<MessageLog, LogError> MessageLog::open(
+        std::filesystem::path const &directory,
+        MessageLogOptions const &options) {
+    if (options.segment_size > UINT32_MAX) {
+        return std::unexpected(LogError::InvalidOptions);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        return std::unexpected(LogError::Io);
+    }
+
+    MessageLog log{directory, options};
+
+    log.directory_fd_ = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (log.directory_fd_ < 0) {
+        return std::unexpected(LogError::Io);
+    }
+
+    try_unwrap(log.recover());
+
+    return log;
+}
+
+MessageLog::MessageLog(MessageLog &&other) noexcept
+    : directory_{std::move(other.directory_)},
+      options_{other.options_},
+      directory_fd_{std::exchange(other.directory_fd_, -1)},
+      segments_{std::move(other.segments_)},
+      record_count_{other.record_count_},
+      pending_records_{std::exchange(other.pending_records_, 0)},
+      pending_bytes_{std::exchange(other.pending_bytes_, 0)},
+      dirty_segment_{other.dirty_segment_},
+      dirty_position_{other.dirty_position_},
+      directory_dirty_{other.directory_dirty_} {
+    other.segments_.clear();
+}
+
+MessageLog &MessageLog::operator=(MessageLog &&other) noexcept {
+    if (this != &other) {
+        close();
+        directory_ = std::move(other.directory_);
+        options_ = other.options_;
+        directory_fd_ = std::exchange(other.directory_fd_, -1);
+        segments_ = std::move(other.segments_);
+        other.segments_.clear();
+        record_count_ = other.record_count_;
+        pending_records_ = std::exchange(other.pending_records_, 0);
+        pending_bytes_ = std::exchange(other.pending_bytes_, 0);
+        dirty_segment_ = other.dirty_segment_;
+        dirty_position_ = other.dirty_position_;
+        directory_dirty_ = other.directory_dirty_;
+    }
+
+    return *this;
+}
+
+MessageLog::~MessageLog() { close(); }
+
+void MessageLog::close() {
+    if (!segments_.empty()) {
+        // best effort, there is nobody left to report the error to
+        (void)commit();
+    }
+
+    for (Segment &segment : segments_) {
+        ::munmap(segment.base, segment.capacity);
+        ::close(segment.fd);
+    }
+    segments_.clear();
+
+    if (directory_fd_ >= 0) {
+        ::close(directory_fd_);
+        directory_fd_ = -1;
+    }
+}
+
+std::expected<void, LogError> MessageLog::recover() {
+    std::vector<uint32_t> ids;
+    for (auto const &entry : std::filesystem::directory_iterator(directory_)) {
+        if (auto id = parse_segment_name(entry.path().filename().string())) {
+            ids.push_back(id.value());
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+
+    for (size_t i = 1; i < ids.size(); ++i) {
+        if (ids[i] != ids[i - 1] + 1) {
+            return std::unexpected(LogError::Corrupted);
+        }
+    }
+
+    // without a checkpoint every record is validated
+    LogOffset committed = read_checkpoint(directory_).value_or(0);
+    bool torn = false;
+
+    for (uint32_t id : ids) {
+        std::filesystem::path path = directory_ / segment_name(id);
+
+        if (torn) {
+            std::filesystem::remove(path);
+            directory_dirty_ = true;
+            continue;
+        }
+
+        int fd = ::open(path.c_str(), O_RDWR);
+        struct stat st {};
+        if (fd < 0 || ::fstat(fd, &st) != 0) {
+            return std::unexpected(LogError::Io);
+        }
+
+        auto capacity = static_cast<size_t>(st.st_size);
+        if (capacity > UINT32_MAX) {
+            ::close(fd);
+            return std::unexpected(LogError::Corrupted);
+        }
+        if (capacity < sizeof(RecordHeader)) {
+            // crashed between creating and sizing the file
+            capacity = options_.segment_size;
+        }
+        // also backs the holes a crash mid-allocation left behind
+        if (!allocate(fd, capacity)) {
+            ::close(fd);
+            return std::unexpected(LogError::Io);
+        }
+
+        void *base = ::mmap(nullptr,
+                capacity,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED,
+                fd,
+                0);
+        if (base == MAP_FAILED) {
+            ::close(fd);
+            return std::unexpected(LogError::Io);
+        }
+
+        Segment segment{
+                .id = id,
+                .fd = fd,
+                .base = static_cast<uint8_t *>(base),
+                .capacity = capacity,
+                .tail = 0,
+                .records = 0,
+        };
+
+        size_t position = 0;
+        while (position + sizeof(RecordHeader) <= capacity) {
+            RecordHeader header{};
+            std::memcpy(&header, segment.base + position, sizeof(header));
+
+            if (header.length == 0 && header.magic == 0) {
+                break;
+            }
+
+            size_t end = position + sizeof(RecordHeader) + header.length;
+            if (header.magic != kRecordMagic || end > capacity) {
+                torn = true;
+                break;
+            }
+
+            // everything before the checkpoint was msynced before it was
+            // written, so only the tail has to be re-validated
+            if (make_log_offset(id, position) >= committed
+                    && header.checksum
+                            != record_checksum(header,
+                                    {segment.base + position
+                                                    + sizeof(RecordHeader),
+                                            header.length})) {
+                torn = true;
+                break;
+            }
+
+            record_count_++;
+            segment.records++;
+            position = align_record(end);
+        }
+
+        segment.tail = std::min(position, capacity);
+
+        if (torn) {
+            std::memset(segment.base + segment.tail,
+                    0,
+                    segment.capacity - segment.tail);
+            size_t start = segment.tail & ~(page_size() - 1);
+            if (::msync(segment.base + start,
+                        segment.capacity - start,
+                        MS_SYNC)
+                    != 0) {
+                return std::unexpected(LogError::Io);
+            }
+        }
+
+        segments_.push_back(segment);
+    }
+
+    if (segments_.empty()) {
+        try_unwrap(create_segment(0));
+    }
+
+    dirty_segment_ = segments_.back().id;
+    dirty_position_ = segments_.back().tail;
+
+    if (torn || directory_dirty_) {
+        if (directory_dirty_ && ::fsync(directory_fd_) != 0) {
+            return std::unexpected(LogError::Io);
+        }
+        directory_dirty_ = false;
+
+        try_unwrap(write_checkpoint());
+    }
+
+    return {};
+}
+
+std::expected<void, LogError> MessageLog::create_segment(uint32_t id) {
+    std::filesystem::path path = directory_ / segment_name(id);
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return std::unexpected(LogError::Io);
+    }
+
+    if (!allocate(fd, options_.segment_size)) {
+        ::close(fd);
+        return std::unexpected(LogError::Io);
+    }
+
+    void *base = ::mmap(nullptr,
+            options_.segment_size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED,
+            fd,
+            0);
+    if (base == MAP_FAILED) {
+        ::close(fd);
+        return std::unexpected(LogError::Io);
+    }
+
+    segments_.push_back(Segment{
+            .id = id,
+            .fd = fd,
+            .base = static_cast<uint8_t *>(base),
+            .capacity = options_.segment_size,
+            .tail = 0,
+            .records = 0,
+    });
+    directory_dirty_ = true;
+
+    return {};
+}
+
+std::expected<void, LogError> MessageLog::write_checkpoint() {
+    Checkpoint checkpoint{
+            .magic = kCheckpointMagic,
+            .committed = end_offset(),
+            .checksum = 0,
+    };
+    checkpoint.checksum = checkpoint_checksum(checkpoint);
+
+    std::filesystem::path path = directory_ / kCheckpointName;
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return std::unexpected(LogError::Io);
+    }
+
+    bool ok = ::pwrite(fd, &checkpoint, sizeof(checkpoint), 0)
+                    == sizeof(checkpoint)
+            && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (!ok || ::rename(tmp_path.c_str(), path.c_str()) != 0
+            || ::fsync(directory_fd_) != 0) {
+        return std::unexpected(LogError::Io);
+    }
+
+    return {};
+}
+
+std::expected<LogOffset, LogError> MessageLog::append(
+        std::span<uint8_t const> record) {
+    size_t needed = align_record(sizeof(RecordHeader) + record.size());
+    if (record.empty() || needed > options_.segment_size
+            || record.size() > UINT32_MAX) {
+        return std::unexpected(LogError::RecordTooLarge);
+    }
+
+    if (segments_.back().tail + needed > segments_.back().capacity) {
+        try_unwrap(create_segment(segments_.back().id + 1));
+    }
+
+    Segment &segment = segments_.back();
+    LogOffset offset =
+            make_log_offset(segment.id, static_cast<uint32_t>(segment.tail));
+
+    RecordHeader header{
+            .length = static_cast<uint32_t>(record.size()),
+            .magic = kRecordMagic,
+            .checksum = 0,
+    };
+    header.checksum = record_checksum(header, record);
+
+    uint8_t *destination = segment.base + segment.tail;
+    std::memcpy(destination + sizeof(RecordHeader),
+            record.data(),
+            record.size());
+    std::memcpy(destination, &header, sizeof(header));
+
+    segment.tail += needed;
+    segment.records++;
+    record_count_++;
+    pending_records_++;
+    pending_bytes_ += needed;
+
+    if (pending_records_ >= options_.group_commit_records
+            || pending_bytes_ >= options_.group_commit_bytes) {
+        try_unwrap(commit());
+    }
+
+    return offset;
+}
+
+std::expected<void, LogError> MessageLog::commit() {
+    if (pending_records_ == 0) {
+        return {};
+    }
+
+    for (Segment const &segment : segments_) {
+        if (segment.id < dirty_segment_) {
+            continue;
+        }
+
+        size_t start = segment.id == dirty_segment_ ? dirty_position_ : 0;
+        start &= ~(page_size() - 1);
+
+        if (segment.tail > start
+                && ::msync(segment.base + start, segment.tail - start, MS_SYNC)
+                        != 0) {
+            return std::unexpected(LogError::Io);
+        }
+    }
+
+    if (directory_dirty_) {
+        if (::fsync(directory_fd_) != 0) {
+            return std::unexpected(LogError::Io);
+        }
+        directory_dirty_ = false;
+    }
+
+    try_unwrap(write_checkpoint());
+
+    dirty_segment_ = segments_.back().id;
+    dirty_position_ = segments_.back().tail;
+    pending_records_ = 0;
+    pending_bytes_ = 0;
+
+    return {};
+}
+
+std::expected<void, LogError> MessageLog::drop_segments_before(
+        uint32_t segment) {
+    size_t dropped = 0;
+
+    while (segments_.size() - dropped > 1
+            && segments_[dropped].id < segment) {
+        Segment const &victim = segments_[dropped];
+
+        ::munmap(victim.base, victim.capacity);
+        ::close(victim.fd);
+        std::filesystem::remove(directory_ / segment_name(victim.id));
+
+        record_count_ -= victim.records;
+        dropped++;
+    }
+
+    if (dropped == 0) {
+        return {};
+    }
+
+    segments_.erase(segments_.begin(),
+            segments_.begin() + static_cast<ptrdiff_t>(dropped));
+
+    if (::fsync(directory_fd_) != 0) {
+        return std::unexpected(LogError::Io);
+    }
+
+    return {};
+}
+
+MessageLog::Segment const *MessageLog::segment(uint32_t id) const {
+    if (segments_.empty() || id < segments_.front().id
+            || id > segments_.back().id) {
+        return nullptr;
+    }
+
+    return &segments_[id - segments_.front().id];
+}
+
+std::optional<std::span<uint8_t const>> MessageLog::read(
+        LogOffset offset) const {
+    Segment const *segment = this->segment(log_offset_segment(offset));
+    size_t position = log_offset_position(offset);
+
+    if (segment == nullptr || position + sizeof(RecordHeader) > segment->tail) {
+        return std::nullopt;
+    }
+
+    RecordHeader header{};
+    std::memcpy(&header, segment->base + position, sizeof(header));
+
+    return std::span<uint8_t const>{
+            segment->base + position + sizeof(RecordHeader), header.length};
+}
+
+LogOffset MessageLog::next(LogOffset offset) const {
+    uint32_t id = log_offset_segment(offset);
+    Segment const *segment = this->segment(id);
+    size_t position = log_offset_position(offset);
+
+    if (segment == nullptr || position >= segment->tail) {
+        return end_offset();
+    }
+
+    RecordHeader header{};
+    std::memcpy(&header, segment->base + position, sizeof(header));
+    position = align_record(position + sizeof(RecordHeader) + header.length);
+
+    if (position < segment->tail) {
+        return make_log_offset(id, static_cast<uint32_t>(position));
+    }
+
+    return id == segments_.back().id ? end_offset()
+                                     : make_log_offset(id + 1, 0);
+}
+
+LogOffset MessageLog::begin_offset() const {
+    return make_log_offset(segments_.front().id, 0);
+}
+
+LogOffset MessageLog::end_offset() const {
+    return make_log_offset(segments_.back().id,
+            static_cast<uint32_t>(segments_.back().tail));
+}
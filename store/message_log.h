@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <vector>
+
+enum class LogError {
+    Io,
+    Corrupted,
+    RecordTooLarge,
+    InvalidOptions,
+};
+
+/// position of a record in the log: the segment id in the upper 32 bits and
+/// the byte offset inside that segment in the lower 32 bits. offsets grow
+/// monotonically with every append.
+using LogOffset = uint64_t;
+
+constexpr LogOffset make_log_offset(uint32_t segment, uint32_t position) {
+    return (static_cast<uint64_t>(segment) << 32) | position;
+}
+
+constexpr uint32_t log_offset_segment(LogOffset offset) {
+    return static_cast<uint32_t>(offset >> 32);
+}
+
+constexpr uint32_t log_offset_position(LogOffset offset) {
+    return static_cast<uint32_t>(offset);
+}
+
+struct MessageLogOptions {
+    /// size every segment file is preallocated (and mapped) to. at most
+    /// UINT32_MAX, a LogOffset keeps 32 bits of position.
+    size_t segment_size = size_t{64} << 20;
+    /// appends are flushed to disk together once this many are pending
+    size_t group_commit_records = 64;
+    /// ... or once this many bytes are pending, whichever comes first
+    size_t group_commit_bytes = size_t{1} << 20;
+};
+
+struct LogRecord {
+    LogOffset offset;
+    /// points straight into the mapping, valid while the log is alive
+    std::span<uint8_t const> data;
+};
+
+/// a segmented, memory-mapped, append-only record log.
+///
+/// every segment is a preallocated file mapped in full. records are written
+/// into the mapping and become durable on commit(), which msyncs everything
+/// appended since the previous commit and then persists a checkpoint of the
+/// committed end. on open, only the records past the checkpoint have their
+/// checksums re-validated; the first bad record marks the torn tail and
+/// everything after it is discarded.
+class MessageLog {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = LogRecord;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+        Iterator(MessageLog const *log, LogOffset offset)
+            : log_{log}, offset_{offset} {}
+
+        LogRecord operator*() const {
+            return {offset_, log_->read(offset_).value()};
+        }
+
+        Iterator &operator++() {
+            offset_ = log_->next(offset_);
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(Iterator const &other) const {
+            return offset_ == other.offset_;
+        }
+
+    private:
+        MessageLog const *log_ = nullptr;
+        LogOffset offset_ = 0;
+    };
+
+    static std::expected<MessageLog, LogError> open(
+            std::filesystem::path const &directory,
+            MessageLogOptions const &options = {});
+
+    MessageLog(MessageLog &&other) noexcept;
+    MessageLog &operator=(MessageLog &&other) noexcept;
+    MessageLog(MessageLog const &) = delete;
+    ~MessageLog();
+
+    std::expected<LogOffset, LogError> append(std::span<uint8_t const> record);
+
+    /// flushes all pending appends and advances the checkpoint
+    std::expected<void, LogError> commit();
+
+    /// deletes every segment before `segment`, never the one appended to.
+    /// records in them must not be read anymore.
+    std::expected<void, LogError> drop_segments_before(uint32_t segment);
+
+    uint32_t first_segment() const { return segments_.front().id; }
+    uint32_t active_segment() const { return segments_.back().id; }
+
+    std::optional<std::span<uint8_t const>> read(LogOffset offset) const;
+
+    /// offset of the record following the one at `offset`, or end_offset()
+    LogOffset next(LogOffset offset) const;
+
+    LogOffset begin_offset() const;
+    LogOffset end_offset() const;
+
+    Iterator begin() const { return {this, begin_offset()}; }
+    Iterator end() const { return {this, end_offset()}; }
+
+    size_t record_count() const { return record_count_; }
+    size_t pending_records() const { return pending_records_; }
+
+private:
+    struct Segment {
+        uint32_t id;
+        int fd;
+        uint8_t *base;
+        size_t capacity;
+        size_t tail;
+        size_t records;
+    };
+
+    MessageLog(std::filesystem::path directory, MessageLogOptions options)
+        : directory_{std::move(directory)}, options_{options} {}
+
+    std::expected<void, LogError> recover();
+    std::expected<void, LogError> create_segment(uint32_t id);
+    std::expected<void, LogError> write_checkpoint();
+    Segment const *segment(uint32_t id) const;
+    void close();
+
+    std::filesystem::path directory_;
+    MessageLogOptions options_;
+    int directory_fd_ = -1;
+    std::vector<Segment> segments_;
+    size_t record_count_ = 0;
+    size_t pending_records_ = 0;
+    size_t pending_bytes_ = 0;
+    /// first segment with appends that have not been msynced yet, and the
+    /// position inside it where they start
+    uint32_t dirty_segment_ = 0;
+    size_t dirty_position_ = 0;
+    bool directory_dirty_ = false;
+};
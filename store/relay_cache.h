@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "store/frequency_sketch.h"
+
+struct RelayCacheOptions {
+    /// bound on the summed size of all entries, pinned ones included
+    uint64_t max_bytes = uint64_t{256} << 20;
+    /// bound on the number of entries, pinned ones included
+    size_t max_count = 100000;
+    /// share of the evictable capacity given to the admission window
+    double window_ratio = 0.01;
+    /// share of the main space reserved for entries accessed twice
+    double protected_ratio = 0.8;
+};
+
+struct RelayCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    /// window victims that won admission into the main space
+    uint64_t admissions = 0;
+    /// window victims that lost against the main space's victim
+    uint64_t rejections = 0;
+    uint64_t evictions = 0;
+    uint64_t expirations = 0;
+
+    uint64_t bytes = 0;
+    size_t count = 0;
+    uint64_t pinned_bytes = 0;
+    size_t pinned_count = 0;
+
+    double hit_rate() const {
+        uint64_t accesses = hits + misses;
+        return accesses == 0 ? 0.0
+                             : static_cast<double>(hits)
+                        / static_cast<double>(accesses);
+    }
+};
+
+/// the replacement policy for store-and-forward messages: W-TinyLFU with
+/// per-entry expiry and pinning.
+///
+/// new entries go into a small LRU window. whatever falls out of the window
+/// only makes it into the main space (a segmented LRU) if a frequency
+/// sketch says it is accessed more often than the entry it would push out,
+/// which keeps one-off floods of relayed messages from flushing the popular
+/// ones. pinned entries are never evicted or expired but are accounted for.
+///
+/// the cache only tracks keys and sizes; the caller stores the values and
+/// drops them when insert() or expire() hand back evicted entries.
+template<typename Key, typename Hash = std::hash<Key>>
+class RelayCache {
+public:
+    struct Entry {
+        Key key;
+        uint64_t size;
+        /// the entry is dropped by expire() from this time on
+        uint64_t expires_at;
+        bool pinned;
+    };
+
+    explicit RelayCache(RelayCacheOptions const &options)
+        : options_{options}, sketch_{options.max_count} {}
+
+    /// adds `entry` and returns what was evicted to make room, which can be
+    /// the entry itself if it lost admission
+    std::vector<Entry> insert(Entry const &entry) {
+        std::vector<Entry> evicted;
+
+        if (nodes_.contains(entry.key)) {
+            access(entry.key);
+            return evicted;
+        }
+
+        sketch_.increment(hash_(entry.key));
+
+        Region region = entry.pinned ? Region::Pinned : Region::Window;
+        add(entry, region, list(region).begin());
+
+        if (!entry.pinned) {
+            by_expiry_.emplace(entry.expires_at, entry.key);
+        }
+
+        drain_window(evicted);
+        fit(evicted);
+
+        return evicted;
+    }
+
+    /// records an access, false if the key is not cached
+    bool access(Key const &key) {
+        sketch_.increment(hash_(key));
+
+        auto it = nodes_.find(key);
+        if (it == nodes_.end()) {
+            stats_.misses++;
+            return false;
+        }
+        stats_.hits++;
+
+        auto node = it->second;
+        switch (node->region) {
+        case Region::Window:
+            window_.splice(window_.begin(), window_, node);
+            break;
+        case Region::Probation:
+            move(node, Region::Protected, protected_.begin());
+            while (usage(Region::Protected).bytes > protected_max_bytes()
+                    && protected_.size() > 1) {
+                move(std::prev(protected_.end()),
+                        Region::Probation,
+                        probation_.begin());
+            }
+            break;
+        case Region::Protected:
+            protected_.splice(protected_.begin(), protected_, node);
+            break;
+        case Region::Pinned:
+            break;
+        }
+
+        return true;
+    }
+
+    bool contains(Key const &key) const { return nodes_.contains(key); }
+
+    /// drops `key` without counting it as an eviction
+    bool erase(Key const &key) {
+        auto it = nodes_.find(key);
+        if (it == nodes_.end()) {
+            return false;
+        }
+
+        remove(it->second);
+        return true;
+    }
+
+    /// drops every unpinned entry that expires at or before `now`
+    std::vector<Entry> expire(uint64_t now) {
+        std::vector<Entry> expired;
+
+        while (!by_expiry_.empty() && by_expiry_.begin()->first <= now) {
+            auto node = nodes_.at(by_expiry_.begin()->second);
+            expired.push_back(node->entry);
+            remove(node);
+            stats_.expirations++;
+        }
+
+        return expired;
+    }
+
+    RelayCacheStats const &stats() const { return stats_; }
+
+private:
+    enum class Region : uint8_t {
+        Window,
+        Probation,
+        Protected,
+        Pinned,
+    };
+
+    struct Node {
+        Entry entry;
+        Region region;
+    };
+
+    using NodeList = std::list<Node>;
+
+    struct Usage {
+        uint64_t bytes = 0;
+        size_t count = 0;
+    };
+
+    RelayCacheOptions options_;
+    FrequencySketch sketch_;
+    Hash hash_{};
+    RelayCacheStats stats_;
+
+    /// most recently used at the front
+    NodeList window_;
+    NodeList probation_;
+    NodeList protected_;
+    NodeList pinned_;
+    std::array<Usage, 4> usage_{};
+
+    std::unordered_map<Key, typename NodeList::iterator, Hash> nodes_;
+    std::set<std::pair<uint64_t, Key>> by_expiry_;
+
+    NodeList &list(Region region) {
+        switch (region) {
+        case Region::Window:
+            return window_;
+        case Region::Probation:
+            return probation_;
+        case Region::Protected:
+            return protected_;
+        case Region::Pinned:
+            break;
+        }
+        return pinned_;
+    }
+
+    Usage &usage(Region region) {
+        return usage_[static_cast<size_t>(region)];
+    }
+
+    uint64_t evictable_max_bytes() const {
+        uint64_t pinned = usage_[static_cast<size_t>(Region::Pinned)].bytes;
+        return options_.max_bytes > pinned ? options_.max_bytes - pinned : 0;
+    }
+
+    size_t evictable_max_count() const {
+        size_t pinned = usage_[static_cast<size_t>(Region::Pinned)].count;
+        return options_.max_count > pinned ? options_.max_count - pinned : 0;
+    }
+
+    uint64_t window_max_bytes() const {
+        return static_cast<uint64_t>(
+                static_cast<double>(evictable_max_bytes())
+                * options_.window_ratio);
+    }
+
+    size_t window_max_count() const {
+        return std::max<size_t>(1,
+                static_cast<size_t>(static_cast<double>(evictable_max_count())
+                        * options_.window_ratio));
+    }
+
+    uint64_t main_max_bytes() const {
+        return evictable_max_bytes() - window_max_bytes();
+    }
+
+    size_t main_max_count() const {
+        size_t evictable = evictable_max_count();
+        return evictable > window_max_count() ? evictable - window_max_count()
+                                              : 0;
+    }
+
+    uint64_t protected_max_bytes() const {
+        return static_cast<uint64_t>(static_cast<double>(main_max_bytes())
+                * options_.protected_ratio);
+    }
+
+    Usage main_usage() {
+        return {usage(Region::Probation).bytes
+                        + usage(Region::Protected).bytes,
+                usage(Region::Probation).count
+                        + usage(Region::Protected).count};
+    }
+
+    void add(Entry const &entry,
+            Region region,
+            typename NodeList::iterator position) {
+        auto node = list(region).insert(position, Node{entry, region});
+        nodes_[entry.key] = node;
+
+        usage(region).bytes += entry.size;
+        usage(region).count++;
+        stats_.bytes += entry.size;
+        stats_.count++;
+        if (region == Region::Pinned) {
+            stats_.pinned_bytes += entry.size;
+            stats_.pinned_count++;
+        }
+    }
+
+    void remove(typename NodeList::iterator node) {
+        Entry const &entry = node->entry;
+
+        usage(node->region).bytes -= entry.size;
+        usage(node->region).count--;
+        stats_.bytes -= entry.size;
+        stats_.count--;
+        if (node->region == Region::Pinned) {
+            stats_.pinned_bytes -= entry.size;
+            stats_.pinned_count--;
+        } else {
+            by_expiry_.erase({entry.expires_at, entry.key});
+        }
+
+        nodes_.erase(entry.key);
+        list(node->region).erase(node);
+    }
+
+    void evict(typename NodeList::iterator node, std::vector<Entry> &evicted) {
+        evicted.push_back(node->entry);
+        remove(node);
+        stats_.evictions++;
+    }
+
+    void move(typename NodeList::iterator node,
+            Region region,
+            typename NodeList::iterator position) {
+        usage(node->region).bytes -= node->entry.size;
+        usage(node->region).count--;
+        usage(region).bytes += node->entry.size;
+        usage(region).count++;
+
+        list(region).splice(position, list(node->region), node);
+        node->region = region;
+    }
+
+    /// the main space's least valuable entry
+    std::optional<typename NodeList::iterator> main_victim() {
+        if (!probation_.empty()) {
+            return std::prev(probation_.end());
+        }
+        if (!protected_.empty()) {
+            return std::prev(protected_.end());
+        }
+
+        return std::nullopt;
+    }
+
+    /// moves whatever overflows the window into the main space, if it wins
+    /// against the entries it would replace
+    void drain_window(std::vector<Entry> &evicted) {
+        while (!window_.empty()
+                && (usage(Region::Window).bytes > window_max_bytes()
+                        || usage(Region::Window).count > window_max_count())) {
+            auto candidate = std::prev(window_.end());
+            uint8_t frequency = sketch_.frequency(hash_(candidate->entry.key));
+
+            bool admitted = true;
+            while (main_usage().bytes + candidate->entry.size > main_max_bytes()
+                    || main_usage().count + 1 > main_max_count()) {
+                auto victim = main_victim();
+                if (!victim.has_value()
+                        || frequency <= sketch_.frequency(
+                                   hash_(victim.value()->entry.key))) {
+                    admitted = false;
+                    break;
+                }
+
+                evict(victim.value(), evicted);
+            }
+
+            if (admitted) {
+                move(candidate, Region::Probation, probation_.begin());
+                stats_.admissions++;
+            } else {
+                evict(candidate, evicted);
+                stats_.rejections++;
+            }
+        }
+    }
+
+    /// makes room when pinned entries ate into the evictable space
+    void fit(std::vector<Entry> &evicted) {
+        while (stats_.bytes > options_.max_bytes
+                || stats_.count > options_.max_count) {
+            if (auto victim = main_victim()) {
+                evict(victim.value(), evicted);
+            } else if (!window_.empty()) {
+                evict(std::prev(window_.end()), evicted);
+            } else {
+                break;
+            }
+        }
+    }
+};
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "message_index.h"
+
+namespace {
+
+RecipientKey key_of(uint8_t i) {
+    RecipientKey key{};
+    key.fill(i);
+    return key;
+}
+
+std::vector<IndexEntry> entries(MessageIndex::Range range) {
+    return {range.begin(), range.end()};
+}
+
+} // namespace
+
+TEST_CASE("MessageIndex") {
+    MessageIndex index;
+
+    RecipientKey alice = key_of(1);
+    RecipientKey bob = key_of(2);
+    std::vector<RecipientKey> both{alice, bob};
+
+    // out of timestamp order on purpose
+    index.insert({.timestamp = 30, .offset = 1}, std::span{&alice, 1});
+    index.insert({.timestamp = 10, .offset = 2}, both);
+    index.insert({.timestamp = 20, .offset = 3}, std::span{&bob, 1});
+    index.insert({.timestamp = 40, .offset = 4}, {});
+
+    SUBCASE("By timestamp") {
+        auto all = entries(index.since(0));
+        REQUIRE_EQ(all.size(), 4);
+        CHECK_EQ(all[0].offset, 2);
+        CHECK_EQ(all[1].offset, 3);
+        CHECK_EQ(all[2].offset, 1);
+        CHECK_EQ(all[3].offset, 4);
+
+        CHECK_EQ(entries(index.since(21)).size(), 2);
+        CHECK(index.since(41).empty());
+    }
+
+    SUBCASE("By recipient") {
+        auto for_alice = entries(index.for_recipient(alice, 0));
+        REQUIRE_EQ(for_alice.size(), 2);
+        CHECK_EQ(for_alice[0].offset, 2);
+        CHECK_EQ(for_alice[1].offset, 1);
+
+        auto for_bob = entries(index.for_recipient(bob, 15));
+        REQUIRE_EQ(for_bob.size(), 1);
+        CHECK_EQ(for_bob[0].offset, 3);
+
+        CHECK(index.for_recipient(key_of(3), 0).empty());
+    }
+
+    SUBCASE("Erase") {
+        index.erase({.timestamp = 10, .offset = 2}, both);
+
+        CHECK_EQ(index.size(), 3);
+        CHECK_EQ(entries(index.for_recipient(alice, 0)).size(), 1);
+        CHECK_EQ(entries(index.for_recipient(bob, 0)).size(), 1);
+    }
+
+    SUBCASE("Stays ordered under churn") {
+        // late messages land in the middle, evictions leave holes
+        std::vector<IndexEntry> expected = entries(index.since(0));
+        for (uint64_t i = 0; i < 1000; ++i) {
+            IndexEntry entry{.timestamp = (i * 7919) % 1000, .offset = 100 + i};
+            index.insert(entry, std::span{&alice, 1});
+            expected.push_back(entry);
+        }
+        for (uint64_t i = 0; i < 1000; i += 2) {
+            IndexEntry entry{.timestamp = (i * 7919) % 1000, .offset = 100 + i};
+            index.erase(entry, std::span{&alice, 1});
+            std::erase(expected, entry);
+        }
+        std::ranges::sort(expected);
+
+        CHECK_EQ(entries(index.since(0)), expected);
+        CHECK_EQ(entries(index.for_recipient(alice, 0)).size(), 500 + 2);
+    }
+}
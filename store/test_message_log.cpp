@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "message_log.h"
+
+namespace {
+
+std::filesystem::path fresh_directory(std::string const &name) {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(path);
+    return path;
+}
+
+std::vector<uint8_t> record_bytes(size_t i) {
+    return std::vector<uint8_t>(1 + i % 37, static_cast<uint8_t>(i));
+}
+
+} // namespace
+
+TEST_CASE("MessageLog append/read") {
+    auto directory = fresh_directory("hrafn_test_log_basic");
+    auto log = MessageLog::open(directory).value();
+
+    std::vector<LogOffset> offsets;
+    for (size_t i = 0; i < 100; ++i) {
+        offsets.push_back(log.append(record_bytes(i)).value());
+    }
+
+    CHECK_EQ(log.record_count(), 100);
+
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        auto data = log.read(offsets[i]);
+        REQUIRE(data.has_value());
+        CHECK(std::ranges::equal(data.value(), record_bytes(i)));
+    }
+
+    size_t i = 0;
+    for (LogRecord record : log) {
+        CHECK_EQ(record.offset, offsets[i]);
+        CHECK(std::ranges::equal(record.data, record_bytes(i)));
+        i++;
+    }
+    CHECK_EQ(i, 100);
+
+    SUBCASE("Empty record") {
+        CHECK(!log.append({}).has_value());
+    }
+}
+
+TEST_CASE("MessageLog segment rollover") {
+    auto directory = fresh_directory("hrafn_test_log_rollover");
+    auto log = MessageLog::open(directory, {.segment_size = 4096}).value();
+
+    std::vector<uint8_t> big(1000, 0xab);
+    for (size_t i = 0; i < 20; ++i) {
+        CHECK(log.append(big).has_value());
+    }
+
+    CHECK_GT(log_offset_segment(log.end_offset()), 0);
+    CHECK_EQ(std::distance(log.begin(), log.end()), 20);
+
+    std::vector<uint8_t> too_big(8192, 0);
+    CHECK_EQ(log.append(too_big).error(), LogError::RecordTooLarge);
+
+    SUBCASE("Dropping old segments") {
+        uint32_t active = log.active_segment();
+        CHECK(log.drop_segments_before(active + 1).has_value());
+
+        // the active segment stays
+        CHECK_EQ(log.first_segment(), active);
+        CHECK_EQ(log.record_count(),
+                static_cast<size_t>(std::distance(log.begin(), log.end())));
+        CHECK(log.append(big).has_value());
+
+        auto reopened =
+                MessageLog::open(directory, {.segment_size = 4096});
+        log = std::move(reopened.value());
+        CHECK_EQ(log.first_segment(), active);
+    }
+}
+
+TEST_CASE("MessageLog segments are backed by disk") {
+    auto directory = fresh_directory("hrafn_test_log_allocated");
+    auto log = MessageLog::open(directory, {.segment_size = 1 << 16}).value();
+
+    // not sparse, so a full disk fails the append instead of the store
+    size_t segments = 0;
+    for (auto const &entry : std::filesystem::directory_iterator(directory)) {
+        struct stat st {};
+        if (::stat(entry.path().c_str(), &st) != 0 || st.st_size != 1 << 16) {
+            continue;
+        }
+
+        CHECK_GE(st.st_blocks * 512, st.st_size);
+        segments++;
+    }
+    CHECK_EQ(segments, 1);
+
+    // a LogOffset has 32 bits of position
+    auto huge = MessageLog::open(fresh_directory("hrafn_test_log_huge"),
+            {.segment_size = size_t{1} << 32});
+    CHECK_EQ(huge.error(), LogError::InvalidOptions);
+}
+
+TEST_CASE("MessageLog persistence") {
+    auto directory = fresh_directory("hrafn_test_log_reopen");
+    MessageLogOptions options{.segment_size = 4096, .group_commit_records = 8};
+
+    {
+        auto log = MessageLog::open(directory, options).value();
+        for (size_t i = 0; i < 50; ++i) {
+            CHECK(log.append(record_bytes(i)).has_value());
+        }
+    }
+
+    auto log = MessageLog::open(directory, options).value();
+    CHECK_EQ(log.record_count(), 50);
+
+    size_t i = 0;
+    for (LogRecord record : log) {
+        CHECK(std::ranges::equal(record.data, record_bytes(i)));
+        i++;
+    }
+    CHECK_EQ(i, 50);
+}
+
+TEST_CASE("MessageLog drops a torn tail") {
+    auto directory = fresh_directory("hrafn_test_log_torn");
+    LogOffset last = 0;
+
+    {
+        auto log = MessageLog::open(directory).value();
+        for (size_t i = 0; i < 10; ++i) {
+            log.append(record_bytes(i)).value();
+        }
+        CHECK(log.commit().has_value());
+
+        for (size_t i = 10; i < 15; ++i) {
+            last = log.append(record_bytes(i)).value();
+        }
+    }
+
+    // simulate a crash before the last appends were checkpointed: without a
+    // checkpoint everything is re-validated, and the flipped byte in the
+    // last record has to be detected
+    std::filesystem::remove(directory / "CHECKPOINT");
+    {
+        std::FILE *file =
+                std::fopen((directory / "00000000.seg").c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        std::fseek(file, static_cast<long>(log_offset_position(last) + 16), 0);
+        std::fputc(0xff, file);
+        std::fclose(file);
+    }
+
+    auto log = MessageLog::open(directory).value();
+    CHECK_EQ(log.record_count(), 14);
+    CHECK_EQ(log.end_offset(), last);
+
+    CHECK(log.append(record_bytes(99)).has_value());
+    CHECK_EQ(log.record_count(), 15);
+}
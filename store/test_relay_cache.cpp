@@ -0,0 +1,105 @@
+#include <cstdint>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "relay_cache.h"
+
+using Cache = RelayCache<uint64_t>;
+
+namespace {
+
+Cache::Entry entry(uint64_t key, uint64_t size = 100, bool pinned = false) {
+    return {.key = key, .size = size, .expires_at = 1000 + key, .pinned = pinned};
+}
+
+} // namespace
+
+TEST_CASE("RelayCache bounds") {
+    Cache cache{{.max_bytes = 1 << 20, .max_count = 100}};
+
+    size_t evicted = 0;
+    for (uint64_t key = 0; key < 1000; ++key) {
+        evicted += cache.insert(entry(key)).size();
+    }
+
+    CHECK_EQ(cache.stats().count, 100);
+    CHECK_EQ(cache.stats().bytes, 100 * 100);
+    CHECK_EQ(evicted, 900);
+
+    SUBCASE("Bytes") {
+        Cache small{{.max_bytes = 10000, .max_count = 1000}};
+        for (uint64_t key = 0; key < 1000; ++key) {
+            small.insert(entry(key, 1 + key % 300));
+        }
+
+        CHECK_LE(small.stats().bytes, 10000);
+    }
+}
+
+TEST_CASE("RelayCache keeps frequently accessed entries") {
+    Cache cache{{.max_bytes = 1 << 20, .max_count = 100}};
+
+    for (uint64_t key = 0; key < 50; ++key) {
+        cache.insert(entry(key));
+        for (size_t i = 0; i < 5; ++i) {
+            cache.access(key);
+        }
+    }
+
+    // a flood of messages that are seen once
+    for (uint64_t key = 1000; key < 1600; ++key) {
+        cache.insert(entry(key));
+    }
+
+    size_t kept = 0;
+    for (uint64_t key = 0; key < 50; ++key) {
+        kept += cache.contains(key) ? 1 : 0;
+    }
+
+    CHECK_GE(kept, 45);
+    CHECK_GT(cache.stats().rejections, 0);
+    CHECK_GT(cache.stats().hit_rate(), 0.0);
+}
+
+TEST_CASE("RelayCache pinning") {
+    Cache cache{{.max_bytes = 1 << 20, .max_count = 10}};
+
+    for (uint64_t key = 0; key < 5; ++key) {
+        cache.insert(entry(key, 100, true));
+    }
+    for (uint64_t key = 100; key < 200; ++key) {
+        cache.insert(entry(key));
+    }
+
+    for (uint64_t key = 0; key < 5; ++key) {
+        CHECK(cache.contains(key));
+    }
+    CHECK_EQ(cache.stats().count, 10);
+    CHECK_EQ(cache.stats().pinned_count, 5);
+    CHECK_EQ(cache.stats().pinned_bytes, 500);
+
+    // pinned entries don't expire either
+    cache.expire(UINT64_MAX);
+    CHECK_EQ(cache.stats().count, 5);
+}
+
+TEST_CASE("RelayCache expiry") {
+    Cache cache{{.max_bytes = 1 << 20, .max_count = 100}};
+
+    for (uint64_t key = 0; key < 10; ++key) {
+        cache.insert(entry(key));
+    }
+
+    std::vector<Cache::Entry> expired = cache.expire(1004);
+    CHECK_EQ(expired.size(), 5);
+    CHECK_EQ(cache.stats().expirations, 5);
+    CHECK(!cache.contains(4));
+    CHECK(cache.contains(5));
+
+    CHECK(!cache.access(4));
+    CHECK(cache.access(5));
+    CHECK_EQ(cache.stats().misses, 1);
+    CHECK_EQ(cache.stats().hits, 1);
+}
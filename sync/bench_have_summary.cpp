@@ -0,0 +1,72 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <absl/strings/str_format.h>
+
+#include "sync/have_summary.h"
+#include "utils/bench.h"
+
+namespace {
+
+constexpr size_t kMessages = 10000;
+constexpr size_t kMessageSize = 256;
+// rough size of a serialized MessageHeader sent in front of every message
+constexpr size_t kHeaderSize = 48;
+
+MessageId id_of(uint64_t i) {
+    std::span<uint8_t const> bytes{
+            reinterpret_cast<uint8_t const *>(&i), sizeof(i)};
+    return message_id(bytes);
+}
+
+} // namespace
+
+int main() {
+    bench::Runner runner;
+
+    std::vector<MessageId> sender;
+    for (uint64_t i = 0; i < kMessages; ++i) {
+        sender.push_back(id_of(i));
+    }
+
+    for (double overlap : {0.0, 0.25, 0.5, 0.75, 0.9, 0.99, 1.0}) {
+        auto held = static_cast<size_t>(overlap * kMessages);
+        std::vector<MessageId> receiver{sender.begin(), sender.begin() + held};
+
+        HaveSummary summary = HaveSummary::from_ids(receiver);
+        size_t summary_bytes = summary.serialize().size();
+
+        size_t sent = 0;
+        size_t missed = 0;
+        for (size_t i = 0; i < sender.size(); ++i) {
+            if (!summary.might_have(sender[i])) {
+                sent++;
+            } else if (i >= held) {
+                missed++;
+            }
+        }
+
+        size_t per_message = kHeaderSize + kMessageSize;
+        runner.record(absl::StrFormat("have_summary/overlap:%.2f", overlap),
+                {
+                        {"blind_bytes",
+                                static_cast<double>(kMessages * per_message)},
+                        {"summary_bytes", static_cast<double>(summary_bytes)},
+                        {"wire_bytes",
+                                static_cast<double>(
+                                        summary_bytes + sent * per_message)},
+                        {"messages_sent", static_cast<double>(sent)},
+                        {"messages_missed", static_cast<double>(missed)},
+                });
+    }
+
+    runner.run("have_summary/build/10000",
+            [&] { bench::do_not_optimize(HaveSummary::from_ids(sender)); });
+
+    HaveSummary summary = HaveSummary::from_ids(sender);
+    size_t i = 0;
+    runner.run("have_summary/might_have", [&] {
+        bench::do_not_optimize(summary.might_have(sender[i++ % kMessages]));
+    });
+}
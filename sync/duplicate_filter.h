@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+
+#include "sync/message_id.h"
+#include "utils/bloom_filter.h"
+
+struct DuplicateFilterStats {
+    /// message headers checked
+    uint64_t messages = 0;
+    /// messages dropped on their header as already seen
+    uint64_t duplicates = 0;
+    /// body bytes of those, skipped unread
+    uint64_t duplicate_bytes = 0;
+    /// filter hits on messages we turned out not to hold, read in full
+    uint64_t false_positives = 0;
+
+    double duplicate_rate() const {
+        return messages == 0 ? 0.0
+                             : static_cast<double>(duplicates)
+                        / static_cast<double>(messages);
+    }
+};
+
+/// the messages received lately, so that one arriving again over another
+/// path is dropped on its header, before its body is read, hashed or
+/// verified.
+///
+/// an id is only remembered once its message was verified and stored, so
+/// a peer cannot get a message skipped by announcing its id first. a hit
+/// only counts once the store confirms it holds the message, so a false
+/// positive costs reading the body, never the message.
+class DuplicateFilter {
+public:
+    using Clock = AgingBloomFilter::Clock;
+
+    explicit DuplicateFilter(AgingBloomFilterOptions const &options = {},
+            Clock::time_point now = Clock::now())
+        : seen_{options, now} {}
+
+    /// whether the message a header announces was seen before. `held` is
+    /// asked on a filter hit whether the store has the message. `size` is
+    /// its body's, for the stats.
+    template<std::predicate<MessageId const &> Held>
+    bool seen(MessageId const &id,
+            uint64_t size,
+            Clock::time_point now,
+            Held &&held) {
+        stats_.messages++;
+        if (!seen_.might_contain(id, now)) {
+            return false;
+        }
+
+        if (!std::invoke(held, id)) {
+            stats_.false_positives++;
+            return false;
+        }
+
+        stats_.duplicates++;
+        stats_.duplicate_bytes += size;
+        return true;
+    }
+
+    void remember(MessageId const &id, Clock::time_point now) {
+        seen_.put(id, now);
+    }
+
+    DuplicateFilterStats const &stats() const { return stats_; }
+
+private:
+    AgingBloomFilter seen_;
+    DuplicateFilterStats stats_;
+};
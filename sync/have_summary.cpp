@@ -0,0 +1,19 @@
+#include "sync/have_summary.h"
+#include "utils/error_utils.h"
+
+HaveSummary HaveSummary::from_ids(
+        std::span<MessageId const> ids, double fpr) {
+    HaveSummary summary{ids.size(), fpr};
+    for (MessageId const &id : ids) {
+        summary.add(id);
+    }
+
+    return summary;
+}
+
+std::optional<HaveSummary> HaveSummary::deserialize(
+        std::span<uint8_t const> bytes) {
+    BlockedBloomFilter filter =
+            try_unwrap_optional(BlockedBloomFilter::deserialize(bytes));
+    return HaveSummary{std::move(filter)};
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "sync/message_id.h"
+#include "utils/bloom_filter.h"
+
+constexpr double kHaveSummaryFpr = 0.01;
+
+/// a compact, probabilistic summary of the message ids a node holds.
+///
+/// a peer sends its summary at the start of a sync and only gets the
+/// messages the summary does not (probably) contain back. a false positive
+/// means a message the peer is missing is skipped for this round; every
+/// summary is built under a new seed, so it is picked up by a later sync.
+class HaveSummary {
+public:
+    explicit HaveSummary(size_t expected, double fpr = kHaveSummaryFpr)
+        : filter_{Options{.n = std::max<size_t>(expected, 1), .fpr = fpr},
+                  BlockedBloomFilter::random_seed()} {}
+
+    static HaveSummary from_ids(
+            std::span<MessageId const> ids, double fpr = kHaveSummaryFpr);
+
+    static std::optional<HaveSummary> deserialize(
+            std::span<uint8_t const> bytes);
+
+    void add(MessageId const &id) { filter_.put(id); }
+
+    bool might_have(MessageId const &id) const {
+        return filter_.might_contain(id);
+    }
+
+    std::vector<uint8_t> serialize() const { return filter_.serialize(); }
+
+private:
+    explicit HaveSummary(BlockedBloomFilter filter)
+        : filter_{std::move(filter)} {}
+
+    BlockedBloomFilter filter_;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include <sodium.h>
+
+constexpr size_t kMessageIdSize = crypto_generichash_BYTES_MIN;
+
+/// identifies a message across the mesh: a BLAKE2b digest of its data
+using MessageId = std::array<uint8_t, kMessageIdSize>;
+
+inline MessageId message_id(std::span<uint8_t const> data) {
+    MessageId id{};
+    crypto_generichash(
+            id.data(), id.size(), data.data(), data.size(), nullptr, 0);
+    return id;
+}
+
+/// keyed with a per-process secret so peers can't pick ids that collide in
+/// our hash tables
+struct MessageIdHash {
+    size_t operator()(MessageId const &id) const {
+        static auto const key = [] {
+            std::array<uint8_t, crypto_shorthash_KEYBYTES> key{};
+            crypto_shorthash_keygen(key.data());
+            return key;
+        }();
+
+        std::array<uint8_t, crypto_shorthash_BYTES> hash{};
+        crypto_shorthash(hash.data(), id.data(), id.size(), key.data());
+
+        size_t value = 0;
+        std::memcpy(&value, hash.data(), sizeof(value));
+        return value;
+    }
+};
+
+inline std::optional<MessageId> message_id_from_stringbytes(
+        std::string_view stringbytes) {
+    if (stringbytes.size() != kMessageIdSize) {
+        return std::nullopt;
+    }
+
+    MessageId id{};
+    std::copy(stringbytes.begin(), stringbytes.end(), id.begin());
+    return id;
+}
@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <utility>
+
+#include "sync/range_reconciler.h"
+#include "utils/error_utils.h"
+#include "utils/varint.h"
+
+namespace {
+
+class Writer {
+public:
+    void varuint(uint64_t value) {
+        std::array<uint8_t, kMaxVaruintSize> encoded{};
+        size_t size = encode_varuint(value, encoded);
+        bytes_.insert(bytes_.end(), encoded.begin(), encoded.begin() + size);
+    }
+
+    void id(std::array<uint8_t, kMessageIdSize> const &id) {
+        bytes_.insert(bytes_.end(), id.begin(), id.end());
+    }
+
+    void node(RangeNode node) {
+        varuint(node.level);
+        varuint(node.index);
+    }
+
+    std::vector<uint8_t> take() { return std::move(bytes_); }
+
+private:
+    std::vector<uint8_t> bytes_;
+};
+
+class Reader {
+public:
+    explicit Reader(std::span<uint8_t const> bytes) : bytes_{bytes} {}
+
+    std::optional<uint64_t> varuint() {
+        auto [value, read] = try_unwrap_optional(decode_varuint(bytes_));
+        bytes_ = bytes_.subspan(read);
+        return value;
+    }
+
+    /// a count of elements that are at least `min_size` bytes each, so a
+    /// forged count can't make us reserve more than the message holds
+    std::optional<uint64_t> count(size_t min_size) {
+        uint64_t value = try_unwrap_optional(varuint());
+        if (value > bytes_.size() / min_size) {
+            return std::nullopt;
+        }
+
+        return value;
+    }
+
+    std::optional<std::array<uint8_t, kMessageIdSize>> id() {
+        if (bytes_.size() < kMessageIdSize) {
+            return std::nullopt;
+        }
+
+        std::array<uint8_t, kMessageIdSize> id{};
+        std::copy_n(bytes_.begin(), kMessageIdSize, id.begin());
+        bytes_ = bytes_.subspan(kMessageIdSize);
+        return id;
+    }
+
+    std::optional<uint8_t> level() {
+        uint64_t level = try_unwrap_optional(varuint());
+        if (level > RangeReconciler::kRootLevel) {
+            return std::nullopt;
+        }
+
+        return static_cast<uint8_t>(level);
+    }
+
+    std::optional<RangeNode> node() {
+        uint8_t level = try_unwrap_optional(this->level());
+        uint64_t index = try_unwrap_optional(varuint());
+        return RangeNode{level, index};
+    }
+
+    bool done() const { return bytes_.empty(); }
+
+private:
+    std::span<uint8_t const> bytes_;
+};
+
+void xor_into(RangeFingerprint &fingerprint, MessageId const &id) {
+    for (size_t i = 0; i < fingerprint.size(); ++i) {
+        fingerprint[i] ^= id[i];
+    }
+}
+
+} // namespace
+
+std::vector<uint8_t> ReconcileMessage::serialize() const {
+    Writer writer;
+
+    writer.varuint(fingerprints.size());
+    for (RangeFingerprints const &range : fingerprints) {
+        writer.node(range.parent);
+        writer.varuint(range.child_level);
+        writer.varuint(range.children.size());
+
+        // children are sent relative to the start of the parent's range,
+        // which keeps them to a byte or two
+        auto [first, _] =
+                RangeReconciler::descendants(range.parent, range.child_level);
+        for (RangeSummary const &child : range.children) {
+            writer.varuint(child.index - first);
+            writer.id(child.fingerprint);
+            writer.varuint(child.count);
+        }
+    }
+
+    writer.varuint(id_lists.size());
+    for (RangeIds const &range : id_lists) {
+        writer.node(range.node);
+        writer.varuint(range.ids.size());
+        for (MessageId const &id : range.ids) {
+            writer.id(id);
+        }
+    }
+
+    writer.varuint(need.size());
+    for (MessageId const &id : need) {
+        writer.id(id);
+    }
+
+    return writer.take();
+}
+
+std::optional<ReconcileMessage> ReconcileMessage::deserialize(
+        std::span<uint8_t const> bytes) {
+    Reader reader{bytes};
+    ReconcileMessage message;
+
+    uint64_t fingerprint_count = try_unwrap_optional(reader.count(3));
+    for (uint64_t i = 0; i < fingerprint_count; ++i) {
+        RangeFingerprints range{
+                .parent = try_unwrap_optional(reader.node()),
+                .child_level = try_unwrap_optional(reader.level()),
+                .children = {},
+        };
+        if (range.child_level >= range.parent.level) {
+            return std::nullopt;
+        }
+
+        auto [first, _] =
+                RangeReconciler::descendants(range.parent, range.child_level);
+        uint64_t children =
+                try_unwrap_optional(reader.count(kMessageIdSize + 2));
+        range.children.reserve(children);
+        for (uint64_t j = 0; j < children; ++j) {
+            range.children.push_back({
+                    .index = first + try_unwrap_optional(reader.varuint()),
+                    .fingerprint = try_unwrap_optional(reader.id()),
+                    .count = try_unwrap_optional(reader.varuint()),
+            });
+        }
+
+        message.fingerprints.push_back(std::move(range));
+    }
+
+    uint64_t id_list_count = try_unwrap_optional(reader.count(3));
+    for (uint64_t i = 0; i < id_list_count; ++i) {
+        RangeIds range{.node = try_unwrap_optional(reader.node()), .ids = {}};
+
+        uint64_t ids = try_unwrap_optional(reader.count(kMessageIdSize));
+        range.ids.reserve(ids);
+        for (uint64_t j = 0; j < ids; ++j) {
+            range.ids.push_back(try_unwrap_optional(reader.id()));
+        }
+
+        message.id_lists.push_back(std::move(range));
+    }
+
+    uint64_t need_count = try_unwrap_optional(reader.count(kMessageIdSize));
+    message.need.reserve(need_count);
+    for (uint64_t i = 0; i < need_count; ++i) {
+        message.need.push_back(try_unwrap_optional(reader.id()));
+    }
+
+    if (!reader.done()) {
+        return std::nullopt;
+    }
+
+    return message;
+}
+
+void RangeReconciler::insert(uint64_t timestamp, MessageId const &id) {
+    uint64_t bucket = timestamp >> kLeafShift;
+
+    for (uint8_t level = 0; level <= kRootLevel; ++level) {
+        Node &node = levels_[level][shift_right(bucket, level * kFanoutBits)];
+        xor_into(node.fingerprint, id);
+        node.count++;
+    }
+
+    leaf_ids_[bucket].push_back(id);
+}
+
+void RangeReconciler::erase(uint64_t timestamp, MessageId const &id) {
+    uint64_t bucket = timestamp >> kLeafShift;
+
+    auto leaf = leaf_ids_.find(bucket);
+    if (leaf == leaf_ids_.end()) {
+        return;
+    }
+
+    auto it = std::ranges::find(leaf->second, id);
+    if (it == leaf->second.end()) {
+        return;
+    }
+
+    leaf->second.erase(it);
+    if (leaf->second.empty()) {
+        leaf_ids_.erase(leaf);
+    }
+
+    for (uint8_t level = 0; level <= kRootLevel; ++level) {
+        auto &nodes = levels_[level];
+        auto node = nodes.find(shift_right(bucket, level * kFanoutBits));
+
+        // xor is its own inverse
+        xor_into(node->second.fingerprint, id);
+        if (--node->second.count == 0) {
+            nodes.erase(node);
+        }
+    }
+}
+
+uint64_t RangeReconciler::count(RangeNode node) const {
+    auto it = levels_[node.level].find(node.index);
+    return it == levels_[node.level].end() ? 0 : it->second.count;
+}
+
+std::pair<uint64_t, uint64_t> RangeReconciler::descendants(
+        RangeNode parent, uint8_t level) {
+    size_t shift = (parent.level - level) * kFanoutBits;
+    if (shift >= 64) {
+        return {0, UINT64_MAX};
+    }
+
+    uint64_t first = parent.index << shift;
+    uint64_t last = (parent.index + 1) << shift;
+
+    // the last range at a level can wrap around
+    return {first, last == 0 ? UINT64_MAX : last};
+}
+
+RangeFingerprints RangeReconciler::fingerprints_of(RangeNode parent) const {
+    auto nodes_at = [&](uint8_t level) {
+        auto [first, last] = descendants(parent, level);
+        return std::pair{levels_[level].lower_bound(first),
+                levels_[level].lower_bound(last)};
+    };
+
+    // skip as far down as the fingerprint budget allows, so the chains of
+    // single-child nodes near the root don't each cost a round trip
+    auto child_level = static_cast<uint8_t>(parent.level - 1);
+    while (child_level > 0) {
+        auto [begin, end] = nodes_at(child_level - 1);
+        if (static_cast<size_t>(std::distance(begin, end))
+                > kMaxFingerprints) {
+            break;
+        }
+        child_level--;
+    }
+
+    RangeFingerprints range{
+            .parent = parent,
+            .child_level = child_level,
+            .children = {},
+    };
+
+    auto [begin, end] = nodes_at(child_level);
+    for (auto it = begin; it != end; ++it) {
+        range.children.push_back({
+                .index = it->first,
+                .fingerprint = it->second.fingerprint,
+                .count = it->second.count,
+        });
+    }
+
+    return range;
+}
+
+RangeIds RangeReconciler::ids_of(RangeNode node) const {
+    RangeIds range{.node = node, .ids = {}};
+
+    auto [first, last] = descendants(node, 0);
+    for (auto it = leaf_ids_.lower_bound(first);
+            it != leaf_ids_.end() && it->first < last;
+            ++it) {
+        range.ids.insert(range.ids.end(), it->second.begin(), it->second.end());
+    }
+
+    return range;
+}
+
+void RangeReconciler::describe(
+        RangeNode node, ReconcileMessage &reply) const {
+    if (node.level == 0 || count(node) <= kIdListThreshold) {
+        reply.id_lists.push_back(ids_of(node));
+    } else {
+        reply.fingerprints.push_back(fingerprints_of(node));
+    }
+}
+
+ReconcileMessage RangeReconciler::initiate() const {
+    ReconcileMessage message;
+    describe(root(), message);
+    return message;
+}
+
+ReconcileStep RangeReconciler::process(ReconcileMessage const &message) const {
+    ReconcileStep step;
+
+    // a peer repeating a range gets it answered once
+    std::set<std::pair<RangeNode, uint8_t>> fingerprinted;
+    for (RangeFingerprints const &range : message.fingerprints) {
+        if (!fingerprinted.insert({range.parent, range.child_level}).second) {
+            continue;
+        }
+
+        auto [first, last] = descendants(range.parent, range.child_level);
+        auto const &ours = levels_[range.child_level];
+
+        std::vector<RangeSummary> theirs = range.children;
+        std::sort(theirs.begin(),
+                theirs.end(),
+                [](RangeSummary const &a, RangeSummary const &b) {
+                    return a.index < b.index;
+                });
+        auto repeated = std::unique(theirs.begin(),
+                theirs.end(),
+                [](RangeSummary const &a, RangeSummary const &b) {
+                    return a.index == b.index;
+                });
+        theirs.erase(repeated, theirs.end());
+
+        auto our_it = ours.lower_bound(first);
+        auto our_end = ours.lower_bound(last);
+        auto their_it = theirs.begin();
+
+        while (our_it != our_end || their_it != theirs.end()) {
+            bool take_ours = their_it == theirs.end()
+                    || (our_it != our_end && our_it->first < their_it->index);
+            bool take_theirs = our_it == our_end
+                    || (their_it != theirs.end()
+                            && their_it->index < our_it->first);
+
+            if (take_ours) {
+                // they have nothing in this range
+                RangeIds ids = ids_of({range.child_level, our_it->first});
+                step.to_send.insert(
+                        step.to_send.end(), ids.ids.begin(), ids.ids.end());
+                ++our_it;
+            } else if (take_theirs) {
+                // we have nothing in this range, an empty list says so
+                step.reply.id_lists.push_back(
+                        {{range.child_level, their_it->index}, {}});
+                ++their_it;
+            } else {
+                if (our_it->second.count != their_it->count
+                        || our_it->second.fingerprint
+                                != their_it->fingerprint) {
+                    describe({range.child_level, our_it->first}, step.reply);
+                }
+                ++our_it;
+                ++their_it;
+            }
+        }
+    }
+
+    std::set<RangeNode> listed;
+    for (RangeIds const &range : message.id_lists) {
+        if (!listed.insert(range.node).second) {
+            continue;
+        }
+
+        std::vector<MessageId> ours = ids_of(range.node).ids;
+        std::vector<MessageId> theirs = range.ids;
+        std::sort(ours.begin(), ours.end());
+        std::sort(theirs.begin(), theirs.end());
+        theirs.erase(std::unique(theirs.begin(), theirs.end()), theirs.end());
+
+        std::set_difference(ours.begin(),
+                ours.end(),
+                theirs.begin(),
+                theirs.end(),
+                std::back_inserter(step.to_send));
+        std::set_difference(theirs.begin(),
+                theirs.end(),
+                ours.begin(),
+                ours.end(),
+                std::back_inserter(step.reply.need));
+    }
+
+    std::vector<MessageId> need = message.need;
+    std::sort(need.begin(), need.end());
+    need.erase(std::unique(need.begin(), need.end()), need.end());
+    // the rest is asked for again on the next sync
+    need.resize(std::min(need.size(), kMaxNeed));
+    step.to_send.insert(step.to_send.end(), need.begin(), need.end());
+
+    // ranges may still overlap, e.g. a parent and its child. every message
+    // is sent at most once per step, however the peer repeats itself.
+    std::sort(step.to_send.begin(), step.to_send.end());
+    step.to_send.erase(std::unique(step.to_send.begin(), step.to_send.end()),
+            step.to_send.end());
+
+    return step;
+}
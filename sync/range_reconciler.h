@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "sync/message_id.h"
+
+/// XOR of the ids in a range, order independent and updatable in O(1)
+using RangeFingerprint = std::array<uint8_t, kMessageIdSize>;
+
+/// one node of the range tree: all messages whose timestamps fall into
+/// [index << shift, (index + 1) << shift), shift depending on the level
+struct RangeNode {
+    uint8_t level;
+    uint64_t index;
+
+    auto operator<=>(RangeNode const &) const = default;
+};
+
+struct RangeSummary {
+    uint64_t index;
+    RangeFingerprint fingerprint;
+    uint64_t count;
+};
+
+/// every non-empty node at `child_level` underneath `parent`
+struct RangeFingerprints {
+    RangeNode parent;
+    uint8_t child_level;
+    std::vector<RangeSummary> children;
+};
+
+/// every id in `node`
+struct RangeIds {
+    RangeNode node;
+    std::vector<MessageId> ids;
+};
+
+struct ReconcileMessage {
+    std::vector<RangeFingerprints> fingerprints;
+    std::vector<RangeIds> id_lists;
+    /// ids the sender is missing and wants sent over
+    std::vector<MessageId> need;
+
+    bool empty() const {
+        return fingerprints.empty() && id_lists.empty() && need.empty();
+    }
+
+    std::vector<uint8_t> serialize() const;
+    static std::optional<ReconcileMessage> deserialize(
+            std::span<uint8_t const> bytes);
+};
+
+struct ReconcileStep {
+    /// nothing to reply when empty, the exchange is over on our side
+    ReconcileMessage reply;
+    /// messages the peer is missing
+    std::vector<MessageId> to_send;
+};
+
+/// range-based set reconciliation over a Merkle tree of time buckets.
+///
+/// leaves bucket messages by timestamp >> kLeafShift; every level above
+/// groups kFanout nodes of the level below. the two sides exchange node
+/// fingerprints starting at the root and only descend into ranges whose
+/// fingerprints differ, falling back to explicit id lists once a range is
+/// small. the amount exchanged grows with the size of the difference, not
+/// with the size of the stores.
+class RangeReconciler {
+public:
+    static constexpr size_t kLeafShift = 0;
+    static constexpr size_t kFanoutBits = 4;
+    static constexpr size_t kFanout = size_t{1} << kFanoutBits;
+    static constexpr uint8_t kRootLevel =
+            (64 - kLeafShift + kFanoutBits - 1) / kFanoutBits;
+    /// at most this many fingerprints are sent for one differing range
+    static constexpr size_t kMaxFingerprints = 16;
+    /// ranges this small are settled by exchanging their ids
+    static constexpr size_t kIdListThreshold = 16;
+    /// at most this many of the ids a peer needs are sent per step
+    static constexpr size_t kMaxNeed = 4096;
+
+    void insert(uint64_t timestamp, MessageId const &id);
+    /// `id` must have been inserted with the same timestamp
+    void erase(uint64_t timestamp, MessageId const &id);
+
+    size_t size() const { return count(root()); }
+
+    /// the first message of an exchange
+    ReconcileMessage initiate() const;
+
+    ReconcileStep process(ReconcileMessage const &message) const;
+
+    /// the [first, last) indexes of the descendants of `parent` at `level`
+    static std::pair<uint64_t, uint64_t> descendants(
+            RangeNode parent, uint8_t level);
+
+private:
+    struct Node {
+        RangeFingerprint fingerprint{};
+        uint64_t count = 0;
+    };
+
+    /// one map per level, level 0 being the leaves
+    std::array<std::map<uint64_t, Node>, kRootLevel + 1> levels_;
+    std::map<uint64_t, std::vector<MessageId>> leaf_ids_;
+
+    static RangeNode root() { return {kRootLevel, 0}; }
+
+    static uint64_t shift_right(uint64_t value, size_t shift) {
+        return shift >= 64 ? 0 : value >> shift;
+    }
+
+    uint64_t count(RangeNode node) const;
+
+    RangeFingerprints fingerprints_of(RangeNode parent) const;
+    RangeIds ids_of(RangeNode node) const;
+    void describe(RangeNode node, ReconcileMessage &reply) const;
+};
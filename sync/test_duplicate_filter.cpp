@@ -0,0 +1,61 @@
+#include <chrono>
+#include <cstdint>
+#include <set>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "duplicate_filter.h"
+
+namespace {
+
+MessageId id_of(uint64_t i) {
+    std::span<uint8_t const> bytes{
+            reinterpret_cast<uint8_t const *>(&i), sizeof(i)};
+    return message_id(bytes);
+}
+
+} // namespace
+
+TEST_CASE("DuplicateFilter") {
+    using namespace std::chrono_literals;
+    DuplicateFilter::Clock::time_point start{};
+    DuplicateFilter filter{{.n = 1000, .fpr = 0.001, .horizon = 60s}, start};
+
+    // stands in for the store
+    std::set<MessageId> held;
+    auto holds = [&](MessageId const &id) { return held.contains(id); };
+
+    for (uint64_t i = 0; i < 100; ++i) {
+        CHECK_FALSE(filter.seen(id_of(i), 256, start, holds));
+        filter.remember(id_of(i), start);
+        held.insert(id_of(i));
+    }
+
+    // every message arrives again over a second path, and a few new ones
+    for (uint64_t i = 0; i < 200; ++i) {
+        CHECK_EQ(filter.seen(id_of(i), 256, start + 30s, holds), i < 100);
+    }
+
+    DuplicateFilterStats const &stats = filter.stats();
+    CHECK_EQ(stats.messages, 300u);
+    CHECK_EQ(stats.duplicates, 100u);
+    CHECK_EQ(stats.duplicate_bytes, 100u * 256);
+    CHECK_EQ(stats.duplicate_rate(), 100.0 / 300);
+
+    SUBCASE("A hit on a message we do not hold is a false positive") {
+        // the filter still has it, the store evicted it meanwhile
+        held.erase(id_of(0));
+        CHECK_FALSE(filter.seen(id_of(0), 256, start + 30s, holds));
+        CHECK_EQ(filter.stats().false_positives, 1u);
+        CHECK_EQ(filter.stats().duplicates, 100u);
+    }
+
+    SUBCASE("Forgotten past the horizon") {
+        size_t seen = 0;
+        for (uint64_t i = 0; i < 100; ++i) {
+            seen += filter.seen(id_of(i), 256, start + 2min, holds) ? 1 : 0;
+        }
+        CHECK_EQ(seen, 0u);
+    }
+}
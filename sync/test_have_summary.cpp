@@ -0,0 +1,74 @@
+#include <cstdint>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "have_summary.h"
+
+namespace {
+
+MessageId id_of(uint64_t i) {
+    std::span<uint8_t const> bytes{
+            reinterpret_cast<uint8_t const *>(&i), sizeof(i)};
+    return message_id(bytes);
+}
+
+} // namespace
+
+TEST_CASE("HaveSummary") {
+    std::vector<MessageId> held;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        held.push_back(id_of(i));
+    }
+
+    HaveSummary summary = HaveSummary::from_ids(held);
+
+    SUBCASE("No false negatives") {
+        for (MessageId const &id : held) {
+            CHECK(summary.might_have(id));
+        }
+    }
+
+    SUBCASE("False positive rate") {
+        size_t false_positives = 0;
+        for (uint64_t i = 1000; i < 11000; ++i) {
+            false_positives += summary.might_have(id_of(i)) ? 1 : 0;
+        }
+
+        CHECK_LT(false_positives, 10000 * kHaveSummaryFpr * 2);
+    }
+
+    SUBCASE("False positives change with every summary") {
+        HaveSummary other = HaveSummary::from_ids(held);
+
+        size_t both = 0;
+        size_t either = 0;
+        for (uint64_t i = 1000; i < 101000; ++i) {
+            bool first = summary.might_have(id_of(i));
+            bool second = other.might_have(id_of(i));
+            both += first && second ? 1 : 0;
+            either += first || second ? 1 : 0;
+        }
+
+        CHECK_GT(either, 0);
+        CHECK_LT(both, either / 10);
+    }
+
+    SUBCASE("Round trip") {
+        auto bytes = summary.serialize();
+        auto decoded = HaveSummary::deserialize(bytes);
+        REQUIRE(decoded.has_value());
+
+        CHECK_EQ(decoded->serialize(), bytes);
+        for (MessageId const &id : held) {
+            CHECK(decoded->might_have(id));
+        }
+    }
+
+    SUBCASE("Truncated") {
+        auto bytes = summary.serialize();
+        bytes.pop_back();
+        CHECK(!HaveSummary::deserialize(bytes).has_value());
+    }
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "range_reconciler.h"
+
+namespace {
+
+MessageId id_of(uint64_t i) {
+    std::span<uint8_t const> bytes{
+            reinterpret_cast<uint8_t const *>(&i), sizeof(i)};
+    return message_id(bytes);
+}
+
+uint64_t timestamp_of(uint64_t i) { return 1700000000 + i * 7; }
+
+struct Outcome {
+    std::set<MessageId> sent_by_a;
+    std::set<MessageId> sent_by_b;
+    size_t rounds = 0;
+    size_t bytes = 0;
+};
+
+// runs an exchange the way two connected peers would, passing every message
+// through its wire format
+Outcome reconcile(RangeReconciler const &a, RangeReconciler const &b) {
+    Outcome outcome;
+    ReconcileMessage message = a.initiate();
+    bool b_turn = true;
+
+    while (!message.empty()) {
+        std::vector<uint8_t> bytes = message.serialize();
+        outcome.bytes += bytes.size();
+        outcome.rounds++;
+
+        auto decoded = ReconcileMessage::deserialize(bytes);
+        REQUIRE(decoded.has_value());
+
+        ReconcileStep step = (b_turn ? b : a).process(decoded.value());
+        auto &sent = b_turn ? outcome.sent_by_b : outcome.sent_by_a;
+        sent.insert(step.to_send.begin(), step.to_send.end());
+
+        message = std::move(step.reply);
+        b_turn = !b_turn;
+    }
+
+    return outcome;
+}
+
+} // namespace
+
+TEST_CASE("RangeReconciler") {
+    RangeReconciler a;
+    RangeReconciler b;
+
+    std::set<MessageId> only_a;
+    std::set<MessageId> only_b;
+
+    for (uint64_t i = 0; i < 20000; ++i) {
+        MessageId id = id_of(i);
+
+        if (i % 1000 == 3) {
+            a.insert(timestamp_of(i), id);
+            only_a.insert(id);
+        } else if (i % 1500 == 7) {
+            b.insert(timestamp_of(i), id);
+            only_b.insert(id);
+        } else {
+            a.insert(timestamp_of(i), id);
+            b.insert(timestamp_of(i), id);
+        }
+    }
+
+    SUBCASE("Finds exactly the difference") {
+        Outcome outcome = reconcile(a, b);
+
+        CHECK_EQ(outcome.sent_by_a, only_a);
+        CHECK_EQ(outcome.sent_by_b, only_b);
+
+        // far less than sending 20000 ids
+        CHECK_LT(outcome.bytes, 20000 * kMessageIdSize / 10);
+    }
+
+    SUBCASE("Identical stores settle in one round") {
+        Outcome outcome = reconcile(a, a);
+
+        CHECK(outcome.sent_by_a.empty());
+        CHECK(outcome.sent_by_b.empty());
+        CHECK_EQ(outcome.rounds, 1);
+    }
+
+    SUBCASE("Empty peer") {
+        RangeReconciler empty;
+        Outcome outcome = reconcile(empty, a);
+
+        CHECK_EQ(outcome.sent_by_b.size(), a.size());
+        CHECK(outcome.sent_by_a.empty());
+    }
+
+    SUBCASE("Erasing the difference") {
+        for (MessageId const &id : only_a) {
+            uint64_t i = 0;
+            while (id_of(i) != id) {
+                ++i;
+            }
+            a.erase(timestamp_of(i), id);
+        }
+        for (uint64_t i = 0; i < 20000; ++i) {
+            if (i % 1500 == 7) {
+                a.insert(timestamp_of(i), id_of(i));
+            }
+        }
+
+        Outcome outcome = reconcile(a, b);
+        CHECK(outcome.sent_by_a.empty());
+        CHECK(outcome.sent_by_b.empty());
+        CHECK_EQ(outcome.rounds, 1);
+    }
+
+    SUBCASE("Repeats are answered once") {
+        RangeNode root{RangeReconciler::kRootLevel, 0};
+
+        // the same id over and over, and the whole store three ways
+        ReconcileMessage message;
+        message.need.assign(10000, id_of(0));
+        message.need.push_back(id_of(1));
+        message.id_lists = {{root, {}}, {root, {}}};
+        message.fingerprints = {
+                {root, RangeReconciler::kRootLevel - 1, {}},
+                {root, RangeReconciler::kRootLevel - 1, {}},
+        };
+
+        auto decoded = ReconcileMessage::deserialize(message.serialize());
+        REQUIRE(decoded.has_value());
+        ReconcileStep step = a.process(decoded.value());
+
+        std::set<MessageId> sent{step.to_send.begin(), step.to_send.end()};
+        CHECK_EQ(step.to_send.size(), a.size());
+        CHECK_EQ(sent.size(), a.size());
+    }
+
+    SUBCASE("A repeated need is sent once") {
+        ReconcileMessage message;
+        message.need.assign(10000, id_of(0));
+        message.need.push_back(id_of(1));
+
+        ReconcileStep step = a.process(message);
+        std::vector<MessageId> expected{id_of(0), id_of(1)};
+        std::ranges::sort(expected);
+        CHECK_EQ(step.to_send, expected);
+    }
+
+    SUBCASE("Malformed") {
+        std::vector<uint8_t> bytes = a.initiate().serialize();
+        bytes.pop_back();
+        CHECK(!ReconcileMessage::deserialize(bytes).has_value());
+
+        bytes = {0xff, 0xff, 0xff, 0x0f};
+        CHECK(!ReconcileMessage::deserialize(bytes).has_value());
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// a tiny benchmark harness. every benchmark executable owns one Runner,
+/// which prints all results as a single JSON document on stdout when it
+/// goes out of scope, so runs can be diffed between releases.
+namespace bench {
+
+template<typename T>
+inline void do_not_optimize(T const &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+using Counters = std::vector<std::pair<std::string, double>>;
+
+class Runner {
+public:
+    /// how long every timed benchmark is repeated for, at minimum
+    static constexpr std::chrono::milliseconds kMinDuration{200};
+
+    Runner() = default;
+    Runner(Runner const &) = delete;
+
+    ~Runner() {
+        std::printf("{\n  \"benchmarks\": [");
+        for (size_t i = 0; i < results_.size(); ++i) {
+            Result const &result = results_[i];
+            std::printf("%s\n    {\"name\": \"%s\"", i == 0 ? "" : ",",
+                    result.name.c_str());
+            for (auto const &[key, value] : result.counters) {
+                std::printf(", \"%s\": %.6g", key.c_str(), value);
+            }
+            std::printf("}");
+        }
+        std::printf("\n  ]\n}\n");
+    }
+
+    /// times `fn` and reports nanoseconds per call. `bytes_per_call`, if
+    /// set, is used to also report throughput.
+    template<typename F>
+    void run(std::string_view name, F &&fn, size_t bytes_per_call = 0) {
+        using Clock = std::chrono::steady_clock;
+
+        size_t iterations = 1;
+        std::chrono::nanoseconds elapsed{};
+
+        while (true) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                fn();
+            }
+            elapsed = Clock::now() - start;
+
+            if (elapsed >= kMinDuration) {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        double ns_per_op = static_cast<double>(elapsed.count())
+                / static_cast<double>(iterations);
+
+        Counters counters{
+                {"iterations", static_cast<double>(iterations)},
+                {"ns_per_op", ns_per_op},
+        };
+        if (bytes_per_call != 0) {
+            counters.emplace_back("mb_per_s",
+                    static_cast<double>(bytes_per_call) * 1e3 / ns_per_op);
+        }
+
+        record(name, std::move(counters));
+    }
+
+    /// reports a result that is not a timing, e.g. bytes on the wire
+    void record(std::string_view name, Counters counters) {
+        results_.push_back({std::string{name}, std::move(counters)});
+    }
+
+private:
+    struct Result {
+        std::string name;
+        Counters counters;
+    };
+
+    std::vector<Result> results_;
+};
+
+} // namespace bench
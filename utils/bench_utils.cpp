@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <absl/strings/str_format.h>
+
+#include "utils/bench.h"
+#include "utils/bloom_filter.h"
+#include "utils/multiaddr.h"
+#include "utils/uuid.h"
+#include "utils/varint.h"
+#include "utils/worker_pool.h"
+
+namespace {
+
+constexpr char const *kUUID = "123e4567-e89b-12d3-a456-426614174000";
+constexpr char const *kMultiaddr =
+        "/btle/123e4567-e89b-12d3-a456-426614174000/1.2.3";
+
+/// stands in for checking a burst of signatures
+uint64_t heavy_job() {
+    uint64_t x = 0x9e3779b97f4a7c15;
+    for (int i = 0; i < 200'000; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    return x;
+}
+
+/// how late a 1 ms tick on the io thread fires while a producer pushes
+/// heavy jobs, run inline or on a worker pool
+bench::Counters tick_lateness(WorkerPool *pool) {
+    constexpr int kTicks = 500;
+    constexpr std::chrono::milliseconds kTick{1};
+
+    asio::io_context context;
+    std::vector<double> lateness;
+    bool done = false;
+    size_t jobs = 0;
+
+    asio::co_spawn(context,
+            [&]() -> asio::awaitable<void> {
+                asio::steady_timer timer(context);
+                for (int i = 0; i < kTicks; ++i) {
+                    auto deadline = std::chrono::steady_clock::now() + kTick;
+                    timer.expires_at(deadline);
+                    co_await timer.async_wait(asio::use_awaitable);
+                    std::chrono::duration<double, std::micro> late =
+                            std::chrono::steady_clock::now() - deadline;
+                    lateness.push_back(late.count());
+                }
+                done = true;
+            },
+            asio::detached);
+
+    asio::co_spawn(context,
+            [&]() -> asio::awaitable<void> {
+                while (!done) {
+                    if (pool != nullptr) {
+                        bench::do_not_optimize(co_await pool->run(heavy_job));
+                    } else {
+                        bench::do_not_optimize(heavy_job());
+                        co_await asio::post(context, asio::use_awaitable);
+                    }
+                    jobs++;
+                }
+            },
+            asio::detached);
+
+    auto start = std::chrono::steady_clock::now();
+    context.run();
+    std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+    std::ranges::sort(lateness);
+    return {
+            {"p50_us", lateness[lateness.size() / 2]},
+            {"p99_us", lateness[lateness.size() * 99 / 100]},
+            {"jobs_per_s", static_cast<double>(jobs) / elapsed.count()},
+    };
+}
+
+/// decode_varuint as it was before the word-at-a-time path, to compare
+std::optional<std::tuple<uint64_t, size_t>> decode_varuint_bytewise(
+        std::span<uint8_t const> bytes) {
+    uint64_t result = 0;
+    for (size_t read = 0; read < bytes.size(); read++) {
+        uint8_t current = bytes[read];
+        result |= static_cast<uint64_t>(current & ~0x80) << (read * 7);
+        if ((current & 0x80) == 0) {
+            return std::tuple<uint64_t, size_t>{result, read + 1};
+        }
+    }
+    return std::nullopt;
+}
+
+std::span<uint8_t const> bytes_of(uint64_t const &key) {
+    return {reinterpret_cast<uint8_t const *>(&key), sizeof(key)};
+}
+
+/// the classic StaticBloomFilter against BlockedBloomFilter, both sized
+/// for `opts`: time per op, and the false positive rate each achieves
+template<Options opts>
+void bench_bloom_filters(bench::Runner &runner) {
+    constexpr uint64_t kProbes = 1000000;
+
+    // on the heap, the big bitset does not fit on the stack
+    auto classic = std::make_unique<StaticBloomFilter<opts>>();
+    BlockedBloomFilter blocked{opts, BlockedBloomFilter::random_seed()};
+    for (uint64_t key = 0; key < opts.n; ++key) {
+        classic->put(key);
+        blocked.put(bytes_of(key));
+    }
+
+    size_t classic_hits = 0;
+    size_t blocked_hits = 0;
+    for (uint64_t key = opts.n; key < opts.n + kProbes; ++key) {
+        classic_hits += classic->might_contain(key) ? 1 : 0;
+        blocked_hits += blocked.might_contain(bytes_of(key)) ? 1 : 0;
+    }
+
+    auto probes = static_cast<double>(kProbes);
+    runner.record(absl::StrFormat("bloom_filter/n:%d/fpr", opts.n),
+            {
+                    {"target", opts.fpr},
+                    {"static", static_cast<double>(classic_hits) / probes},
+                    {"blocked", static_cast<double>(blocked_hits) / probes},
+                    {"blocked_expected",
+                            BlockedBloomFilter::false_positive_rate(
+                                    blocked.block_count(), opts.n)},
+                    {"static_bits_per_key",
+                            static_cast<double>(
+                                    calculate_bloom_filter_config(opts).m)
+                                    / opts.n},
+                    {"blocked_bits_per_key",
+                            static_cast<double>(blocked.bit_count())
+                                    / opts.n},
+            });
+
+    // keys spread over the filter, as lookups for unrelated ids would be
+    std::mt19937_64 rng{42};
+    std::vector<uint64_t> keys(1 << 16);
+    for (uint64_t &key : keys) {
+        key = rng();
+    }
+    std::vector<BloomHash> hashes;
+    for (uint64_t const &key : keys) {
+        hashes.push_back(blocked.hash(bytes_of(key)));
+    }
+
+    size_t i = 0;
+    runner.run(absl::StrFormat("static_bloom_filter/n:%d/might_contain",
+                       opts.n),
+            [&] {
+                bench::do_not_optimize(
+                        classic->might_contain(keys[i++ % keys.size()]));
+            });
+
+    i = 0;
+    runner.run(absl::StrFormat("blocked_bloom_filter/n:%d/might_contain",
+                       opts.n),
+            [&] {
+                bench::do_not_optimize(blocked.might_contain(
+                        bytes_of(keys[i++ % keys.size()])));
+            });
+
+    // the probe alone, for callers that hash once and probe many filters
+    i = 0;
+    runner.run(absl::StrFormat(
+                       "blocked_bloom_filter/n:%d/might_contain_hashed",
+                       opts.n),
+            [&] {
+                bench::do_not_optimize(
+                        blocked.might_contain(hashes[i++ % hashes.size()]));
+            });
+
+    i = 0;
+    runner.run(absl::StrFormat("static_bloom_filter/n:%d/put", opts.n),
+            [&] { classic->put(keys[i++ % keys.size()]); });
+
+    i = 0;
+    runner.run(absl::StrFormat("blocked_bloom_filter/n:%d/put", opts.n),
+            [&] { blocked.put(hashes[i++ % hashes.size()]); });
+}
+
+} // namespace
+
+int main() {
+    bench::Runner runner;
+
+    // values taking 1, 2, 5 and 10 bytes
+    for (uint64_t value : {uint64_t{100},
+                 uint64_t{10000},
+                 uint64_t{1} << 32,
+                 UINT64_MAX}) {
+        std::vector<uint8_t> encoded = encode_varuint(value);
+        std::array<uint8_t, kMaxVaruintSize> out{};
+
+        runner.run(absl::StrFormat("varint/encode/bytes:%d", encoded.size()),
+                [&] { bench::do_not_optimize(encode_varuint(value)); });
+        runner.run(
+                absl::StrFormat("varint/encode_span/bytes:%d", encoded.size()),
+                [&] {
+                    bench::do_not_optimize(encode_varuint(value, out));
+                    bench::do_not_optimize(out);
+                });
+        // padded as it would be inside a message, so the word-at-a-time
+        // path applies
+        std::vector<uint8_t> padded = encoded;
+        padded.resize(16);
+        runner.run(absl::StrFormat("varint/decode/bytes:%d", encoded.size()),
+                [&] { bench::do_not_optimize(decode_varuint(padded)); });
+        runner.run(absl::StrFormat(
+                           "varint/decode_bytewise/bytes:%d", encoded.size()),
+                [&] {
+                    bench::do_not_optimize(decode_varuint_bytewise(padded));
+                });
+    }
+
+    // a stream of mixed-size varints, as found in packed multiaddrs and
+    // serialized filters
+    {
+        std::mt19937_64 random{0};
+        std::vector<uint8_t> stream;
+        size_t count = 0;
+        while (stream.size() < 64 * 1024) {
+            uint64_t value = random() >> (random() % 64);
+            std::vector<uint8_t> encoded = encode_varuint(value);
+            stream.insert(stream.end(), encoded.begin(), encoded.end());
+            count++;
+        }
+
+        runner.run("varint/decode_stream",
+                [&] {
+                    std::span<uint8_t const> rest{stream};
+                    while (!rest.empty()) {
+                        auto [value, read] = decode_varuint(rest).value();
+                        bench::do_not_optimize(value);
+                        rest = rest.subspan(read);
+                    }
+                },
+                stream.size());
+        runner.run("varint/decode_stream_bytewise",
+                [&] {
+                    std::span<uint8_t const> rest{stream};
+                    while (!rest.empty()) {
+                        auto [value, read] =
+                                decode_varuint_bytewise(rest).value();
+                        bench::do_not_optimize(value);
+                        rest = rest.subspan(read);
+                    }
+                },
+                stream.size());
+
+        std::vector<uint64_t> values(count);
+        runner.run("varint/decode_stream_bulk",
+                [&] {
+                    bench::do_not_optimize(decode_varuints(stream, values));
+                    bench::do_not_optimize(values);
+                },
+                stream.size());
+        runner.record("varint/decode_stream/values",
+                {{"count", static_cast<double>(count)}});
+    }
+
+    Multiaddr multiaddr = Multiaddr::parse(kMultiaddr).value();
+    std::vector<uint8_t> raw_multiaddr = multiaddr.to_raw();
+
+    runner.run("multiaddr/parse",
+            [&] { bench::do_not_optimize(Multiaddr::parse(kMultiaddr)); });
+    runner.run("multiaddr/parse_raw", [&] {
+        bench::do_not_optimize(Multiaddr::parse_raw(raw_multiaddr));
+    });
+    runner.run("multiaddr/to_string",
+            [&] { bench::do_not_optimize(multiaddr.to_string()); });
+
+    std::array<uint8_t, Multiaddr::kMaxRawSize> raw_buffer{};
+    runner.run("multiaddr/to_raw", [&] {
+        bench::do_not_optimize(multiaddr.to_raw(raw_buffer));
+        bench::do_not_optimize(raw_buffer);
+    });
+    runner.run("multiaddr/copy", [&] {
+        Multiaddr copy = multiaddr;
+        bench::do_not_optimize(copy);
+    });
+
+    {
+        // the same few addresses reported for many contacts
+        MultiaddrInterner interner;
+        std::vector<SharedMultiaddr> held;
+        held.reserve(1 << 16);
+        runner.run("multiaddr/intern", [&] {
+            if (held.size() == held.capacity()) {
+                held.clear();
+            }
+            held.push_back(interner.intern(multiaddr));
+        });
+    }
+
+    UUID uuid = UUID::parse(kUUID).value();
+    runner.run("uuid/parse",
+            [&] { bench::do_not_optimize(UUID::parse(kUUID)); });
+    runner.run("uuid/to_string",
+            [&] { bench::do_not_optimize(uuid.to_string()); });
+
+    bench_bloom_filters<Options{.n = 10000, .fpr = 0.01}>(runner);
+    bench_bloom_filters<Options{.n = 1000000, .fpr = 0.01}>(runner);
+
+    {
+        // the duplicate filter a node keeps over received message ids
+        auto now = AgingBloomFilter::Clock::now();
+        AgingBloomFilter aging{{.n = 16384, .generations = 4}, now};
+        uint64_t key = 0;
+        runner.run("aging_bloom_filter/put",
+                [&] { aging.put(bytes_of(key++), now); });
+        runner.run("aging_bloom_filter/might_contain", [&] {
+            bench::do_not_optimize(aging.might_contain(bytes_of(key++), now));
+        });
+    }
+
+    runner.record("worker_pool/tick_lateness/inline", tick_lateness(nullptr));
+    {
+        WorkerPool pool;
+        runner.record("worker_pool/tick_lateness/pool", tick_lateness(&pool));
+    }
+
+    WorkerPool pool;
+    runner.run("worker_pool/try_submit", [&] {
+        while (!pool.try_submit([] {})) {
+        }
+    });
+}
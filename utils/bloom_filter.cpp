@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <sodium.h>
+
+#include "bloom_filter.h"
+#include "error_utils.h"
+#include "varint.h"
+
+namespace {
+
+/// how many bytes a block takes serialized
+constexpr size_t kBlockBytes = BlockedBloomFilter::kBlockBits / 8;
+
+uint32_t load_u32(uint8_t const *bytes) {
+    return static_cast<uint32_t>(bytes[0])
+            | static_cast<uint32_t>(bytes[1]) << 8
+            | static_cast<uint32_t>(bytes[2]) << 16
+            | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+void store_u32(uint32_t word, uint8_t *out) {
+    for (size_t byte = 0; byte < sizeof(word); ++byte) {
+        out[byte] = static_cast<uint8_t>(word >> (byte * 8));
+    }
+}
+
+} // namespace
+
+BloomSeed BlockedBloomFilter::random_seed() {
+    BloomSeed seed;
+    crypto_shorthash_siphashx24_keygen(seed.data());
+    return seed;
+}
+
+double BlockedBloomFilter::false_positive_rate(size_t blocks, size_t n) {
+    if (n == 0) {
+        return 0;
+    }
+
+    // the keys in a block are poisson distributed. with i of them, each
+    // word has a bit set with probability 1 - (1 - 1/32)^i, and a probe
+    // passes if all eight words do.
+    double lambda = static_cast<double>(n) / static_cast<double>(blocks);
+    double spread = 10 * std::sqrt(lambda) + 10;
+    auto first = static_cast<size_t>(std::max(0.0, lambda - spread));
+    auto last = static_cast<size_t>(lambda + spread);
+
+    double fpr = 0;
+    for (size_t i = first; i <= last; ++i) {
+        auto keys = static_cast<double>(i);
+        double weight = std::exp(
+                keys * std::log(lambda) - lambda - std::lgamma(keys + 1));
+        double word_set = -std::expm1(keys * std::log1p(-1.0 / 32));
+        fpr += weight * std::pow(word_set, kBlockWords);
+    }
+
+    return std::min(fpr, 1.0);
+}
+
+size_t BlockedBloomFilter::blocks_for(Options const &opts) {
+    if (opts.n == 0) {
+        return 1;
+    }
+
+    // a classic filter is the lower bound, double up from it
+    size_t low = std::max<size_t>(
+            calculate_bloom_filter_config(opts).m / kBlockBits, 1);
+    size_t high = low;
+    while (false_positive_rate(high, opts.n) > opts.fpr) {
+        low = high;
+        high *= 2;
+    }
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (false_positive_rate(mid, opts.n) > opts.fpr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return high;
+}
+
+BloomHash BlockedBloomFilter::hash(std::span<uint8_t const> key) const {
+    std::array<uint8_t, crypto_shorthash_siphashx24_BYTES> digest;
+    crypto_shorthash_siphashx24(
+            digest.data(), key.data(), key.size(), seed_.data());
+    return {detail::load_word(digest.data()),
+            detail::load_word(digest.data() + 8)};
+}
+
+bool BlockedBloomFilter::unite(BlockedBloomFilter const &other) {
+    if (blocks_.size() != other.blocks_.size() || seed_ != other.seed_) {
+        return false;
+    }
+
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        for (size_t word = 0; word < kBlockWords; ++word) {
+            blocks_[i].words[word] |= other.blocks_[i].words[word];
+        }
+    }
+
+    return true;
+}
+
+bool BlockedBloomFilter::intersect(BlockedBloomFilter const &other) {
+    if (blocks_.size() != other.blocks_.size() || seed_ != other.seed_) {
+        return false;
+    }
+
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        for (size_t word = 0; word < kBlockWords; ++word) {
+            blocks_[i].words[word] &= other.blocks_[i].words[word];
+        }
+    }
+
+    return true;
+}
+
+std::vector<uint8_t> BlockedBloomFilter::serialize() const {
+    std::vector<uint8_t> bytes(1 + varuint_size(blocks_.size())
+            + seed_.size() + blocks_.size() * kBlockBytes);
+
+    size_t written = 0;
+    bytes[written++] = kFormat;
+    written += encode_varuint(
+            blocks_.size(), std::span{bytes}.subspan(written));
+    std::ranges::copy(seed_, bytes.begin() + written);
+    written += seed_.size();
+
+    for (Block const &block : blocks_) {
+        for (uint32_t word : block.words) {
+            store_u32(word, bytes.data() + written);
+            written += sizeof(word);
+        }
+    }
+
+    return bytes;
+}
+
+std::optional<BlockedBloomFilter> BlockedBloomFilter::deserialize(
+        std::span<uint8_t const> bytes) {
+    if (bytes.empty() || bytes[0] != kFormat) {
+        return std::nullopt;
+    }
+    bytes = bytes.subspan(1);
+
+    auto [blocks, read] = try_unwrap_optional(decode_varuint(bytes));
+    bytes = bytes.subspan(read);
+
+    BloomSeed seed;
+    if (bytes.size() < seed.size()) {
+        return std::nullopt;
+    }
+    std::ranges::copy(bytes.first(seed.size()), seed.begin());
+    bytes = bytes.subspan(seed.size());
+
+    // checked by division, a huge count must not wrap the product
+    if (blocks == 0 || bytes.size() % kBlockBytes != 0
+            || bytes.size() / kBlockBytes != blocks) {
+        return std::nullopt;
+    }
+
+    BlockedBloomFilter filter{blocks, seed};
+    uint8_t const *in = bytes.data();
+    for (Block &block : filter.blocks_) {
+        for (uint32_t &word : block.words) {
+            word = load_u32(in);
+            in += sizeof(word);
+        }
+    }
+
+    return filter;
+}
+
+AgingBloomFilter::AgingBloomFilter(
+        AgingBloomFilterOptions const &options, Clock::time_point now)
+    : n_{std::max<size_t>(options.n, 1)}, newest_since_{now} {
+    size_t generations = std::max<size_t>(options.generations, 2);
+    period_ = std::max(options.horizon
+                    / static_cast<Clock::rep>(generations - 1),
+            Clock::duration{1});
+
+    // a lookup passes if any generation passes, so each gets a share
+    Options per_generation{.n = n_,
+            .fpr = options.fpr / static_cast<double>(generations)};
+    BlockedBloomFilter empty{
+            per_generation, BlockedBloomFilter::random_seed()};
+    generations_.assign(generations, empty);
+}
+
+void AgingBloomFilter::put(
+        std::span<uint8_t const> key, Clock::time_point now) {
+    age(now);
+
+    if (newest_count_ == n_) {
+        rotate();
+        newest_since_ = now;
+        early_rotations_++;
+    }
+
+    BlockedBloomFilter &newest = generations_[newest_];
+    newest.put(newest.hash(key));
+    newest_count_++;
+}
+
+bool AgingBloomFilter::might_contain(
+        std::span<uint8_t const> key, Clock::time_point now) {
+    age(now);
+
+    BloomHash hash = generations_[0].hash(key);
+    return std::ranges::any_of(generations_,
+            [&](BlockedBloomFilter const &generation) {
+                return generation.might_contain(hash);
+            });
+}
+
+void AgingBloomFilter::age(Clock::time_point now) {
+    if (now - newest_since_ < period_) {
+        return;
+    }
+
+    auto periods = static_cast<size_t>((now - newest_since_) / period_);
+    for (size_t i = 0; i < std::min(periods, generations_.size()); ++i) {
+        rotate();
+    }
+    // stays on the period grid, however late we are called
+    newest_since_ += static_cast<Clock::rep>(periods) * period_;
+}
+
+void AgingBloomFilter::rotate() {
+    newest_ = (newest_ + 1) % generations_.size();
+    generations_[newest_].clear();
+    newest_count_ = 0;
+}
@@ -1,7 +1,25 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
 #include <bitset>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <sodium.h>
 
 struct Options {
     /// expected number of elements
@@ -23,11 +41,14 @@ constexpr BloomFilterConfig calculate_bloom_filter_config(Options const &opts) {
     return {m, k};
 }
 
+/// a classic filter sized at compile time, over std::hash. kept as the
+/// baseline BlockedBloomFilter is measured against in bench_utils.
 template<Options opts>
 class StaticBloomFilter {
 public:
     std::pair<uint64_t, uint64_t> get_halves(auto const &item) const {
-        auto hash_value = std::hash<decltype(item)>{}(item);
+        auto hash_value =
+                std::hash<std::remove_cvref_t<decltype(item)>>{}(item);
         size_t bits = sizeof(hash_value) * 8;
         auto lower_bits = static_cast<uint64_t>(
                 hash_value & std::numeric_limits<uint64_t>::max());
@@ -73,5 +94,231 @@ private:
             calculate_bloom_filter_config(opts);
 
     std::bitset<kConfig.m> bits_;
-    size_t k_;
+    size_t k_ = kConfig.k;
+};
+
+/// the key of the hash a BlockedBloomFilter probes with
+using BloomSeed = std::array<uint8_t, crypto_shorthash_siphashx24_KEYBYTES>;
+
+/// the 128-bit hash of a key: h1 picks the block, h2 the bits in it
+struct BloomHash {
+    uint64_t h1;
+    uint64_t h2;
+};
+
+/// a split block bloom filter. every key sets one bit in each of the eight
+/// 32-bit words of a single 256-bit block, so a probe touches one cache
+/// line and tests all its bits with one vector compare, whatever the size
+/// of the filter.
+///
+/// keys are hashed with SipHash under a seed kept with the filter. a new
+/// seed per filter means a key that is a false positive in one filter
+/// most likely is not in the next, and peers cannot pick keys that
+/// collide.
+///
+/// serialized: a format byte, the varuint block count, the seed, then the
+/// blocks as little-endian 32-bit words.
+class BlockedBloomFilter {
+public:
+    static constexpr size_t kBlockWords = 8;
+    static constexpr size_t kBlockBits = kBlockWords * 32;
+    static constexpr uint8_t kFormat = 1;
+
+    BlockedBloomFilter(size_t blocks, BloomSeed const &seed)
+        : blocks_(std::max<size_t>(blocks, 1)), seed_{seed} {}
+
+    BlockedBloomFilter(Options const &opts, BloomSeed const &seed)
+        : BlockedBloomFilter{blocks_for(opts), seed} {}
+
+    static BloomSeed random_seed();
+
+    /// the fewest blocks that hold opts.n keys at a false positive rate of
+    /// at most opts.fpr. blocks fill unevenly, so this is some 10-30% more
+    /// bits than a classic filter would take.
+    static size_t blocks_for(Options const &opts);
+
+    /// the expected false positive rate of `blocks` blocks holding `n` keys
+    static double false_positive_rate(size_t blocks, size_t n);
+
+    BloomHash hash(std::span<uint8_t const> key) const;
+
+    void put(BloomHash hash) {
+        Block &block = block_of(hash);
+        auto key = static_cast<uint32_t>(hash.h2);
+#if defined(__AVX2__)
+        auto *words = reinterpret_cast<__m256i *>(block.words.data());
+        _mm256_store_si256(
+                words, _mm256_or_si256(_mm256_load_si256(words), mask(key)));
+#elif defined(__ARM_NEON)
+        auto [low, high] = mask(key);
+        vst1q_u32(block.words.data(),
+                vorrq_u32(vld1q_u32(block.words.data()), low));
+        vst1q_u32(block.words.data() + 4,
+                vorrq_u32(vld1q_u32(block.words.data() + 4), high));
+#else
+        for (size_t i = 0; i < kBlockWords; ++i) {
+            block.words[i] |= bit(key, i);
+        }
+#endif
+    }
+
+    bool might_contain(BloomHash hash) const {
+        Block const &block = block_of(hash);
+        auto key = static_cast<uint32_t>(hash.h2);
+#if defined(__AVX2__)
+        auto const *words = reinterpret_cast<__m256i const *>(
+                block.words.data());
+        return _mm256_testc_si256(_mm256_load_si256(words), mask(key)) != 0;
+#elif defined(__ARM_NEON)
+        auto [low, high] = mask(key);
+        uint32x4_t set_low = vceqq_u32(
+                vandq_u32(vld1q_u32(block.words.data()), low), low);
+        uint32x4_t set_high = vceqq_u32(
+                vandq_u32(vld1q_u32(block.words.data() + 4), high), high);
+        return vminvq_u32(vandq_u32(set_low, set_high)) != 0;
+#else
+        uint32_t missing = 0;
+        for (size_t i = 0; i < kBlockWords; ++i) {
+            missing |= bit(key, i) & ~block.words[i];
+        }
+        return missing == 0;
+#endif
+    }
+
+    void put(std::span<uint8_t const> key) { put(hash(key)); }
+
+    bool might_contain(std::span<uint8_t const> key) const {
+        return might_contain(hash(key));
+    }
+
+    /// adds every key of `other`. false, and nothing changes, if the two
+    /// differ in size or seed.
+    bool unite(BlockedBloomFilter const &other);
+
+    /// keeps only the bits both filters set. it holds every key in both,
+    /// with a false positive rate no lower than either filter's.
+    bool intersect(BlockedBloomFilter const &other);
+
+    /// forgets every key, keeping the size and seed
+    void clear() { std::ranges::fill(blocks_, Block{}); }
+
+    size_t block_count() const { return blocks_.size(); }
+    size_t bit_count() const { return blocks_.size() * kBlockBits; }
+    BloomSeed const &seed() const { return seed_; }
+
+    std::vector<uint8_t> serialize() const;
+
+    static std::optional<BlockedBloomFilter> deserialize(
+            std::span<uint8_t const> bytes);
+
+    bool operator==(BlockedBloomFilter const &) const = default;
+
+private:
+    /// odd constants spreading a key's bits over the eight words, as in
+    /// the Parquet split block filter
+    static constexpr std::array<uint32_t, kBlockWords> kSalt{0x47b6137b,
+            0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b,
+            0x9efc4947, 0x5c6bfb31};
+
+    struct alignas(32) Block {
+        std::array<uint32_t, kBlockWords> words{};
+
+        bool operator==(Block const &) const = default;
+    };
+
+    std::vector<Block> blocks_;
+    BloomSeed seed_;
+
+    /// maps h1 onto the blocks with a multiply instead of a division
+    size_t block_index(BloomHash hash) const {
+        return static_cast<size_t>(
+                (static_cast<unsigned __int128>(hash.h1) * blocks_.size())
+                >> 64);
+    }
+
+    Block &block_of(BloomHash hash) { return blocks_[block_index(hash)]; }
+
+    Block const &block_of(BloomHash hash) const {
+        return blocks_[block_index(hash)];
+    }
+
+    /// the bit a key sets in word `i`, from the top 5 bits of key * salt
+    static uint32_t bit(uint32_t key, size_t i) {
+        return uint32_t{1} << ((key * kSalt[i]) >> 27);
+    }
+
+#if defined(__AVX2__)
+    static __m256i mask(uint32_t key) {
+        __m256i salt = _mm256_loadu_si256(
+                reinterpret_cast<__m256i const *>(kSalt.data()));
+        __m256i shifts = _mm256_srli_epi32(
+                _mm256_mullo_epi32(_mm256_set1_epi32(key), salt), 27);
+        return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+    }
+#elif defined(__ARM_NEON)
+    static std::pair<uint32x4_t, uint32x4_t> mask(uint32_t key) {
+        uint32x4_t one = vdupq_n_u32(1);
+        uint32x4_t low = vshrq_n_u32(
+                vmulq_u32(vdupq_n_u32(key), vld1q_u32(kSalt.data())), 27);
+        uint32x4_t high = vshrq_n_u32(
+                vmulq_u32(vdupq_n_u32(key), vld1q_u32(kSalt.data() + 4)),
+                27);
+        return {vshlq_u32(one, vreinterpretq_s32_u32(low)),
+                vshlq_u32(one, vreinterpretq_s32_u32(high))};
+    }
+#endif
+};
+
+struct AgingBloomFilterOptions {
+    /// keys expected per generation
+    size_t n = 10000;
+    /// false positive rate of a lookup, over all generations
+    double fpr = 0.001;
+    /// how long a key is remembered, at least
+    std::chrono::steady_clock::duration horizon = std::chrono::minutes(10);
+    /// how many generations are kept, at least 2
+    size_t generations = 4;
+};
+
+/// a bloom filter that forgets. keys go into the newest of a ring of
+/// generations, and every horizon / (generations - 1) the oldest one is
+/// cleared to become the newest. a key is remembered for between horizon
+/// and horizon * generations / (generations - 1), in fixed memory.
+///
+/// a generation that fills up with n keys before its time is up is
+/// retired early, which keeps the false positive rate at the cost of a
+/// shorter horizon while it lasts.
+///
+/// all generations share a seed, so a key is hashed once per lookup.
+class AgingBloomFilter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    AgingBloomFilter(
+            AgingBloomFilterOptions const &options, Clock::time_point now);
+
+    void put(std::span<uint8_t const> key, Clock::time_point now);
+
+    bool might_contain(std::span<uint8_t const> key, Clock::time_point now);
+
+    /// generations retired because they filled up
+    uint64_t early_rotations() const { return early_rotations_; }
+
+    size_t bit_count() const {
+        return generations_.size() * generations_[0].bit_count();
+    }
+
+private:
+    std::vector<BlockedBloomFilter> generations_;
+    size_t n_;
+    Clock::duration period_;
+
+    size_t newest_ = 0;
+    size_t newest_count_ = 0;
+    Clock::time_point newest_since_;
+    uint64_t early_rotations_ = 0;
+
+    /// retires the generations whose time ran out by `now`
+    void age(Clock::time_point now);
+    void rotate();
 };
@@ -1,8 +1,7 @@
 #include <algorithm>
+#include <array>
+#include <charconv>
 #include <cstdint>
-#include <expected>
-#include <functional>
-#include <map>
 #include <optional>
 #include <span>
 #include <string_view>
@@ -11,75 +10,197 @@
 
 #include <absl/strings/str_format.h>
 
+#include "crypto/encoding.h"
+#include "error_utils.h"
 #include "multiaddr.h"
 #include "semantic_version.h"
 #include "varint.h"
 
 namespace {
 
-std::map<std::string_view,
-        std::function<std::optional<std::unique_ptr<Protocol>>(
-                MultiaddrStringTokenizer &)>> const protocol_parsers = {
-        {
-                "btle",
-                BluetoothAddress::parse_to_protocol,
-        },
+/// the '/'-separated tokens of a string, found as they are asked for
+class MultiaddrStringTokenizer {
+public:
+    explicit MultiaddrStringTokenizer(std::string_view str) : rest_{str} {}
+
+    std::optional<std::string_view> next() {
+        std::string_view rest = try_unwrap_optional(rest_);
+
+        size_t end = rest.find('/');
+        if (end == std::string_view::npos) {
+            rest_.reset();
+            return rest;
+        }
+
+        rest_ = rest.substr(end + 1);
+        return rest.substr(0, end);
+    }
+
+    /// whether only empty tokens are left
+    bool is_done() const {
+        return !rest_.has_value()
+                || rest_.value().find_first_not_of('/')
+                == std::string_view::npos;
+    }
+
+private:
+    std::optional<std::string_view> rest_;
 };
 
-std::map<uint64_t,
-        std::function<std::optional<std::unique_ptr<Protocol>>(
-                MultiaddrRawTokenizer &iter)>> const raw_protocol_parsers = {
-        {
-                150,
-                BluetoothAddress::parse_raw_to_protocol,
-        },
+class MultiaddrRawTokenizer {
+public:
+    explicit MultiaddrRawTokenizer(std::span<uint8_t const> bytes)
+        : bytes_{bytes} {}
+
+    bool is_done() const { return current_ == bytes_.size(); }
+
+    std::optional<uint64_t> read_uleb128() {
+        auto [value, read] =
+                try_unwrap_optional(decode_varuint(bytes_.subspan(current_)));
+        current_ += read;
+        return value;
+    }
+
+    std::optional<std::span<uint8_t const>> read_bytes(size_t count) {
+        if (count > bytes_.size() - current_) {
+            return std::nullopt;
+        }
+
+        std::span<uint8_t const> result = bytes_.subspan(current_, count);
+        current_ += count;
+        return result;
+    }
+
+private:
+    std::span<uint8_t const> bytes_;
+    size_t current_ = 0;
 };
 
+/// known protocols have exactly one form, so they never pass as opaque
+bool is_reserved(uint64_t code) {
+    return code == BluetoothAddress::kCode || code == Multiaddr::kVersionCode;
+}
+
+std::optional<OpaqueProtocol> parse_opaque(
+        std::string_view code_str, std::string_view hex) {
+    OpaqueProtocol opaque{};
+
+    auto [end, error] = std::from_chars(
+            code_str.data(), code_str.data() + code_str.size(), opaque.code);
+    if (error != std::errc{} || end != code_str.data() + code_str.size()
+            || is_reserved(opaque.code)) {
+        return std::nullopt;
+    }
+
+    if (hex.size() % 2 != 0 || hex.size() / 2 > OpaqueProtocol::kMaxSize) {
+        return std::nullopt;
+    }
+
+    opaque.size = static_cast<uint8_t>(hex.size() / 2);
+    if (!crypto::hex_decode(hex, {opaque.bytes.data(), opaque.size})) {
+        return std::nullopt;
+    }
+
+    return opaque;
+}
+
+std::optional<OpaqueProtocol> parse_raw_opaque(
+        uint64_t code, MultiaddrRawTokenizer &tokenizer) {
+    if (is_reserved(code)) {
+        return std::nullopt;
+    }
+
+    uint64_t size = try_unwrap_optional(tokenizer.read_uleb128());
+    if (size > OpaqueProtocol::kMaxSize) {
+        return std::nullopt;
+    }
+
+    std::span<uint8_t const> payload =
+            try_unwrap_optional(tokenizer.read_bytes(size));
+
+    OpaqueProtocol opaque{};
+    opaque.code = code;
+    opaque.size = static_cast<uint8_t>(size);
+    std::ranges::copy(payload, opaque.bytes.begin());
+    return opaque;
+}
+
+std::optional<SemanticVersion> parse_raw_version(
+        MultiaddrRawTokenizer &tokenizer) {
+    SemanticVersion version{};
+    version.major = try_unwrap_optional(tokenizer.read_uleb128());
+    version.minor = try_unwrap_optional(tokenizer.read_uleb128());
+    version.patch = try_unwrap_optional(tokenizer.read_uleb128());
+    return version;
+}
+
 } // namespace
 
 std::optional<Multiaddr> Multiaddr::parse(std::string_view str) {
     Multiaddr multiaddr{};
     MultiaddrStringTokenizer tokenizer{str};
 
-    while (auto protocol_opt = tokenizer.next()) {
-        std::string_view protocol = protocol_opt.value();
+    while (auto token_opt = tokenizer.next()) {
+        std::string_view token = token_opt.value();
 
-        if (protocol.empty()) {
+        if (token.empty()) {
             continue;
         }
 
-        if (auto protocol_parser = protocol_parsers.find(protocol);
-                protocol_parser != protocol_parsers.end()) {
-            auto protocol_result =
-                    try_unwrap_optional(protocol_parser->second(tokenizer));
+        if (token == BluetoothAddress::kName) {
+            std::string_view address = try_unwrap_optional(tokenizer.next());
+            BluetoothAddress protocol{
+                    try_unwrap_optional(UUID::parse(address))};
 
-            multiaddr.protocols.push_back(std::move(protocol_result));
+            if (!multiaddr.push(protocol)) {
+                return std::nullopt;
+            }
         } else if (tokenizer.is_done()) {
             multiaddr.version =
-                    try_unwrap_optional(SemanticVersion::parse(protocol));
+                    try_unwrap_optional(SemanticVersion::parse(token));
             break;
         } else {
-            return std::nullopt;
+            std::string_view payload = try_unwrap_optional(tokenizer.next());
+            OpaqueProtocol protocol =
+                    try_unwrap_optional(parse_opaque(token, payload));
+
+            if (!multiaddr.push(protocol)) {
+                return std::nullopt;
+            }
         }
     }
 
     return multiaddr;
 }
 
-std::optional<Multiaddr> Multiaddr::parse_raw(std::span<uint8_t> bytes) {
+std::optional<Multiaddr> Multiaddr::parse_raw(std::span<uint8_t const> bytes) {
     Multiaddr multiaddr{};
     MultiaddrRawTokenizer tokenizer{bytes};
 
-    while (auto protocol_opt = tokenizer.read_uleb128()) {
-        uint64_t protocol = protocol_opt.value();
+    while (!tokenizer.is_done()) {
+        uint64_t code = try_unwrap_optional(tokenizer.read_uleb128());
 
-        if (auto protocol_parser = raw_protocol_parsers.find(protocol);
-                protocol_parser != raw_protocol_parsers.end()) {
-            auto protocol_result =
-                    try_unwrap_optional(protocol_parser->second(tokenizer));
+        if (code == kVersionCode) {
+            multiaddr.version =
+                    try_unwrap_optional(parse_raw_version(tokenizer));
+            // always last
+            if (!tokenizer.is_done()) {
+                return std::nullopt;
+            }
+            break;
+        }
 
-            multiaddr.protocols.push_back(std::move(protocol_result));
+        Protocol protocol;
+        if (code == BluetoothAddress::kCode) {
+            std::span<uint8_t const> address =
+                    try_unwrap_optional(tokenizer.read_bytes(UUID::kSize));
+            protocol = BluetoothAddress{
+                    try_unwrap_optional(UUID::parse_raw(address))};
         } else {
+            protocol = try_unwrap_optional(parse_raw_opaque(code, tokenizer));
+        }
+
+        if (!multiaddr.push(protocol)) {
             return std::nullopt;
         }
     }
@@ -87,11 +208,81 @@ std::optional<Multiaddr> Multiaddr::parse_raw(std::span<uint8_t> bytes) {
     return multiaddr;
 }
 
+bool Multiaddr::push(Protocol protocol) {
+    if (size_ == kMaxProtocols) {
+        return false;
+    }
+
+    protocols_[size_++] = protocol;
+    return true;
+}
+
+size_t Multiaddr::raw_size() const {
+    size_t size = 0;
+    for (Protocol const &protocol : protocols()) {
+        if (std::holds_alternative<BluetoothAddress>(protocol)) {
+            size += varuint_size(BluetoothAddress::kCode) + UUID::kSize;
+        } else {
+            auto const &opaque = std::get<OpaqueProtocol>(protocol);
+            size += varuint_size(opaque.code) + varuint_size(opaque.size)
+                    + opaque.size;
+        }
+    }
+
+    if (version.has_value()) {
+        size += varuint_size(kVersionCode) + varuint_size(version->major)
+                + varuint_size(version->minor) + varuint_size(version->patch);
+    }
+
+    return size;
+}
+
+size_t Multiaddr::to_raw(std::span<uint8_t> out) const {
+    size_t written = 0;
+    for (Protocol const &protocol : protocols()) {
+        if (auto const *btle = std::get_if<BluetoothAddress>(&protocol)) {
+            written += encode_varuint(
+                    BluetoothAddress::kCode, out.subspan(written));
+            std::ranges::copy(btle->address.bytes(), out.begin() + written);
+            written += UUID::kSize;
+        } else {
+            auto const &opaque = std::get<OpaqueProtocol>(protocol);
+            written += encode_varuint(opaque.code, out.subspan(written));
+            written += encode_varuint(opaque.size, out.subspan(written));
+            std::ranges::copy(opaque.payload(), out.begin() + written);
+            written += opaque.size;
+        }
+    }
+
+    if (version.has_value()) {
+        written += encode_varuint(kVersionCode, out.subspan(written));
+        written += encode_varuint(version->major, out.subspan(written));
+        written += encode_varuint(version->minor, out.subspan(written));
+        written += encode_varuint(version->patch, out.subspan(written));
+    }
+
+    return written;
+}
+
+std::vector<uint8_t> Multiaddr::to_raw() const {
+    std::vector<uint8_t> result(raw_size());
+    to_raw(result);
+    return result;
+}
+
 std::string Multiaddr::to_string() const {
     std::string result;
-    for (auto const &protocol : protocols) {
-        absl::StrAppendFormat(
-                &result, "/%s/%s", protocol->name, protocol->to_string());
+    for (Protocol const &protocol : protocols()) {
+        if (auto const *btle = std::get_if<BluetoothAddress>(&protocol)) {
+            std::array<char, UUID::kStringSize> address;
+            btle->address.to_string(address);
+            absl::StrAppendFormat(&result, "/%s/%s", BluetoothAddress::kName,
+                    std::string_view{address.data(), address.size()});
+        } else {
+            auto const &opaque = std::get<OpaqueProtocol>(protocol);
+            absl::StrAppendFormat(&result, "/%d/%s", opaque.code,
+                    crypto::hex_string(opaque.payload()));
+        }
     }
 
     if (version.has_value()) {
@@ -100,3 +291,30 @@ std::string Multiaddr::to_string() const {
 
     return result;
 }
+
+SharedMultiaddr MultiaddrInterner::intern(Multiaddr const &addr) {
+    std::lock_guard lock(mutex_);
+
+    auto [it, inserted] = entries_.try_emplace(addr);
+    if (SharedMultiaddr shared = it->second.lock()) {
+        return shared;
+    }
+
+    auto shared = std::make_shared<Multiaddr const>(addr);
+    it->second = shared;
+
+    if (inserted && entries_.size() >= sweep_at_) {
+        std::erase_if(entries_,
+                [](auto const &entry) { return entry.second.expired(); });
+        // the entry just made is held, so it stays
+        sweep_at_ = std::max<size_t>(16, 2 * entries_.size());
+    }
+
+    return shared;
+}
+
+size_t MultiaddrInterner::size() const {
+    std::lock_guard lock(mutex_);
+    return std::ranges::count_if(entries_,
+            [](auto const &entry) { return !entry.second.expired(); });
+}
@@ -1,154 +1,128 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
-#include <expected>
-#include <iterator>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <span>
 #include <string>
 #include <string_view>
-#include <type_traits>
+#include <unordered_map>
+#include <variant>
 #include <vector>
 
-#include <absl/strings/str_split.h>
-
-#include "error_utils.h"
 #include "semantic_version.h"
 #include "uuid.h"
 #include "varint.h"
 
-struct Multiaddr;
-struct Protocol;
-
-constexpr uint32_t kUUIDSize = 32;
+/// a BLE peripheral, "/btle/<uuid>"
+struct BluetoothAddress {
+    static constexpr std::string_view kName = "btle";
+    static constexpr uint64_t kCode = 150;
 
-struct Protocol {
-    std::string name;
-    uint8_t code;
-
-    Protocol(std::string &&name, uint8_t code) : name{name}, code{code} {}
+    UUID address;
 
-    virtual ~Protocol() = default;
-    virtual std::string to_string() const = 0;
-    virtual std::span<uint8_t const> raw() const = 0;
+    bool operator==(BluetoothAddress const &) const = default;
 };
 
-struct Multiaddr {
-    std::vector<std::unique_ptr<Protocol>> protocols;
-    std::vector<uint8_t> identifier;
-    // not sure if this is even standard
-    std::optional<SemanticVersion> version;
+/// a protocol we do not know, kept as its code and payload so it survives
+/// a round trip. "/<code>/<hex payload>" as a string, the code and a
+/// length-prefixed payload packed.
+struct OpaqueProtocol {
+    static constexpr size_t kMaxSize = 32;
 
-    static std::optional<Multiaddr> parse(std::string_view str);
-    static std::optional<Multiaddr> parse_raw(std::span<uint8_t> bytes);
+    uint64_t code;
+    uint8_t size;
+    std::array<uint8_t, kMaxSize> bytes;
 
-    std::string to_string() const;
+    std::span<uint8_t const> payload() const { return {bytes.data(), size}; }
 
-    auto operator<=>(Multiaddr const &) const = default;
+    bool operator==(OpaqueProtocol const &other) const {
+        return code == other.code
+                && std::ranges::equal(payload(), other.payload());
+    }
 };
 
-class MultiaddrStringTokenizer {
+using Protocol = std::variant<BluetoothAddress, OpaqueProtocol>;
+
+/// a peer address. components are held inline, so a Multiaddr is a plain
+/// value: parsing, copying and comparing never touch the heap.
+///
+/// packed, each component is its varint code and payload, and the version
+/// comes last under kVersionCode as three varints.
+class Multiaddr {
 public:
-    explicit MultiaddrStringTokenizer(std::string_view str)
-        : tokens_{absl::StrSplit(str, '/')}, current_{tokens_.begin()} {}
-
-    std::optional<std::string_view> next() {
-        if (current_ != tokens_.end()) {
-            return *current_++;
-        }
-        return std::nullopt;
-    }
+    static constexpr size_t kMaxProtocols = 4;
+    /// the private-use multicodec range, nothing standard carries a version
+    static constexpr uint64_t kVersionCode = 0x300000;
+    static constexpr size_t kMaxRawSize =
+            kMaxProtocols * (2 * kMaxVaruintSize + OpaqueProtocol::kMaxSize)
+            + 4 * kMaxVaruintSize;
 
-    bool is_done() {
-        return current_ == tokens_.end()
-                || std::next(current_) == tokens_.end();
-    }
+    // not sure if this is even standard
+    std::optional<SemanticVersion> version;
 
-private:
-    std::vector<std::string_view> tokens_;
-    std::vector<std::string_view>::iterator current_;
-};
+    static std::optional<Multiaddr> parse(std::string_view str);
+    static std::optional<Multiaddr> parse_raw(std::span<uint8_t const> bytes);
 
-class MultiaddrRawTokenizer {
-public:
-    explicit MultiaddrRawTokenizer(std::vector<uint8_t> bytes)
-        : bytes_{bytes} {}
-
-    explicit MultiaddrRawTokenizer(std::span<uint8_t> bytes) : bytes_{bytes} {}
-
-    template<typename T>
-    std::optional<T> read()
-    requires std::is_trivially_copyable_v<T>
-    {
-        if (current_ + sizeof(T) >= bytes_.size()) {
-            return std::nullopt;
-        }
-
-        T *val = reinterpret_cast<T *>(&bytes_[current_]);
-        current_ += sizeof(T);
-        return *val;
+    std::span<Protocol const> protocols() const {
+        return {protocols_.data(), size_};
     }
 
-    std::optional<uint64_t> read_uleb128() {
-        auto [value, read] = try_unwrap_optional(decode_varuint(
-                {bytes_.begin() + current_, bytes_.size() - current_}));
-        current_ += read;
-        return value;
-    }
+    /// appends a component, false if there is no room left
+    bool push(Protocol protocol);
 
-    std::optional<std::span<uint8_t>> read_bytes(size_t count) {
-        if (current_ + count > bytes_.size()) {
-            return std::nullopt;
-        }
+    size_t raw_size() const;
 
-        std::span<uint8_t> result = {bytes_.begin() + current_, count};
-        current_ += count;
-        return result;
-    }
+    /// packs into `out`, which must hold raw_size() bytes, and returns how
+    /// many were written
+    size_t to_raw(std::span<uint8_t> out) const;
+    std::vector<uint8_t> to_raw() const;
 
-    std::optional<uint64_t> uint64() { return read<uint64_t>(); }
-    std::optional<uint32_t> uint32() { return read<uint32_t>(); }
-    std::optional<uint32_t> varuint32() {
-        uint64_t value = try_unwrap_optional(read_uleb128());
+    std::string to_string() const;
 
-        return value < UINT32_MAX
-                ? std::make_optional(static_cast<uint32_t>(value))
-                : std::nullopt;
+    bool operator==(Multiaddr const &other) const {
+        return version == other.version
+                && std::ranges::equal(protocols(), other.protocols());
     }
 
 private:
-    std::span<uint8_t> bytes_;
-    size_t current_ = 0;
+    std::array<Protocol, kMaxProtocols> protocols_{};
+    uint8_t size_ = 0;
 };
 
-struct BluetoothAddress : Protocol {
-    UUID address;
-
-    explicit BluetoothAddress(UUID addr)
-        : Protocol{"btle", 'b'}, address{addr} {}
-
-    std::string to_string() const override { return address.to_string(); }
-
-    std::span<uint8_t const> raw() const override {
-        return {address.bytes().begin(), address.bytes().end()};
+template<>
+struct std::hash<Multiaddr> {
+    /// over the packed form, which is unique per address
+    size_t operator()(Multiaddr const &addr) const noexcept {
+        std::array<uint8_t, Multiaddr::kMaxRawSize> raw;
+        size_t size = addr.to_raw(raw);
+        return std::hash<std::string_view>{}(
+                {reinterpret_cast<char const *>(raw.data()), size});
     }
+};
 
-    static std::optional<std::unique_ptr<Protocol>> parse_to_protocol(
-            MultiaddrStringTokenizer &iter) {
-        BluetoothAddress address{
-                try_unwrap_optional(UUID::parse(iter.next().value()))};
-        return std::unique_ptr(std::make_unique<BluetoothAddress>(address));
-    }
+/// an address shared by everyone who knows it
+using SharedMultiaddr = std::shared_ptr<Multiaddr const>;
 
-    static std::optional<std::unique_ptr<Protocol>> parse_raw_to_protocol(
-            MultiaddrRawTokenizer &tokenizer) {
-        std::span<uint8_t> bytes =
-                try_unwrap_optional(tokenizer.read_bytes(UUID::kSize));
+/// hands out one SharedMultiaddr per distinct address, so an address known
+/// by many contacts is stored once and compared by pointer. an entry goes
+/// once nobody holds it any more.
+class MultiaddrInterner {
+public:
+    SharedMultiaddr intern(Multiaddr const &addr);
 
-        BluetoothAddress address{try_unwrap_optional(UUID::parse_raw(bytes))};
+    /// addresses still held by someone
+    size_t size() const;
 
-        return std::unique_ptr(std::make_unique<BluetoothAddress>(address));
-    }
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<Multiaddr, std::weak_ptr<Multiaddr const>> entries_;
+    /// dropped entries are swept once the map has doubled since the last
+    /// sweep, so each insert pays O(1) for it
+    size_t sweep_at_ = 16;
 };
@@ -1,22 +1,34 @@
-#include <absl/strings/numbers.h>
-#include <absl/strings/str_split.h>
+#include <array>
+#include <charconv>
 #include <expected>
 #include <string_view>
-#include <vector>
 
 #include "semantic_version.h"
 
 std::expected<SemanticVersion, ParseError> SemanticVersion::parse(
         std::string_view str) {
-    std::vector<std::string_view> parts = absl::StrSplit(str, '.');
-    if (parts.size() != 3) {
-        return std::unexpected(ParseError::InvalidFormat);
+    SemanticVersion version{};
+    std::array<size_t *, 3> parts{
+            &version.major, &version.minor, &version.patch};
+
+    char const *current = str.data();
+    char const *end = str.data() + str.size();
+    for (size_t i = 0; i < parts.size(); ++i) {
+        if (i > 0) {
+            if (current == end || *current != '.') {
+                return std::unexpected(ParseError::InvalidFormat);
+            }
+            ++current;
+        }
+
+        auto [next, error] = std::from_chars(current, end, *parts[i]);
+        if (error != std::errc{}) {
+            return std::unexpected(ParseError::InvalidFormat);
+        }
+        current = next;
     }
 
-    SemanticVersion version{};
-    if (!absl::SimpleAtoi(parts[0], &version.major)
-            || !absl::SimpleAtoi(parts[1], &version.minor)
-            || !absl::SimpleAtoi(parts[2], &version.patch)) {
+    if (current != end) {
         return std::unexpected(ParseError::InvalidFormat);
     }
 
@@ -0,0 +1,196 @@
+#include "bloom_filter.h"
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "varint.h"
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+namespace {
+
+std::span<uint8_t const> key_of(uint64_t const &i) {
+    return {reinterpret_cast<uint8_t const *>(&i), sizeof(i)};
+}
+
+BloomSeed counting_seed() {
+    BloomSeed seed;
+    for (size_t i = 0; i < seed.size(); ++i) {
+        seed[i] = static_cast<uint8_t>(i);
+    }
+    return seed;
+}
+
+} // namespace
+
+TEST_CASE("BlockedBloomFilter") {
+    constexpr Options kOptions{.n = 10000, .fpr = 0.01};
+    BlockedBloomFilter filter{kOptions, BlockedBloomFilter::random_seed()};
+    for (uint64_t i = 0; i < kOptions.n; ++i) {
+        filter.put(key_of(i));
+    }
+
+    SUBCASE("No false negatives") {
+        for (uint64_t i = 0; i < kOptions.n; ++i) {
+            CHECK(filter.might_contain(key_of(i)));
+        }
+    }
+
+    SUBCASE("False positive rate") {
+        CHECK_LE(BlockedBloomFilter::false_positive_rate(
+                         filter.block_count(), kOptions.n),
+                kOptions.fpr);
+
+        size_t false_positives = 0;
+        for (uint64_t i = kOptions.n; i < 11 * kOptions.n; ++i) {
+            false_positives += filter.might_contain(key_of(i)) ? 1 : 0;
+        }
+
+        CHECK_LT(false_positives, 10 * kOptions.n * kOptions.fpr * 1.5);
+    }
+
+    SUBCASE("Sized between a classic filter and twice that") {
+        size_t classic = calculate_bloom_filter_config(kOptions).m;
+        CHECK_GE(filter.bit_count(), classic);
+        CHECK_LE(filter.bit_count(), 2 * classic);
+        CHECK_EQ(BlockedBloomFilter::blocks_for({.n = 0, .fpr = 0.01}), 1u);
+    }
+
+    SUBCASE("Union and intersection") {
+        BlockedBloomFilter evens{kOptions, filter.seed()};
+        BlockedBloomFilter odds{kOptions, filter.seed()};
+        for (uint64_t i = 0; i < kOptions.n; ++i) {
+            (i % 2 == 0 ? evens : odds).put(key_of(i));
+        }
+
+        BlockedBloomFilter both = evens;
+        REQUIRE(both.unite(odds));
+        CHECK_EQ(both, filter);
+
+        REQUIRE(both.intersect(evens));
+        CHECK_EQ(both, evens);
+
+        BlockedBloomFilter other_seed{
+                kOptions, BlockedBloomFilter::random_seed()};
+        CHECK_FALSE(both.unite(other_seed));
+        CHECK_FALSE(both.intersect(BlockedBloomFilter{1, filter.seed()}));
+        CHECK_EQ(both, evens);
+    }
+
+    SUBCASE("Round trip") {
+        auto bytes = filter.serialize();
+        auto decoded = BlockedBloomFilter::deserialize(bytes);
+        REQUIRE(decoded.has_value());
+        CHECK_EQ(decoded.value(), filter);
+        CHECK_EQ(decoded->serialize(), bytes);
+    }
+
+    SUBCASE("Rejects malformed bytes") {
+        auto bytes = filter.serialize();
+        CHECK_FALSE(BlockedBloomFilter::deserialize({}).has_value());
+        CHECK_FALSE(BlockedBloomFilter::deserialize(
+                std::span{bytes}.first(bytes.size() - 1))
+                        .has_value());
+
+        bytes[0] = BlockedBloomFilter::kFormat + 1;
+        CHECK_FALSE(BlockedBloomFilter::deserialize(bytes).has_value());
+
+        // no blocks, then a count far past the bytes that follow
+        std::vector<uint8_t> empty{BlockedBloomFilter::kFormat, 0};
+        empty.resize(2 + sizeof(BloomSeed));
+        CHECK_FALSE(BlockedBloomFilter::deserialize(empty).has_value());
+
+        std::vector<uint8_t> huge{BlockedBloomFilter::kFormat};
+        auto count = encode_varuint(UINT64_MAX);
+        huge.insert(huge.end(), count.begin(), count.end());
+        huge.resize(huge.size() + sizeof(BloomSeed) + 32);
+        CHECK_FALSE(BlockedBloomFilter::deserialize(huge).has_value());
+    }
+}
+
+TEST_CASE("BlockedBloomFilter format") {
+    // pins the block choice, the bits set and the byte layout, which must
+    // not differ between builds or vector paths
+    BlockedBloomFilter filter{2, counting_seed()};
+    filter.put(BloomHash{.h1 = 0, .h2 = 1});
+    filter.put(BloomHash{.h1 = UINT64_MAX, .h2 = 0});
+
+    std::vector<uint8_t> expected{BlockedBloomFilter::kFormat, 2};
+    for (size_t i = 0; i < sizeof(BloomSeed); ++i) {
+        expected.push_back(static_cast<uint8_t>(i));
+    }
+    // the top 5 bits of each salt, as key 1 multiplies out to the salt
+    for (unsigned bit : {8, 8, 17, 20, 14, 5, 19, 11}) {
+        uint32_t word = uint32_t{1} << bit;
+        for (size_t byte = 0; byte < 4; ++byte) {
+            expected.push_back(static_cast<uint8_t>(word >> (byte * 8)));
+        }
+    }
+    // key 0 sets bit 0 of every word of the last block
+    for (size_t word = 0; word < BlockedBloomFilter::kBlockWords; ++word) {
+        expected.insert(expected.end(), {1, 0, 0, 0});
+    }
+
+    CHECK_EQ(filter.serialize(), expected);
+    CHECK(filter.might_contain(BloomHash{.h1 = 1, .h2 = 1}));
+    CHECK_FALSE(filter.might_contain(BloomHash{.h1 = 0, .h2 = 0}));
+    CHECK_FALSE(filter.might_contain(BloomHash{.h1 = UINT64_MAX, .h2 = 1}));
+}
+
+TEST_CASE("AgingBloomFilter") {
+    using namespace std::chrono_literals;
+    AgingBloomFilter::Clock::time_point start{};
+    AgingBloomFilterOptions options{
+            .n = 1000, .fpr = 0.01, .horizon = 30s, .generations = 4};
+    AgingBloomFilter filter{options, start};
+
+    SUBCASE("Remembers for the horizon, then forgets") {
+        for (uint64_t i = 0; i < 100; ++i) {
+            filter.put(key_of(i), start + 9s);
+        }
+
+        for (auto later : {10s, 39s}) {
+            for (uint64_t i = 0; i < 100; ++i) {
+                CHECK(filter.might_contain(key_of(i), start + later));
+            }
+        }
+
+        // the generation it went into is cleared after 4 periods of 10s
+        size_t remembered = 0;
+        for (uint64_t i = 0; i < 100; ++i) {
+            remembered += filter.might_contain(key_of(i), start + 40s) ? 1 : 0;
+        }
+        CHECK_LT(remembered, 5);
+    }
+
+    SUBCASE("Ages across a long pause") {
+        filter.put(key_of(1), start);
+        CHECK(filter.might_contain(key_of(1), start + 15s));
+        CHECK_FALSE(filter.might_contain(key_of(1), start + 1h));
+
+        filter.put(key_of(2), start + 1h);
+        CHECK(filter.might_contain(key_of(2), start + 1h + 30s));
+    }
+
+    SUBCASE("Full generations retire early in fixed memory") {
+        size_t bits = filter.bit_count();
+        for (uint64_t i = 0; i < 10 * options.n; ++i) {
+            filter.put(key_of(i), start);
+        }
+
+        CHECK_EQ(filter.early_rotations(), 9u);
+        CHECK_EQ(filter.bit_count(), bits);
+        // the last few generations are still there
+        for (uint64_t i = 7 * options.n; i < 10 * options.n; ++i) {
+            CHECK(filter.might_contain(key_of(i), start));
+        }
+
+        size_t false_positives = 0;
+        for (uint64_t i = 10 * options.n; i < 20 * options.n; ++i) {
+            false_positives += filter.might_contain(key_of(i), start) ? 1 : 0;
+        }
+        CHECK_LT(false_positives, 10 * options.n * options.fpr * 1.5);
+    }
+}
@@ -1,6 +1,10 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 
+#include <string>
+#include <variant>
+#include <vector>
+
 #include "multiaddr.h"
 #include "varint.h"
 
@@ -26,6 +30,45 @@ TEST_CASE("Multiaddr string representation") {
                 "/btle/123e4567-e89b-12d3-a456-426614174000/1.2.3");
     }
 
+    SUBCASE("Semver with a trailing slash") {
+        auto multiaddr = Multiaddr::parse(
+                "/btle/123e4567-e89b-12d3-a456-426614174000/1.2.3/");
+        REQUIRE(multiaddr.has_value());
+        CHECK_EQ(multiaddr.value().version, SemanticVersion{1, 2, 3});
+    }
+
+    SUBCASE("Unknown protocol") {
+        auto multiaddr = Multiaddr::parse(
+                "/btle/123e4567-e89b-12d3-a456-426614174000/421/00ff10/1.2.3");
+        REQUIRE(multiaddr.has_value());
+        REQUIRE_EQ(multiaddr->protocols().size(), 2);
+
+        auto const &opaque =
+                std::get<OpaqueProtocol>(multiaddr->protocols()[1]);
+        CHECK_EQ(opaque.code, 421);
+        std::vector<uint8_t> payload{opaque.payload().begin(),
+                opaque.payload().end()};
+        std::vector<uint8_t> expected{0x00, 0xff, 0x10};
+        CHECK_EQ(payload, expected);
+
+        CHECK_EQ(multiaddr->to_string(),
+                "/btle/123e4567-e89b-12d3-a456-426614174000/421/00ff10/1.2.3");
+    }
+
+    SUBCASE("Known protocols only in their own form") {
+        CHECK(!Multiaddr::parse("/150/00").has_value());
+        CHECK(!Multiaddr::parse("/421/0").has_value());
+        CHECK(!Multiaddr::parse("/421/zz").has_value());
+    }
+
+    SUBCASE("Too many protocols") {
+        std::string str;
+        for (size_t i = 0; i <= Multiaddr::kMaxProtocols; ++i) {
+            str += "/btle/123e4567-e89b-12d3-a456-426614174000";
+        }
+        CHECK(!Multiaddr::parse(str).has_value());
+    }
+
     SUBCASE("No semver present") {
         auto multiaddr =
                 Multiaddr::parse("/btle/123e4567-e89b-12d3-a456-426614174000");
@@ -54,3 +97,61 @@ TEST_CASE("Multiaddr packed representation") {
     CHECK_EQ(multiaddr->to_string(),
             "/btle/123e4567-e89b-12d3-a456-426614174000");
 }
+
+TEST_CASE("Multiaddr packed round trip") {
+    auto multiaddr = Multiaddr::parse(
+            "/btle/123e4567-e89b-12d3-a456-426614174000/421/00ff10/1.2.3")
+                             .value();
+
+    std::vector<uint8_t> raw = multiaddr.to_raw();
+    CHECK_EQ(raw.size(), multiaddr.raw_size());
+
+    auto parsed = Multiaddr::parse_raw(raw);
+    REQUIRE(parsed.has_value());
+    CHECK_EQ(parsed.value(), multiaddr);
+    CHECK_EQ(std::hash<Multiaddr>{}(parsed.value()),
+            std::hash<Multiaddr>{}(multiaddr));
+
+    SUBCASE("Truncated") {
+        // inside the code, the uuid, the opaque payload and the version
+        for (size_t size : {1, 10, 22, 27}) {
+            CHECK(!Multiaddr::parse_raw({raw.data(), size}).has_value());
+        }
+
+        // between components is a shorter address
+        auto btle = Multiaddr::parse_raw({raw.data(), 18});
+        REQUIRE(btle.has_value());
+        CHECK_EQ(btle->protocols().size(), 1);
+        CHECK(!btle->version.has_value());
+    }
+
+    SUBCASE("Version not last") {
+        std::vector<uint8_t> reordered = Multiaddr::parse("/1.2.3")
+                                                 .value()
+                                                 .to_raw();
+        reordered.insert(reordered.end(), raw.begin(), raw.end());
+        CHECK(!Multiaddr::parse_raw(reordered).has_value());
+    }
+}
+
+TEST_CASE("MultiaddrInterner") {
+    MultiaddrInterner interner;
+    auto addr = Multiaddr::parse("/btle/123e4567-e89b-12d3-a456-426614174000")
+                        .value();
+    auto other = Multiaddr::parse("/btle/123e4567-e89b-12d3-a456-426614174001")
+                         .value();
+
+    SharedMultiaddr first = interner.intern(addr);
+    SharedMultiaddr second = interner.intern(Multiaddr{addr});
+    CHECK_EQ(first, second);
+    CHECK_EQ(*first, addr);
+
+    SharedMultiaddr third = interner.intern(other);
+    CHECK_NE(first, third);
+    CHECK_EQ(interner.size(), 2);
+
+    third.reset();
+    CHECK_EQ(interner.size(), 1);
+    // the same address comes back as a fresh entry
+    CHECK_EQ(*interner.intern(other), other);
+}
@@ -1,3 +1,6 @@
+#include <array>
+#include <string_view>
+
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 
@@ -31,4 +34,14 @@ TEST_CASE("UUID parse/to_string") {
         CHECK_EQ(b.value().to_string(), s);
         CHECK_EQ(c.value().to_string(), s);
     }
+
+    SUBCASE("Upper case and the fixed-size form") {
+        auto uuid = UUID::parse("123E4567-E89B-12D3-A456-426614174000");
+        REQUIRE(uuid.has_value());
+
+        std::array<char, UUID::kStringSize> str{};
+        uuid->to_string(str);
+        CHECK_EQ(std::string_view{str.data(), str.size()},
+                "123e4567-e89b-12d3-a456-426614174000");
+    }
 }
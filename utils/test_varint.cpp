@@ -1,5 +1,6 @@
 #include "varint.h"
 #include <cstdint>
+#include <random>
 #include <vector>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
@@ -13,11 +14,143 @@ struct TestCase {
 TEST_CASE("VarUint") {
     std::vector<TestCase> test_cases{
             {.bytes = {0x0}, .integer = 0x0},
+            {.bytes = {0x7f}, .integer = 0x7f},
+            {.bytes = {0x80, 0x01}, .integer = 0x80},
+            {.bytes = {0xac, 0x02}, .integer = 300},
+            {.bytes = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f},
+                    .integer = (uint64_t{1} << 56) - 1},
+            {.bytes = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01},
+                    .integer = uint64_t{1} << 56},
+            {.bytes = {0xff,
+                     0xff,
+                     0xff,
+                     0xff,
+                     0xff,
+                     0xff,
+                     0xff,
+                     0xff,
+                     0xff,
+                     0x01},
+                    .integer = UINT64_MAX},
     };
 
     for (TestCase const &c : test_cases) {
-        auto [i, _] = decode_varuint(std::span(c.bytes)).value();
+        CAPTURE(c.integer);
+        auto [i, read] = decode_varuint(std::span(c.bytes)).value();
         CHECK_EQ(i, c.integer);
+        CHECK_EQ(read, c.bytes.size());
         CHECK_EQ(encode_varuint(c.integer), c.bytes);
+        CHECK_EQ(varuint_size(c.integer), c.bytes.size());
+
+        // the same with the word-at-a-time path, which needs 8 bytes
+        std::vector<uint8_t> padded = c.bytes;
+        padded.resize(16, 0x55);
+        auto [padded_i, padded_read] =
+                decode_varuint(std::span(padded)).value();
+        CHECK_EQ(padded_i, c.integer);
+        CHECK_EQ(padded_read, c.bytes.size());
+    }
+}
+
+TEST_CASE("VarUint rejects") {
+    std::vector<uint8_t> bytes;
+
+    SUBCASE("truncated") {
+        bytes = {0x80, 0x80};
+        CHECK_EQ(parse_varuint(bytes).error(), VaruintError::Truncated);
+    }
+
+    SUBCASE("overlong") {
+        bytes = {0x80, 0x00};
+        CHECK_EQ(parse_varuint(bytes).error(), VaruintError::Malformed);
+
+        bytes = {0xff, 0x80, 0x00, 0, 0, 0, 0, 0, 0, 0};
+        CHECK_EQ(parse_varuint(bytes).error(), VaruintError::Malformed);
+    }
+
+    SUBCASE("past 64 bits") {
+        bytes = std::vector<uint8_t>(9, 0xff);
+        bytes.push_back(0x02);
+        CHECK_EQ(parse_varuint(bytes).error(), VaruintError::Malformed);
+    }
+
+    SUBCASE("longer than 10 bytes") {
+        bytes = std::vector<uint8_t>(11, 0x80);
+        bytes.push_back(0x01);
+        CHECK_EQ(parse_varuint(bytes).error(), VaruintError::Malformed);
+    }
+
+    CHECK_FALSE(decode_varuint(bytes).has_value());
+}
+
+TEST_CASE("decode_varuints") {
+    std::mt19937_64 random{7};
+    std::vector<uint64_t> values;
+    std::vector<uint8_t> stream;
+    for (size_t i = 0; i < 1000; ++i) {
+        uint64_t value = random() >> (random() % 64);
+        values.push_back(value);
+        std::vector<uint8_t> encoded = encode_varuint(value);
+        stream.insert(stream.end(), encoded.begin(), encoded.end());
+    }
+
+    SUBCASE("all at once") {
+        std::vector<uint64_t> out(values.size());
+        auto decoded = decode_varuints(stream, out).value();
+        CHECK_EQ(decoded.count, values.size());
+        CHECK_EQ(decoded.read, stream.size());
+        CHECK_EQ(out, values);
+    }
+
+    SUBCASE("a few at a time") {
+        std::vector<uint64_t> out;
+        std::span<uint8_t const> rest{stream};
+        std::vector<uint64_t> batch(7);
+        while (!rest.empty()) {
+            auto decoded = decode_varuints(rest, batch).value();
+            REQUIRE_GT(decoded.count, 0);
+            out.insert(out.end(), batch.begin(), batch.begin() + decoded.count);
+            rest = rest.subspan(decoded.read);
+        }
+        CHECK_EQ(out, values);
+    }
+
+    SUBCASE("runs of small values") {
+        std::vector<uint8_t> small;
+        std::vector<uint64_t> expected;
+        for (uint64_t i = 0; i < 100; ++i) {
+            uint64_t value = i % 37 == 0 ? i << 20 : i;
+            expected.push_back(value);
+            std::vector<uint8_t> encoded = encode_varuint(value);
+            small.insert(small.end(), encoded.begin(), encoded.end());
+        }
+
+        std::vector<uint64_t> out(expected.size());
+        auto decoded = decode_varuints(small, out).value();
+        CHECK_EQ(decoded.count, expected.size());
+        CHECK_EQ(out, expected);
+    }
+
+    SUBCASE("leaves a cut off varint") {
+        std::vector<uint8_t> cut = encode_varuint(1);
+        cut.push_back(0x80);
+        std::vector<uint64_t> out(4);
+        auto decoded = decode_varuints(cut, out).value();
+        CHECK_EQ(decoded.count, 1);
+        CHECK_EQ(decoded.read, 1);
+    }
+
+    SUBCASE("fails on a malformed varint anywhere") {
+        for (size_t at : {0, 100, 1990}) {
+            std::vector<uint8_t> bad = stream;
+            std::vector<uint8_t> overlong{0x81, 0x80, 0x00};
+            bad.insert(bad.begin() + static_cast<ptrdiff_t>(at),
+                    overlong.begin(),
+                    overlong.end());
+
+            // splits a varint unless `at` is a boundary, either way it fails
+            std::vector<uint64_t> out(values.size() + 1);
+            CHECK_FALSE(decode_varuints(bad, out).has_value());
+        }
     }
 }
@@ -0,0 +1,112 @@
+#include <atomic>
+#include <latch>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "worker_pool.h"
+
+TEST_CASE("WorkerPool") {
+    SUBCASE("runs every job") {
+        std::atomic<int> ran{0};
+        {
+            WorkerPool pool{4, 1000};
+            for (int i = 0; i < 1000; ++i) {
+                REQUIRE(pool.try_submit([&] { ran++; }));
+            }
+        }
+        CHECK_EQ(ran.load(), 1000);
+    }
+
+    SUBCASE("refuses jobs past its capacity") {
+        WorkerPool pool{2, 2};
+        std::latch release{1};
+
+        CHECK(pool.try_submit([&] { release.wait(); }));
+        CHECK(pool.try_submit([&] { release.wait(); }));
+        CHECK_FALSE(pool.try_submit([] {}));
+        CHECK_EQ(pool.in_flight(), 2);
+
+        release.count_down();
+    }
+
+    SUBCASE("idle workers steal") {
+        WorkerPool pool{4, 64};
+        std::latch started{4};
+        std::mutex mutex;
+        std::set<std::thread::id> threads;
+
+        // every job blocks until four run at once, which only happens if
+        // they are spread over all the workers
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(pool.try_submit([&] {
+                {
+                    std::scoped_lock lock(mutex);
+                    threads.insert(std::this_thread::get_id());
+                }
+                started.arrive_and_wait();
+            }));
+        }
+        started.wait();
+        CHECK_EQ(threads.size(), 4);
+    }
+
+    SUBCASE("awaits results on the caller's executor") {
+        asio::io_context context;
+        WorkerPool pool{2, 1};
+
+        std::vector<int> results;
+        auto io_thread = std::this_thread::get_id();
+        bool on_io_thread = true;
+
+        asio::co_spawn(context,
+                [&]() -> asio::awaitable<void> {
+                    // capacity 1, so every run waits for the one before
+                    for (int i = 0; i < 8; ++i) {
+                        results.push_back(co_await pool.run([i] {
+                            return i * i;
+                        }));
+                        on_io_thread = on_io_thread
+                                && std::this_thread::get_id() == io_thread;
+                    }
+                },
+                asio::detached);
+        context.run();
+
+        std::vector<int> expected{0, 1, 4, 9, 16, 25, 36, 49};
+        CHECK_EQ(results, expected);
+        CHECK(on_io_thread);
+    }
+
+    SUBCASE("backpressure") {
+        asio::io_context context;
+        WorkerPool pool{2, 2};
+        std::atomic<size_t> max_in_flight{0};
+        int done = 0;
+
+        for (int i = 0; i < 16; ++i) {
+            asio::co_spawn(context,
+                    [&]() -> asio::awaitable<void> {
+                        co_await pool.run([&] {
+                            size_t now = pool.in_flight();
+                            size_t seen = max_in_flight.load();
+                            while (now > seen
+                                    && !max_in_flight.compare_exchange_weak(
+                                            seen, now)) {
+                            }
+                            return 0;
+                        });
+                        done++;
+                    },
+                    asio::detached);
+        }
+        context.run();
+
+        CHECK_EQ(done, 16);
+        CHECK_LE(max_in_flight.load(), 2);
+    }
+}
@@ -1,17 +1,22 @@
-#include <absl/strings/escaping.h>
-#include <absl/strings/str_format.h>
 #include <algorithm>
-#include <cassert>
+#include <array>
 #include <cctype>
-#include <expected>
 #include <optional>
 #include <string>
 #include <string_view>
 
 #include <sodium/randombytes.h>
 
+#include "crypto/encoding.h"
 #include "uuid.h"
 
+namespace {
+
+/// the hex digits between the dashes of the canonical form
+constexpr std::array<size_t, 5> kGroupSizes{8, 4, 4, 4, 12};
+
+} // namespace
+
 UUID UUID::generate_random() {
     UUID uuid{};
     randombytes_buf(uuid.bytes().data(), UUID::kSize);
@@ -19,35 +24,48 @@ UUID UUID::generate_random() {
 }
 
 std::optional<UUID> UUID::parse(std::string_view str) {
-    std::string clean{};
-    for (char c : str) {
-        if (std::isalnum(c)) {
-            clean += c;
-        }
-    }
+    std::array<char, crypto::hex_encoded_size(kSize)> hex{};
 
-    if (clean.size() != 32) {
-        return std::nullopt;
+    bool canonical = str.size() == kStringSize;
+    for (size_t i = 0, at = 0; canonical && i + 1 < kGroupSizes.size(); ++i) {
+        at += kGroupSizes[i];
+        canonical = str[at++] == '-';
     }
 
-    UUID uuid{};
-
-    for (size_t i = 0; i < 16; ++i) {
-        std::string byte_str = clean.substr(i * 2, 2);
-        std::string byte_result;
+    if (canonical) {
+        auto next = hex.begin();
+        auto from = str.begin();
+        for (size_t group : kGroupSizes) {
+            next = std::copy_n(from, group, next);
+            from += group + 1;
+        }
+    } else {
+        // anything else between and around the digits is skipped
+        size_t digits = 0;
+        for (char c : str) {
+            if (!std::isalnum(static_cast<unsigned char>(c))) {
+                continue;
+            }
+            if (digits == hex.size()) {
+                return std::nullopt;
+            }
+            hex[digits++] = c;
+        }
 
-        if (!absl::HexStringToBytes(byte_str, &byte_result)) {
+        if (digits != hex.size()) {
             return std::nullopt;
         }
+    }
 
-        assert(byte_result.size() == 1);
-        uuid.bytes()[i] = static_cast<uint8_t>(byte_result[0]);
+    UUID uuid{};
+    if (!crypto::hex_decode({hex.data(), hex.size()}, uuid.bytes_)) {
+        return std::nullopt;
     }
 
     return uuid;
 }
 
-std::optional<UUID> UUID::parse_raw(std::span<uint8_t> bytes) {
+std::optional<UUID> UUID::parse_raw(std::span<uint8_t const> bytes) {
     if (bytes.size() != kSize) {
         return std::nullopt;
     }
@@ -58,15 +76,23 @@ std::optional<UUID> UUID::parse_raw(std::span<uint8_t> bytes) {
     return uuid;
 }
 
-std::string UUID::to_string() const {
-    std::string out{};
-    for (size_t i = 0; i < bytes_.size(); i++) {
-        if (i == 4 || i == 6 || i == 8 || i == 10) {
-            out += '-';
+void UUID::to_string(std::span<char, kStringSize> out) const {
+    std::array<char, crypto::hex_encoded_size(kSize)> hex;
+    crypto::hex_encode(bytes_, hex);
+
+    auto next = out.begin();
+    auto from = hex.begin();
+    for (size_t group : kGroupSizes) {
+        next = std::copy_n(from, group, next);
+        from += group;
+        if (next != out.end()) {
+            *next++ = '-';
         }
-
-        out += absl::StrFormat("%02x", bytes_[i]);
     }
+}
 
+std::string UUID::to_string() const {
+    std::string out(kStringSize, '\0');
+    to_string(std::span<char, kStringSize>{out.data(), kStringSize});
     return out;
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
 #include <expected>
+#include <functional>
 #include <optional>
 #include <span>
 #include <string>
@@ -13,25 +16,50 @@
 class UUID {
 public:
     static constexpr size_t kSize = 16;
+    /// of the canonical form, 8-4-4-4-12 hex digits
+    static constexpr size_t kStringSize = 36;
 
     static std::optional<UUID> parse(std::string_view str);
-    static std::optional<UUID> parse_raw(std::span<uint8_t> bytes);
+    static std::optional<UUID> parse_raw(std::span<uint8_t const> bytes);
     static UUID generate_random();
 
     std::string to_string() const;
+
+    /// the canonical form into `out`, without allocating
+    void to_string(std::span<char, kStringSize> out) const;
+
     std::span<uint8_t const> bytes() const { return bytes_; };
     std::span<uint8_t> bytes() { return bytes_; };
 
+    bool operator==(UUID const &other) const = default;
+
 private:
     std::array<uint8_t, kSize> bytes_;
 };
 
+template<>
+struct std::hash<UUID> {
+    /// assigned uuids share most of their bytes, so both halves are mixed
+    size_t operator()(UUID const &uuid) const noexcept {
+        uint64_t high = 0;
+        uint64_t low = 0;
+        std::memcpy(&high, uuid.bytes().data(), sizeof(high));
+        std::memcpy(&low, uuid.bytes().data() + sizeof(high), sizeof(low));
+
+        uint64_t value =
+                (high ^ (low * 0x9e3779b97f4a7c15)) * 0xbf58476d1ce4e5b9;
+        return static_cast<size_t>(value ^ (value >> 31));
+    }
+};
+
 template<>
 struct fmt::formatter<UUID> {
     constexpr auto parse(format_parse_context &ctx) const { return ctx.end(); }
 
     template<typename FormatContext>
     auto format(const UUID &uuid, FormatContext &ctx) const {
-        return format_to(ctx.out(), "{}", uuid.to_string());
+        std::array<char, UUID::kStringSize> str;
+        uuid.to_string(str);
+        return std::ranges::copy(str, ctx.out()).out;
     }
 };
@@ -0,0 +1,103 @@
+#include "varint.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/// the bytes looked at in one step
+constexpr size_t kWindow = 16;
+
+/// bit i is set when byte i ends a varint, for 16 bytes
+uint32_t varuint_ends(uint8_t const *bytes) {
+#if defined(__SSE2__)
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes));
+    return ~static_cast<uint32_t>(_mm_movemask_epi8(chunk)) & 0xffff;
+#else
+    // gathers the high bit of every byte into the top byte
+    constexpr uint64_t kGather = 0x0002040810204081;
+    uint64_t low = detail::load_word(bytes) & detail::kVaruintHighBits;
+    uint64_t high = detail::load_word(bytes + 8) & detail::kVaruintHighBits;
+    uint32_t continues = static_cast<uint32_t>((low * kGather) >> 56)
+            | static_cast<uint32_t>((high * kGather) >> 56) << 8;
+    return ~continues & 0xffff;
+#endif
+}
+
+} // namespace
+
+std::expected<DecodedVaruints, VaruintError> decode_varuints(
+        std::span<uint8_t const> bytes, std::span<uint64_t> out) {
+    size_t count = 0;
+    size_t read = 0;
+
+    // every step decodes one varint with a load of 8 bytes, or 16 at once
+    // when they all fit in a byte. the reads past the varint stay in the
+    // buffer as long as 16 bytes are left.
+    while (count < out.size() && bytes.size() - read >= kWindow) {
+        uint8_t const *varint = bytes.data() + read;
+        uint64_t word = detail::load_word(varint);
+
+        // values below 128, as in runs of counts and lengths. a widening
+        // copy, which compilers turn into vector moves. the branch is
+        // predicted, so the vector load is not on the path from one
+        // varint to the next.
+        if ((word & detail::kVaruintHighBits) == 0
+                && varuint_ends(varint) == 0xffff
+                && out.size() - count >= kWindow) {
+            std::copy_n(varint, kWindow, out.begin() + count);
+            count += kWindow;
+            read += kWindow;
+            continue;
+        }
+
+        // the last byte is the first without its high bit, past 8 bytes
+        // it is one of the next two
+        uint64_t ends = ~word & detail::kVaruintHighBits;
+        uint32_t tail_ends = ~(varint[8] | varint[9] << 8) & 0x8080U;
+        size_t size = ends != 0
+                ? static_cast<size_t>(std::countr_zero(ends)) / 8 + 1
+                : tail_ends != 0
+                ? static_cast<size_t>(std::countr_zero(tail_ends)) / 8 + 9
+                : kMaxVaruintSize + 1;
+        if (size > kMaxVaruintSize) {
+            return std::unexpected(VaruintError::Malformed);
+        }
+
+        uint8_t last = varint[size - 1];
+        if ((size > 1 && last == 0) || (size == kMaxVaruintSize && last > 1)) {
+            return std::unexpected(VaruintError::Malformed);
+        }
+
+        // the 57th to 63rd bits and the 64th are masked in rather than
+        // branched on, sizes in a stream are hard to predict
+        uint64_t value =
+                detail::varuint_value(word, std::min<size_t>(size, 8));
+        value |= (static_cast<uint64_t>(varint[8] & 0x7f) << 56)
+                & -static_cast<uint64_t>(size > 8);
+        value |= (static_cast<uint64_t>(last) << 63)
+                & -static_cast<uint64_t>(size == kMaxVaruintSize);
+
+        out[count++] = value;
+        read += size;
+    }
+
+    while (count < out.size() && read < bytes.size()) {
+        auto parsed = parse_varuint(bytes.subspan(read));
+        if (!parsed.has_value()) {
+            if (parsed.error() == VaruintError::Truncated) {
+                break;
+            }
+            return std::unexpected(parsed.error());
+        }
+
+        auto [value, size] = parsed.value();
+        out[count++] = value;
+        read += size;
+    }
+
+    return DecodedVaruints{.count = count, .read = read};
+}
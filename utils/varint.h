@@ -1,31 +1,154 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <expected>
 #include <optional>
 #include <span>
+#include <tuple>
 #include <vector>
 
-constexpr std::vector<uint8_t> encode_varuint(uint64_t val) {
-    std::vector<uint8_t> result;
+/// the largest encoding of a 64-bit value
+constexpr size_t kMaxVaruintSize = 10;
+
+constexpr size_t varuint_size(uint64_t val) {
+    // 7 bits a byte, and zero still takes one
+    return (static_cast<size_t>(std::bit_width(val | 1)) + 6) / 7;
+}
+
+/// encodes into `out`, which must hold varuint_size(val) bytes, and
+/// returns how many were written
+constexpr size_t encode_varuint(uint64_t val, std::span<uint8_t> out) {
+    size_t written = 0;
     while (val >= 0x80) {
-        result.push_back((val & 0xFF) | 0x80);
+        out[written++] = (val & 0xFF) | 0x80;
         val >>= 7;
     }
-    result.push_back(val & 0xFF);
+    out[written++] = val & 0xFF;
+    return written;
+}
+
+/// encodes into a buffer of its own, for when the bytes are kept anyway.
+/// the hot paths use the span overload.
+constexpr std::vector<uint8_t> encode_varuint(uint64_t val) {
+    std::vector<uint8_t> result(varuint_size(val));
+    encode_varuint(val, result);
     return result;
 }
 
-constexpr std::optional<std::tuple<uint64_t, size_t>> decode_varuint(
-        std::span<uint8_t const> bytes) {
+enum class VaruintError {
+    /// the bytes end before the varint does, more may still come
+    Truncated,
+    /// longer than kMaxVaruintSize, past 64 bits, or not the shortest
+    /// encoding of its value
+    Malformed,
+};
+
+namespace detail {
+
+/// the continuation bit of every byte in a word
+constexpr uint64_t kVaruintHighBits = 0x8080808080808080;
+
+/// the value of the `size` (1 to 8) varint bytes at the bottom of `word`,
+/// read little endian. folds the 7-bit groups together pairwise, with no
+/// loop over the bytes.
+constexpr uint64_t varuint_value(uint64_t word, size_t size) {
+    word &= ~uint64_t{0} >> (64 - 8 * size);
+    word &= ~kVaruintHighBits;
+    word = ((word & 0x7f007f007f007f00) >> 1) | (word & 0x007f007f007f007f);
+    word = ((word & 0x3fff00003fff0000) >> 2) | (word & 0x00003fff00003fff);
+    word = ((word & 0x0fffffff00000000) >> 4) | (word & 0x000000000fffffff);
+    return word;
+}
+
+/// the first 8 bytes of `bytes`, little endian. there must be 8.
+inline uint64_t load_word(uint8_t const *bytes) {
+    std::array<uint8_t, 8> raw{};
+    std::copy_n(bytes, raw.size(), raw.begin());
+    auto word = std::bit_cast<uint64_t>(raw);
+    if constexpr (std::endian::native == std::endian::big) {
+        word = std::byteswap(word);
+    }
+    return word;
+}
+
+/// one byte at a time, for short buffers, values past 56 bits and
+/// constant evaluation
+constexpr std::expected<std::tuple<uint64_t, size_t>, VaruintError>
+parse_varuint_bytewise(std::span<uint8_t const> bytes) {
     uint64_t result = 0;
+    size_t limit = std::min(bytes.size(), kMaxVaruintSize);
 
-    for (size_t read = 0; read < bytes.size(); read++) {
+    for (size_t read = 0; read < limit; read++) {
         uint8_t current = bytes[read];
-        result |= static_cast<uint64_t>(current & ~0x80) << (read * 7);
+        result |= static_cast<uint64_t>(current & 0x7f) << (read * 7);
 
         if ((current & 0x80) == 0) {
+            // a zero last byte adds nothing, a shorter encoding exists.
+            // the tenth byte only has room for the 64th bit.
+            if ((read > 0 && current == 0)
+                    || (read == kMaxVaruintSize - 1 && current > 1)) {
+                return std::unexpected(VaruintError::Malformed);
+            }
             return std::tuple<uint64_t, size_t>{result, read + 1};
         }
     }
 
-    return std::nullopt;
+    return std::unexpected(limit == kMaxVaruintSize
+                    ? VaruintError::Malformed
+                    : VaruintError::Truncated);
+}
+
+} // namespace detail
+
+/// the value at the front of `bytes` and how many bytes it took, or why
+/// there is none
+constexpr std::expected<std::tuple<uint64_t, size_t>, VaruintError>
+parse_varuint(std::span<uint8_t const> bytes) {
+    if !consteval {
+        if (bytes.size() >= 8) {
+            uint64_t word = detail::load_word(bytes.data());
+            // the last byte is the first without its high bit
+            uint64_t ends = ~word & detail::kVaruintHighBits;
+            if (ends != 0) {
+                size_t size = std::countr_zero(ends) / 8 + 1;
+                if (size > 1 && bytes[size - 1] == 0) {
+                    return std::unexpected(VaruintError::Malformed);
+                }
+                return std::tuple<uint64_t, size_t>{
+                        detail::varuint_value(word, size), size};
+            }
+        }
+    }
+
+    return detail::parse_varuint_bytewise(bytes);
 }
+
+constexpr std::optional<std::tuple<uint64_t, size_t>> decode_varuint(
+        std::span<uint8_t const> bytes) {
+    auto parsed = parse_varuint(bytes);
+    if (!parsed.has_value()) {
+        return std::nullopt;
+    }
+    auto [value, size] = parsed.value();
+    return std::tuple<uint64_t, size_t>{value, size};
+}
+
+struct DecodedVaruints {
+    /// values written to the front of `out`
+    size_t count;
+    /// bytes they took
+    size_t read;
+};
+
+/// decodes consecutive varints from `bytes` into `out`, until either runs
+/// out. a varint cut off at the end of `bytes` is left for the next call.
+/// fails if any of them is malformed.
+///
+/// decodes each varint from one 8-byte load without a loop over its
+/// bytes, and takes a run of 16 single-byte values with one vector
+/// compare and a widening copy.
+std::expected<DecodedVaruints, VaruintError> decode_varuints(
+        std::span<uint8_t const> bytes, std::span<uint64_t> out);
@@ -0,0 +1,136 @@
+#include "utils/worker_pool.h"
+
+WorkerPool::WorkerPool(size_t threads, size_t capacity)
+    : capacity_{std::max<size_t>(1, capacity)} {
+    threads = std::max<size_t>(1, threads);
+
+    for (size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back([this, i] { work(i); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::scoped_lock lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+
+    for (std::thread &worker : workers_) {
+        worker.join();
+    }
+}
+
+bool WorkerPool::try_submit(Job job) {
+    {
+        std::scoped_lock lock(mutex_);
+        if (in_flight_ >= capacity_ || stopping_) {
+            return false;
+        }
+        in_flight_++;
+    }
+
+    push(std::move(job));
+    return true;
+}
+
+asio::awaitable<void> WorkerPool::reserve() {
+    for (;;) {
+        asio::steady_timer timer{co_await asio::this_coro::executor,
+                asio::steady_timer::time_point::max()};
+
+        {
+            std::scoped_lock lock(mutex_);
+            if (in_flight_ < capacity_) {
+                in_flight_++;
+                co_return;
+            }
+            waiters_.push_back(&timer);
+        }
+
+        // woken once a job finished. someone else may have taken the room
+        // by then, so check again.
+        asio::error_code error;
+        co_await timer.async_wait(
+                asio::redirect_error(asio::use_awaitable, error));
+    }
+}
+
+void WorkerPool::push(Job job) {
+    size_t index = 0;
+    {
+        std::scoped_lock lock(mutex_);
+        index = next_queue_++ % queues_.size();
+    }
+
+    {
+        Queue &queue = *queues_[index];
+        std::scoped_lock lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+
+    {
+        std::scoped_lock lock(mutex_);
+        queued_++;
+    }
+    ready_.notify_one();
+}
+
+void WorkerPool::work(size_t index) {
+    for (;;) {
+        {
+            std::unique_lock lock(mutex_);
+            ready_.wait(lock, [this] { return queued_ > 0 || stopping_; });
+            if (queued_ == 0) {
+                return;
+            }
+            queued_--;
+        }
+
+        take(index)();
+
+        asio::steady_timer *waiter = nullptr;
+        {
+            std::scoped_lock lock(mutex_);
+            in_flight_--;
+            if (!waiters_.empty()) {
+                waiter = waiters_.front();
+                waiters_.pop_front();
+            }
+        }
+
+        if (waiter != nullptr) {
+            // timers are not thread safe, so this runs on the waiter's
+            // executor. expiring rather than cancelling also wakes a waiter
+            // that has not started waiting yet.
+            asio::post(waiter->get_executor(), [waiter] {
+                waiter->expires_at(asio::steady_timer::time_point::min());
+            });
+        }
+    }
+}
+
+WorkerPool::Job WorkerPool::take(size_t index) {
+    // queued_ promised us a job, but another worker may be stealing from
+    // the same queue, so look around until we get one
+    for (size_t attempt = 0;; ++attempt) {
+        Queue &queue = *queues_[(index + attempt) % queues_.size()];
+        std::scoped_lock lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+
+        Job job;
+        if (attempt % queues_.size() == 0) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        } else {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+        return job;
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <asio.hpp>
+
+/// threads for cpu-heavy work, such as checking signatures, so that it
+/// does not hold up the io thread.
+///
+/// every worker has its own queue. jobs are spread over the queues round
+/// robin, a worker takes from the front of its own and, once that is
+/// empty, steals from the back of the others. at most `capacity` jobs are
+/// queued or running: try_submit fails past that, and run waits for a
+/// job to finish first, which pushes back on whoever produces the work.
+class WorkerPool {
+public:
+    using Job = std::move_only_function<void()>;
+
+    /// leaves a core to the io thread
+    static size_t default_threads() {
+        return std::max(2U, std::thread::hardware_concurrency()) - 1;
+    }
+
+    explicit WorkerPool(
+            size_t threads = default_threads(), size_t capacity = 1024);
+
+    /// runs the jobs already queued, then joins the workers
+    ~WorkerPool();
+
+    WorkerPool(WorkerPool const &) = delete;
+
+    /// queues `job`, unless the pool is at capacity
+    bool try_submit(Job job);
+
+    /// runs `fn` on a worker and resumes on the calling coroutine's
+    /// executor with its result. `fn` must not throw. waits for room
+    /// while the pool is at capacity, so the pool must outlive the wait.
+    template<typename F>
+    asio::awaitable<std::invoke_result_t<F &>> run(F fn) {
+        using Result = std::invoke_result_t<F &>;
+        static_assert(!std::is_void_v<Result>, "return something to await");
+
+        co_await reserve();
+
+        auto executor = co_await asio::this_coro::executor;
+        co_return co_await asio::async_initiate<
+                decltype(asio::use_awaitable), void(Result)>(
+                [this, executor, fn = std::move(fn)](auto handler) mutable {
+                    push([handler = std::move(handler),
+                                 executor,
+                                 fn = std::move(fn)]() mutable {
+                        asio::post(executor,
+                                [handler = std::move(handler),
+                                        result = fn()]() mutable {
+                                    std::move(handler)(std::move(result));
+                                });
+                    });
+                },
+                asio::use_awaitable);
+    }
+
+    size_t threads() const { return workers_.size(); }
+
+    size_t capacity() const { return capacity_; }
+
+    /// jobs queued or running
+    size_t in_flight() const {
+        std::scoped_lock lock(mutex_);
+        return in_flight_;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    size_t capacity_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    /// jobs in the queues, never more than they hold
+    size_t queued_ = 0;
+    size_t in_flight_ = 0;
+    size_t next_queue_ = 0;
+    bool stopping_ = false;
+    /// coroutines waiting in run() for room, woken by expiring their timer
+    std::deque<asio::steady_timer *> waiters_;
+
+    /// waits until a job fits, and counts it in
+    asio::awaitable<void> reserve();
+
+    /// queues a job that was already counted in
+    void push(Job job);
+
+    void work(size_t index);
+
+    /// the front of our own queue, or else the back of someone else's
+    Job take(size_t index);
+};